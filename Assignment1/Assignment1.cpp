@@ -1,36 +1,335 @@
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <memory>
 #include "Utils.h"
 #include "CImg.h"
+#include "PNM.h"
+#include "Scan.h"
+#include "ComputeBackend.h"
 
 using namespace cimg_library;
 
 void print_help() {
     std::cerr << "Application usage:" << std::endl;
     std::cerr << "  -p : select platform " << std::endl;
-    std::cerr << "  -d : select device" << std::endl;
+    std::cerr << "  -d : select device (index on the platform, cpu, gpu, accelerator, fastest or part of a device name)" << std::endl;
     std::cerr << "  -l : list all platforms and devices" << std::endl;
     std::cerr << "  -f : input image file" << std::endl;
     std::cerr << "  -b : number of bins (1-1025, default 256)" << std::endl;
-    std::cerr << "  -s : scan kernel (bl for Blelloch, hs for Hillis-Steele, default bl)" << std::endl;
+    std::cerr << "  -s : scan kernel (bl for Blelloch, hs for Hillis-Steele, seg for one segmented scan over all channels, lb for the single-pass look-back scan, default bl)" << std::endl;
+    std::cerr << "  -t : force tiled streaming mode (chosen automatically when the image exceeds device memory limits)" << std::endl;
+    std::cerr << "  -m : device band budget for tiled mode in MB (default: derived from device limits)" << std::endl;
+    std::cerr << "  -o : save the equalised image to a PNM file" << std::endl;
+    std::cerr << "  -z : also produce an equalised thumbnail downscaled by this integer factor (2-255), fused with back projection" << std::endl;
+    std::cerr << "  -x : image transfer mode (copy, pinned, mapped, zerocopy, auto; default copy)" << std::endl;
+    std::cerr << "  -X : benchmark all transfer modes at the image size and exit" << std::endl;
+    std::cerr << "  -B : backend (opencl for the kernels in kernels/my_kernels.cl, compute for Boost.Compute algorithms, compare to run both and check every step; default opencl; compute and compare need a build with make BOOST_COMPUTE=1)" << std::endl;
+    std::cerr << "  -H : Boost.Compute histogram (sort for sort + reduce_by_key, atomic for a custom atomic kernel; default atomic)" << std::endl;
+    std::cerr << "  -c : directory for the persistent Boost.Compute program cache, kept in <dir>/.boost_compute (default $HOME)" << std::endl;
     std::cerr << "  -h : print this message" << std::endl;
 }
 
+// Sum of the execution times of a list of profiled commands (seconds)
+double total_event_time(const std::vector<cl::Event>& events) {
+    double total = 0.0;
+    for (size_t i = 0; i < events.size(); i++) {
+        total += (events[i].getProfilingInfo<CL_PROFILING_COMMAND_END>() -
+                  events[i].getProfilingInfo<CL_PROFILING_COMMAND_START>()) * 1e-9;
+    }
+    return total;
+}
+
+// Out-of-core equalisation for images whose channels do not fit in a single device allocation.
+// The image is streamed through the device twice in bands of rows, read straight from the
+// memory-mapped input file: the first pass accumulates the histogram of every channel, the second
+// back-projects through the LUTs and writes each band to the memory-mapped output file (when there
+// is one). Two band slots per direction and separate upload/compute/download queues let the
+// transfer of one band overlap the kernels of the next. The host holds only the four band slots,
+// so peak memory is bounded by the band size whatever the size of the image.
+void equalise_tiled(const cl::Context& context, const cl::Program& program, const PNMImage& pnm, const char* output_filename,
+                    int num_bins, const char* scan_kernel_type, size_t band_budget) {
+    size_t width = pnm.width;
+    size_t height = pnm.height;
+    size_t channels = pnm.channels;
+    size_t image_size = width * height;
+    size_t row_bytes = width * sizeof(unsigned short);
+
+    cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+    cl_ulong max_alloc_size = device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>();
+    cl_ulong global_mem_size = device.getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>();
+    cl_ulong local_mem_size = device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+    size_t max_work_group_size = device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+
+    // Band size: four band buffers per channel (2 inputs, 2 outputs) share half of the global memory
+    // with the LUTs and histograms, and no band may exceed the maximum single allocation
+    cl_ulong fixed_bytes = channels * (65536 * sizeof(unsigned short) + num_bins * sizeof(unsigned int));
+    cl_ulong band_bytes = std::min(max_alloc_size, (global_mem_size / 2 - fixed_bytes) / (4 * channels));
+    if (band_budget > 0) band_bytes = std::min(band_bytes, (cl_ulong)band_budget);
+    band_bytes = std::min(band_bytes, (cl_ulong)INT_MAX); // kernels index pixels with int
+    if (band_bytes < row_bytes) {
+        throw cl::Error(CL_INVALID_BUFFER_SIZE, "Image row does not fit in a device band buffer");
+    }
+    size_t band_rows = std::min((size_t)(band_bytes / row_bytes), height);
+    size_t num_bands = (height + band_rows - 1) / band_rows;
+    size_t slot_pixels = band_rows * width;
+
+    if (num_bins * sizeof(int) > local_mem_size) {
+        throw cl::Error(CL_OUT_OF_RESOURCES, "Local histogram exceeds device local memory");
+    }
+    size_t local_size = std::min((size_t)1024, max_work_group_size);
+
+    std::cout << "Tiled streaming mode: " << num_bands << " band(s) of " << band_rows << " rows ("
+              << band_rows * row_bytes << " bytes per channel and band buffer, "
+              << 4 * slot_pixels * channels * sizeof(unsigned short) << " bytes of host band slots)" << std::endl;
+
+    cl::CommandQueue queue(context, device, CL_QUEUE_PROFILING_ENABLE);
+    cl::CommandQueue upload_queue(context, device, CL_QUEUE_PROFILING_ENABLE);
+    cl::CommandQueue download_queue(context, device, CL_QUEUE_PROFILING_ENABLE);
+
+    // Band slots: one device buffer per channel, one host buffer holding every channel of a band
+    std::vector<cl::Buffer> dev_band_input[2];
+    std::vector<cl::Buffer> dev_band_output[2];
+    std::vector<unsigned short> host_band_input[2];
+    std::vector<unsigned short> host_band_output[2];
+    for (int i = 0; i < 2; i++) {
+        for (size_t c = 0; c < channels; c++) {
+            dev_band_input[i].push_back(cl::Buffer(context, CL_MEM_READ_ONLY, band_rows * row_bytes));
+            dev_band_output[i].push_back(cl::Buffer(context, CL_MEM_WRITE_ONLY, band_rows * row_bytes));
+        }
+        host_band_input[i].resize(slot_pixels * channels);
+        host_band_output[i].resize(slot_pixels * channels);
+    }
+    std::vector<cl::Buffer> dev_histogram, dev_lut;
+    for (size_t c = 0; c < channels; c++) {
+        dev_histogram.push_back(cl::Buffer(context, CL_MEM_READ_WRITE, num_bins * sizeof(unsigned int)));
+        dev_lut.push_back(cl::Buffer(context, CL_MEM_READ_WRITE, 65536 * sizeof(unsigned short)));
+    }
+
+    cl::Kernel hist_kernel(program, "hist_local");
+    hist_kernel.setArg(2, num_bins);
+    hist_kernel.setArg(4, cl::Local(num_bins * sizeof(int)));
+
+    bool segmented = (strcmp(scan_kernel_type, "seg") == 0);
+    std::unique_ptr<PrefixScan<int> > prefix_scan;
+    if (strcmp(scan_kernel_type, "lb") == 0) prefix_scan.reset(new PrefixScan<int>(context));
+    size_t scan_local_size = 1;
+    while (scan_local_size * 2 <= std::min((size_t)num_bins, max_work_group_size)) scan_local_size *= 2;
+    cl::Kernel scan_kernel(program, segmented ? "scan_segmented" : (strcmp(scan_kernel_type, "bl") == 0) ? "scan_bl" : "scan_hs");
+    scan_kernel.setArg(1, num_bins);
+    if (segmented) {
+        scan_kernel.setArg(2, num_bins);
+        scan_kernel.setArg(3, cl::Local(scan_local_size * sizeof(int)));
+    }
+
+    cl::Kernel normalize_kernel(program, "normalize_lut");
+    normalize_kernel.setArg(2, 65535.0f / image_size);
+    normalize_kernel.setArg(3, num_bins);
+
+    cl::Kernel backproject_kernel(program, "back_project");
+
+    std::unique_ptr<PNMWriter> writer;
+    if (output_filename[0]) writer.reset(new PNMWriter(output_filename, width, height, channels, pnm.maxval));
+
+    // events are stored band by band, channel by channel
+    std::vector<cl::Event> hist_uploads, hist_events, lut_events, project_uploads, project_events, downloads;
+    std::vector<cl::Event> slot_uploads[2]; // uploads still reading each host input slot
+    double read_time = 0.0, write_time = 0.0;
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    // Decodes rows of the mapped input into a host slot, once the uploads of its previous band are done
+    auto read_band = [&](size_t b) {
+        int slot = b % 2;
+        size_t first_row = b * band_rows;
+        if (!slot_uploads[slot].empty()) cl::Event::waitForEvents(slot_uploads[slot]);
+        slot_uploads[slot].clear();
+        std::chrono::high_resolution_clock::time_point read_start = std::chrono::high_resolution_clock::now();
+        pnm.read_rows(first_row, std::min(band_rows, height - first_row), host_band_input[slot].data(), slot_pixels);
+        read_time += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - read_start).count();
+    };
+
+    // Encodes a back-projected band into the mapped output, once all its downloads are done
+    auto write_band = [&](size_t b) {
+        std::vector<cl::Event> band_downloads(downloads.begin() + b * channels, downloads.begin() + (b + 1) * channels);
+        cl::Event::waitForEvents(band_downloads);
+        if (!writer) return;
+        size_t first_row = b * band_rows;
+        std::chrono::high_resolution_clock::time_point write_start = std::chrono::high_resolution_clock::now();
+        writer->write_rows(first_row, std::min(band_rows, height - first_row), host_band_output[b % 2].data(), slot_pixels);
+        write_time += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - write_start).count();
+    };
+
+    // Pass 1: stream the bands and accumulate the histogram of every channel
+    for (size_t c = 0; c < channels; c++) {
+        queue.enqueueFillBuffer(dev_histogram[c], 0, 0, num_bins * sizeof(unsigned int));
+    }
+    for (size_t b = 0; b < num_bands; b++) {
+        int slot = b % 2;
+        size_t band_pixels = std::min(band_rows, height - b * band_rows) * width;
+        read_band(b);
+
+        for (size_t c = 0; c < channels; c++) {
+            // the device slot is free once the histogram of the band two steps back has consumed it
+            std::vector<cl::Event> wait_free;
+            if (b >= 2) wait_free.push_back(hist_events[(b - 2) * channels + c]);
+            cl::Event upload;
+            upload_queue.enqueueWriteBuffer(dev_band_input[slot][c], CL_FALSE, 0, band_pixels * sizeof(unsigned short),
+                                            host_band_input[slot].data() + c * slot_pixels, &wait_free, &upload);
+            upload_queue.flush();
+
+            std::vector<cl::Event> wait_upload(1, upload);
+            cl::Event hist;
+            size_t global_size = ((band_pixels + local_size - 1) / local_size) * local_size;
+            hist_kernel.setArg(0, dev_band_input[slot][c]);
+            hist_kernel.setArg(1, dev_histogram[c]);
+            hist_kernel.setArg(3, (int)band_pixels);
+            queue.enqueueNDRangeKernel(hist_kernel, cl::NullRange, cl::NDRange(global_size),
+                                       cl::NDRange(local_size), &wait_upload, &hist);
+            queue.flush();
+
+            hist_uploads.push_back(upload);
+            hist_events.push_back(hist);
+            slot_uploads[slot].push_back(upload);
+        }
+    }
+
+    // Cumulative histograms and LUTs, ordered after all histogram kernels by the in-order queue
+    for (size_t c = 0; c < channels; c++) {
+        cl::Event scan_event, lut_event;
+        if (prefix_scan) {
+            prefix_scan->exclusive(queue, dev_histogram[c], dev_histogram[c], num_bins, &scan_event);
+        } else {
+            scan_kernel.setArg(0, dev_histogram[c]);
+            queue.enqueueNDRangeKernel(scan_kernel, cl::NullRange, cl::NDRange(segmented ? scan_local_size : num_bins),
+                                       segmented ? cl::NDRange(scan_local_size) : cl::NullRange, NULL, &scan_event);
+        }
+        normalize_kernel.setArg(0, dev_histogram[c]);
+        normalize_kernel.setArg(1, dev_lut[c]);
+        queue.enqueueNDRangeKernel(normalize_kernel, cl::NullRange, cl::NDRange(65536),
+                                   cl::NullRange, NULL, &lut_event);
+        lut_events.push_back(scan_event);
+        lut_events.push_back(lut_event);
+    }
+    queue.flush();
+
+    // Pass 2: stream the bands again, back-project them and write each finished band to the output
+    for (size_t b = 0; b < num_bands; b++) {
+        int slot = b % 2;
+        size_t band_bytes_used = std::min(band_rows, height - b * band_rows) * row_bytes;
+        read_band(b);
+
+        for (size_t c = 0; c < channels; c++) {
+            // the input slot is free once the band two steps back is projected (or the LUTs are done)
+            std::vector<cl::Event> wait_free = lut_events;
+            if (b >= 2) wait_free.assign(1, project_events[(b - 2) * channels + c]);
+            cl::Event upload;
+            upload_queue.enqueueWriteBuffer(dev_band_input[slot][c], CL_FALSE, 0, band_bytes_used,
+                                            host_band_input[slot].data() + c * slot_pixels, &wait_free, &upload);
+            upload_queue.flush();
+
+            // the output slot is free once the band two steps back has been downloaded
+            std::vector<cl::Event> wait_project(1, upload);
+            if (b >= 2) wait_project.push_back(downloads[(b - 2) * channels + c]);
+            cl::Event project;
+            backproject_kernel.setArg(0, dev_band_input[slot][c]);
+            backproject_kernel.setArg(1, dev_band_output[slot][c]);
+            backproject_kernel.setArg(2, dev_lut[c]);
+            queue.enqueueNDRangeKernel(backproject_kernel, cl::NullRange, cl::NDRange(band_bytes_used / sizeof(unsigned short)),
+                                       cl::NullRange, &wait_project, &project);
+            queue.flush();
+
+            std::vector<cl::Event> wait_result(1, project);
+            cl::Event download;
+            download_queue.enqueueReadBuffer(dev_band_output[slot][c], CL_FALSE, 0, band_bytes_used,
+                                             host_band_output[slot].data() + c * slot_pixels, &wait_result, &download);
+            download_queue.flush();
+
+            project_uploads.push_back(upload);
+            project_events.push_back(project);
+            downloads.push_back(download);
+            slot_uploads[slot].push_back(upload);
+        }
+
+        // the previous band is written while this one is on the device
+        if (b >= 1) write_band(b - 1);
+    }
+    write_band(num_bands - 1);
+    download_queue.finish();
+
+    double wall_time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    double upload_time = total_event_time(hist_uploads) + total_event_time(project_uploads);
+    double download_time = total_event_time(downloads);
+    double kernel_time = total_event_time(hist_events) + total_event_time(project_events) + total_event_time(lut_events);
+
+    std::cout << "\nTiled Streaming Metrics (seconds) (Bins: " << num_bins << ", Bands: " << num_bands
+              << ", Channels: " << channels << "):\n";
+    std::cout << "  Input Read Time (mapped file to band slots): " << read_time << "\n";
+    std::cout << "  Pass 1 Upload Time: " << total_event_time(hist_uploads) << "\n";
+    std::cout << "  Pass 1 Histogram Kernel Time: " << total_event_time(hist_events) << "\n";
+    std::cout << "  Scan + LUT Kernel Time: " << total_event_time(lut_events) << "\n";
+    std::cout << "  Pass 2 Upload Time: " << total_event_time(project_uploads) << "\n";
+    std::cout << "  Pass 2 Back Projection Kernel Time: " << total_event_time(project_events) << "\n";
+    std::cout << "  Pass 2 Download Time: " << download_time << "\n";
+    std::cout << "  Output Write Time (band slots to mapped file): " << write_time << "\n";
+    std::cout << "  Serialised Total (host I/O + transfers + kernels): "
+              << read_time + write_time + upload_time + download_time + kernel_time << "\n";
+    std::cout << "  Wall Time (with overlap): " << wall_time << "\n";
+}
+
+// "out.ppm" -> "out_thumb.ppm"
+std::string thumbnail_filename(const std::string& filename) {
+    size_t dot = filename.find_last_of('.');
+    size_t slash = filename.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return filename + "_thumb";
+    return filename.substr(0, dot) + "_thumb" + filename.substr(dot);
+}
+
 int main(int argc, char **argv) {
     int platform_id = 0;
     int device_id = 0;
+    std::string device_selector = "0";
     char image_filename[256] = "mdr16.ppm"; // C-style string with reasonable size
     int num_bins = 256;
-    char scan_kernel_type[3] = "bl"; // "bl" or "hs"
+    char scan_kernel_type[16] = "bl"; // "bl", "hs", "seg" or "lb"
+    bool force_tiled = false;
+    size_t band_budget_mb = 0; // 0 = derive from device limits
+    char output_filename[256] = ""; // empty = do not save
+    TransferMode transfer_mode = TRANSFER_COPY;
+    bool benchmark_transfers = false;
+    int thumbnail_factor = 0; // 0 = no thumbnail
+    char backend[16] = "opencl"; // "opencl", "compute" or "compare"
+    ComputeHistogram compute_histogram = COMPUTE_HISTOGRAM_ATOMIC;
+    char compute_cache_dir[256] = ""; // empty = $HOME
 
     // Parse command-line arguments
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-p") == 0 && i < argc - 1) { platform_id = atoi(argv[++i]); }
-        else if (strcmp(argv[i], "-d") == 0 && i < argc - 1) { device_id = atoi(argv[++i]); }
+        else if (strcmp(argv[i], "-d") == 0 && i < argc - 1) { device_selector = argv[++i]; }
         else if (strcmp(argv[i], "-l") == 0) { std::cout << ListPlatformsDevices() << std::endl; return 0; }
         else if (strcmp(argv[i], "-f") == 0 && i < argc - 1) { strcpy(image_filename, argv[++i]); }
         else if (strcmp(argv[i], "-b") == 0 && i < argc - 1) { num_bins = atoi(argv[++i]); }
         else if (strcmp(argv[i], "-s") == 0 && i < argc - 1) { strcpy(scan_kernel_type, argv[++i]); }
+        else if (strcmp(argv[i], "-t") == 0) { force_tiled = true; }
+        else if (strcmp(argv[i], "-m") == 0 && i < argc - 1) { band_budget_mb = atoi(argv[++i]); }
+        else if (strcmp(argv[i], "-o") == 0 && i < argc - 1) { strcpy(output_filename, argv[++i]); }
+        else if (strcmp(argv[i], "-x") == 0 && i < argc - 1) {
+            if (!ParseTransferMode(argv[++i], transfer_mode)) {
+                std::cerr << "Error: Transfer mode must be copy, pinned, mapped, zerocopy or auto" << std::endl;
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-X") == 0) { benchmark_transfers = true; }
+        else if (strcmp(argv[i], "-z") == 0 && i < argc - 1) { thumbnail_factor = atoi(argv[++i]); }
+        else if (strcmp(argv[i], "-B") == 0 && i < argc - 1) { strcpy(backend, argv[++i]); }
+        else if (strcmp(argv[i], "-H") == 0 && i < argc - 1) {
+            if (!ParseComputeHistogram(argv[++i], compute_histogram)) {
+                std::cerr << "Error: Boost.Compute histogram must be sort or atomic" << std::endl;
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-c") == 0 && i < argc - 1) { strcpy(compute_cache_dir, argv[++i]); }
         else if (strcmp(argv[i], "-h") == 0) { print_help(); return 0; }
     }
 
@@ -39,43 +338,50 @@ int main(int argc, char **argv) {
         std::cerr << "Error: Number of bins must be between 1 and 1025" << std::endl;
         return 1;
     }
-    if (strcmp(scan_kernel_type, "bl") != 0 && strcmp(scan_kernel_type, "hs") != 0) {
-        std::cerr << "Error: Scan kernel must be 'bl' (Blelloch) or 'hs' (Hillis-Steele)" << std::endl;
+    if (strcmp(scan_kernel_type, "bl") != 0 && strcmp(scan_kernel_type, "hs") != 0 &&
+        strcmp(scan_kernel_type, "seg") != 0 && strcmp(scan_kernel_type, "lb") != 0) {
+        std::cerr << "Error: Scan kernel must be 'bl' (Blelloch), 'hs' (Hillis-Steele), 'seg' (segmented) or 'lb' (look-back)" << std::endl;
+        return 1;
+    }
+
+    if (strcmp(backend, "opencl") != 0 && strcmp(backend, "compute") != 0 && strcmp(backend, "compare") != 0) {
+        std::cerr << "Error: Backend must be 'opencl', 'compute' (Boost.Compute) or 'compare'" << std::endl;
+        return 1;
+    }
+#ifndef USE_BOOST_COMPUTE
+    if (strcmp(backend, "opencl") != 0) {
+        std::cerr << "Error: Built without the Boost.Compute backend, rebuild with make BOOST_COMPUTE=1" << std::endl;
+        return 1;
+    }
+#endif
+
+    if (thumbnail_factor != 0 && (thumbnail_factor < 2 || thumbnail_factor > 255)) {
+        // 255 keeps the sum of a block of 16-bit values within 32 bits
+        std::cerr << "Error: Thumbnail factor must be between 2 and 255" << std::endl;
         return 1;
     }
 
     cimg::exception_mode(0);
 
     try {
-        // Load input image
-        CImg<unsigned short> image_input;
-        bool is_8bit = false;
-        FILE* file = fopen(image_filename, "rb");
-        if (!file) throw CImgIOException("Cannot open file");
-        char magic[3] = {0};
-        int maxval = 0;
-        fscanf(file, "%2s %*d %*d %d", magic, &maxval);
-        fclose(file);
-        is_8bit = (maxval <= 255);
-
-        if (is_8bit) {
-            CImg<unsigned char> image_8bit(image_filename);
-            image_input.assign(image_8bit.width(), image_8bit.height(), 1, image_8bit.spectrum());
-            cimg_forXYC(image_input, x, y, c) {
-                image_input(x, y, 0, c) = (unsigned short)(image_8bit(x, y, 0, c) * 257); // Scale 8-bit to 16-bit
-            }
-        } else {
-            image_input = CImg<unsigned short>(image_filename);
-        }
-
-        CImgDisplay disp_input(image_input, "Input Image");
+        // Map the input image and parse its header; the raster is decoded later, whole or band by band
+        PNMImage pnm(image_filename);
 
         // Setup OpenCL
+        if (!SelectDevice(device_selector, platform_id, device_id)) {
+            std::cerr << "Error: no device matches " << device_selector << std::endl;
+            return 1;
+        }
         cl::Context context = GetContext(platform_id, device_id);
         std::cout << "Running on " << GetPlatformName(platform_id) << ", " 
                   << GetDeviceName(platform_id, device_id) << std::endl;
         cl::CommandQueue queue(context, context.getInfo<CL_CONTEXT_DEVICES>()[0], CL_QUEUE_PROFILING_ENABLE);
 
+        if (benchmark_transfers) {
+            std::cout << BenchmarkTransfers(context, queue, pnm.width * pnm.height * sizeof(unsigned short));
+            return 0;
+        }
+
         // Load and build kernels
         cl::Program::Sources sources;
         AddSources(sources, "kernels/my_kernels.cl");
@@ -89,11 +395,34 @@ int main(int argc, char **argv) {
         }
 
         // Image properties
-        size_t width = image_input.width();
-        size_t height = image_input.height();
-        size_t channels = image_input.spectrum();
+        size_t width = pnm.width;
+        size_t height = pnm.height;
+        size_t channels = pnm.channels;
         size_t image_size = width * height;
 
+        // Fall back to tiled streaming when a whole channel (input + output) does not fit on the device
+        cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+        cl_ulong max_alloc_size = device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>();
+        cl_ulong global_mem_size = device.getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>();
+        cl_ulong channel_bytes = image_size * sizeof(unsigned short);
+        if (force_tiled || image_size > INT_MAX || channel_bytes > max_alloc_size ||
+            channels * channel_bytes * 2 > global_mem_size) {
+            if (thumbnail_factor) std::cout << "Thumbnails are not produced in tiled streaming mode" << std::endl;
+            if (strcmp(backend, "opencl") != 0) std::cout << "Tiled streaming mode uses the OpenCL backend" << std::endl;
+            equalise_tiled(context, program, pnm, output_filename, num_bins, scan_kernel_type, band_budget_mb << 20);
+            return 0;
+        }
+
+        // Decode the whole image
+        std::chrono::high_resolution_clock::time_point load_start = std::chrono::high_resolution_clock::now();
+        CImg<unsigned short> image_input;
+        pnm.to_planar(image_input); // samples are scaled from 0..maxval to 16-bit
+        std::cout << "Image load time: "
+                  << std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - load_start).count()
+                  << " seconds" << std::endl;
+
+        CImgDisplay disp_input(image_input, "Input Image");
+
         // Split into channels
         std::vector<CImg<unsigned short> > input_channels(channels);
         for (int c = 0; c < channels; c++) {
@@ -103,19 +432,95 @@ int main(int argc, char **argv) {
             }
         }
 
+        // Boost.Compute backend: the whole pipeline per channel, results kept on the host
+        bool use_compute = (strcmp(backend, "opencl") != 0);
+        std::vector<ComputeChannelResult> compute_results(use_compute ? channels : 0);
+#ifdef USE_BOOST_COMPUTE
+        if (use_compute) {
+            // Startup: programs are compiled on a cold cache and loaded from it on later runs
+            if (compute_cache_dir[0]) SetComputeCacheDir(compute_cache_dir);
+            size_t cached_programs = CountCachedPrograms();
+            std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+            ComputeEqualiser equaliser(context, num_bins, compute_histogram);
+            equaliser.prewarm();
+            double startup_time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+            size_t compiled_programs = CountCachedPrograms() - cached_programs;
+            std::cout << "Boost.Compute startup (" << GetComputeCacheDir() << ", ";
+            if (compiled_programs) std::cout << "cold: compiled and saved " << compiled_programs << " programs";
+            else std::cout << "warm: all programs loaded from the cache";
+            std::cout << "): " << startup_time << " seconds" << std::endl;
+            for (int c = 0; c < channels; c++) {
+                equaliser.equalise(input_channels[c].data(), image_size, compute_results[c]);
+            }
+        }
+#endif
+
+        if (strcmp(backend, "compute") == 0) {
+            if (thumbnail_factor) std::cout << "Thumbnails are produced by the OpenCL backend only" << std::endl;
+            const char* step_names[] = { "Input Transfer and Initialization", "Histogram Calculation (", "Cumulative Histogram (exclusive_scan)",
+                                         "Normalize LUT (gather + transform)", "Back Projection (gather) and Output Transfer" };
+            double combined_total_time = 0.0;
+            CImg<unsigned short> output_image(width, height, 1, channels);
+            for (int c = 0; c < channels; c++) {
+                std::cout << "\nBoost.Compute Wall Times (seconds) for Channel " << (c + 1) << " (Bins: " << num_bins << "):\n";
+                double overall_total_time = 0.0;
+                for (int step = 0; step < 5; step++) {
+                    std::cout << (step + 1) << ": " << step_names[step];
+                    if (step == 1) std::cout << GetComputeHistogramName(compute_histogram) << ")";
+                    std::cout << "\n  Total Time: " << compute_results[c].step_time[step] << "\n";
+                    overall_total_time += compute_results[c].step_time[step];
+                }
+                std::cout << "Overall Total Time for Channel " << (c + 1) << ": " << overall_total_time << " seconds\n";
+                combined_total_time += overall_total_time;
+                std::copy(compute_results[c].output.begin(), compute_results[c].output.end(), output_image.data(0, 0, 0, c));
+            }
+            if (channels > 1) {
+                std::cout << "\nTotal Time for ALL Channels Combined (Boost.Compute): " << combined_total_time << " seconds\n";
+            }
+            if (output_filename[0]) {
+                save_pnm(output_filename, output_image, pnm.maxval);
+            }
+            CImgDisplay disp_output(output_image, "Equalized Image (Boost.Compute)");
+            while (!(disp_input.is_closed() && disp_output.is_closed())) {
+                disp_input.wait(1);
+                disp_output.wait(1);
+                if (disp_input.is_keyESC() || disp_output.is_keyESC()) break;
+            }
+            return 0;
+        }
+        bool backends_agree = true;
+
         // Device buffers
-        std::vector<cl::Buffer> dev_image_input(channels);
-        std::vector<cl::Buffer> dev_image_output(channels);
+        std::vector<TransferBuffer> dev_image_input(channels);
+        std::vector<TransferBuffer> dev_image_output(channels);
         std::vector<cl::Buffer> dev_histogram(channels);
         std::vector<cl::Buffer> dev_cum_histogram(channels);
         std::vector<cl::Buffer> dev_lut(channels);
+        std::vector<cl::Buffer> dev_thumbnail(channels);
+        std::vector<cl::Buffer> dev_thumbnail_sums(channels);
+        size_t thumbnail_width = thumbnail_factor ? (width + thumbnail_factor - 1) / thumbnail_factor : 0;
+        size_t thumbnail_height = thumbnail_factor ? (height + thumbnail_factor - 1) / thumbnail_factor : 0;
+        CImg<unsigned short> thumbnail_image;
+        if (thumbnail_factor) thumbnail_image.assign(thumbnail_width, thumbnail_height, 1, channels);
+
+        // Histograms of all channels live in one buffer so that they can be scanned in a single dispatch;
+        // each channel gets a sub-buffer starting at a multiple of the device's base address alignment
+        cl_uint base_addr_align = device.getInfo<CL_DEVICE_MEM_BASE_ADDR_ALIGN>(); // in bits
+        size_t align_ints = std::max((size_t)1, (size_t)base_addr_align / (8 * sizeof(int)));
+        size_t histogram_stride = ((num_bins + align_ints - 1) / align_ints) * align_ints;
+        cl::Buffer dev_histograms(context, CL_MEM_READ_WRITE, channels * histogram_stride * sizeof(unsigned int));
 
         for (int c = 0; c < channels; c++) {
-            dev_image_input[c] = cl::Buffer(context, CL_MEM_READ_ONLY, image_size * sizeof(unsigned short));
-            dev_image_output[c] = cl::Buffer(context, CL_MEM_WRITE_ONLY, image_size * sizeof(unsigned short));
-            dev_histogram[c] = cl::Buffer(context, CL_MEM_READ_WRITE, num_bins * sizeof(unsigned int));
+            dev_image_input[c] = TransferBuffer(context, CL_MEM_READ_ONLY, image_size * sizeof(unsigned short), transfer_mode);
+            dev_image_output[c] = TransferBuffer(context, CL_MEM_WRITE_ONLY, image_size * sizeof(unsigned short), transfer_mode);
+            cl_buffer_region histogram_region = { c * histogram_stride * sizeof(unsigned int), num_bins * sizeof(unsigned int) };
+            dev_histogram[c] = dev_histograms.createSubBuffer(CL_MEM_READ_WRITE, CL_BUFFER_CREATE_TYPE_REGION, &histogram_region);
             dev_cum_histogram[c] = cl::Buffer(context, CL_MEM_READ_WRITE, num_bins * sizeof(unsigned int));
             dev_lut[c] = cl::Buffer(context, CL_MEM_READ_WRITE, 65536 * sizeof(unsigned short));
+            if (thumbnail_factor) {
+                dev_thumbnail[c] = cl::Buffer(context, CL_MEM_WRITE_ONLY, thumbnail_width * thumbnail_height * sizeof(unsigned short));
+                dev_thumbnail_sums[c] = cl::Buffer(context, CL_MEM_READ_WRITE, thumbnail_width * thumbnail_height * sizeof(unsigned int));
+            }
         }
 
         // Metrics structure
@@ -134,7 +539,6 @@ int main(int argc, char **argv) {
         std::vector<CImgDisplay> disp_norm_cum_hist(channels);
 
         // Device properties
-        cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
         cl_ulong local_mem_size;
         device.getInfo(CL_DEVICE_LOCAL_MEM_SIZE, &local_mem_size);
         size_t max_work_group_size;
@@ -142,12 +546,13 @@ int main(int argc, char **argv) {
         std::cout << "Local Memory Size: " << local_mem_size << " bytes, Max Work-Group Size: " 
                   << max_work_group_size << std::endl;
 
-        // Process each channel
+        const unsigned char white[] = {255};
+
+        // Process each channel: input transfer and histograms
         for (int c = 0; c < channels; c++) {
             // Step 1: Transfer input and initialize histogram
             cl::Event event1a, event1b;
-            queue.enqueueWriteBuffer(dev_image_input[c], CL_TRUE, 0, image_size * sizeof(unsigned short), 
-                                   input_channels[c].data(), NULL, &event1a);
+            dev_image_input[c].write(queue, input_channels[c].data(), image_size * sizeof(unsigned short), 0, &event1a);
             std::vector<unsigned int> zeros(num_bins, 0);
             queue.enqueueWriteBuffer(dev_histogram[c], CL_TRUE, 0, num_bins * sizeof(unsigned int), 
                                    zeros.data(), NULL, &event1b);
@@ -164,9 +569,10 @@ int main(int argc, char **argv) {
             // Step 2: Histogram calculation
             cl::Event event2a, event2b;
             cl::Kernel hist_kernel(program, "hist_local");
-            hist_kernel.setArg(0, dev_image_input[c]);
+            hist_kernel.setArg(0, dev_image_input[c].buffer());
             hist_kernel.setArg(1, dev_histogram[c]);
             hist_kernel.setArg(2, num_bins);
+            hist_kernel.setArg(3, (int)image_size);
             size_t local_size = 1024;
             if (num_bins * sizeof(int) > local_mem_size) {
                 std::cerr << "Error: Local histogram size (" << num_bins * sizeof(int) 
@@ -176,7 +582,7 @@ int main(int argc, char **argv) {
             if (local_size > max_work_group_size) {
                 local_size = max_work_group_size;
             }
-            hist_kernel.setArg(3, cl::Local(num_bins * sizeof(int)));
+            hist_kernel.setArg(4, cl::Local(num_bins * sizeof(int)));
             size_t global_size = image_size;
             if (global_size % local_size != 0) {
                 global_size = ((global_size / local_size) + 1) * local_size;
@@ -196,9 +602,9 @@ int main(int argc, char **argv) {
             metrics[c][1].total_time = metrics[c][1].kernel_time + metrics[c][1].transfer_time;
             metrics[c][1].work = image_size;
             metrics[c][1].span = 2;
+            if (use_compute) backends_agree &= CompareStep("histogram", c, histogram, compute_results[c].histogram);
 
             CImg<unsigned char> hist_img(num_bins, 200, 1, 1, 0);
-            const unsigned char white[] = {255};
             unsigned int max_hist = *std::max_element(histogram.begin(), histogram.end());
             for (int x = 0; x < num_bins; x++) {
                 int height = (int)((histogram[x] / (float)max_hist) * 200);
@@ -207,20 +613,51 @@ int main(int argc, char **argv) {
             char hist_title[32];
             sprintf(hist_title, "Histogram Channel %d", c + 1);
             disp_hist[c] = CImgDisplay(hist_img, hist_title);
+        }
 
-            
+        // Step 3 (segmented): scan the histograms of all channels in a single launch, one work group per channel
+        bool segmented = (strcmp(scan_kernel_type, "seg") == 0);
+        cl::Event event3_segmented;
+        if (segmented) {
+            size_t scan_local_size = 1;
+            while (scan_local_size * 2 <= std::min((size_t)num_bins, max_work_group_size)) scan_local_size *= 2;
+            cl::Kernel segmented_kernel(program, "scan_segmented");
+            segmented_kernel.setArg(0, dev_histograms);
+            segmented_kernel.setArg(1, num_bins);
+            segmented_kernel.setArg(2, (int)histogram_stride);
+            segmented_kernel.setArg(3, cl::Local(scan_local_size * sizeof(int)));
+            queue.enqueueNDRangeKernel(segmented_kernel, cl::NullRange, cl::NDRange(channels * scan_local_size),
+                                       cl::NDRange(scan_local_size), NULL, &event3_segmented);
+            event3_segmented.wait();
+        }
 
+        std::unique_ptr<PrefixScan<int> > prefix_scan;
+        if (strcmp(scan_kernel_type, "lb") == 0) prefix_scan.reset(new PrefixScan<int>(context));
+
+        // Process each channel: scan, LUT and back projection
+        for (int c = 0; c < channels; c++) {
             // Step 3: Cumulative histogram
             cl::Event event3a, event3b;
-            const char* kernel_name = (strcmp(scan_kernel_type, "bl") == 0) ? "scan_bl" : "scan_hs";
-            cl::Kernel scan_kernel(program, kernel_name);
-            scan_kernel.setArg(0, dev_histogram[c]);
-            scan_kernel.setArg(1, num_bins);
-            queue.enqueueNDRangeKernel(scan_kernel, cl::NullRange, cl::NDRange(num_bins), 
-                                     cl::NullRange, NULL, &event3a);
-            event3a.wait();
-            metrics[c][2].kernel_time = (event3a.getProfilingInfo<CL_PROFILING_COMMAND_END>() - 
-                                       event3a.getProfilingInfo<CL_PROFILING_COMMAND_START>()) * 1e-9;
+            if (segmented) {
+                // a single launch served all channels, so each is charged an equal share of it
+                metrics[c][2].kernel_time = (event3_segmented.getProfilingInfo<CL_PROFILING_COMMAND_END>() -
+                                           event3_segmented.getProfilingInfo<CL_PROFILING_COMMAND_START>()) * 1e-9 / channels;
+            } else if (prefix_scan) {
+                prefix_scan->exclusive(queue, dev_histogram[c], dev_histogram[c], num_bins, &event3a);
+                event3a.wait();
+                metrics[c][2].kernel_time = (event3a.getProfilingInfo<CL_PROFILING_COMMAND_END>() - 
+                                           event3a.getProfilingInfo<CL_PROFILING_COMMAND_START>()) * 1e-9;
+            } else {
+                const char* kernel_name = (strcmp(scan_kernel_type, "bl") == 0) ? "scan_bl" : "scan_hs";
+                cl::Kernel scan_kernel(program, kernel_name);
+                scan_kernel.setArg(0, dev_histogram[c]);
+                scan_kernel.setArg(1, num_bins);
+                queue.enqueueNDRangeKernel(scan_kernel, cl::NullRange, cl::NDRange(num_bins), 
+                                         cl::NullRange, NULL, &event3a);
+                event3a.wait();
+                metrics[c][2].kernel_time = (event3a.getProfilingInfo<CL_PROFILING_COMMAND_END>() - 
+                                           event3a.getProfilingInfo<CL_PROFILING_COMMAND_START>()) * 1e-9;
+            }
 
             std::vector<unsigned int> cum_histogram(num_bins);
             queue.enqueueReadBuffer(dev_histogram[c], CL_TRUE, 0, num_bins * sizeof(unsigned int), 
@@ -229,9 +666,10 @@ int main(int argc, char **argv) {
             metrics[c][2].transfer_time = (event3b.getProfilingInfo<CL_PROFILING_COMMAND_END>() - 
                                          event3b.getProfilingInfo<CL_PROFILING_COMMAND_START>()) * 1e-9;
             metrics[c][2].total_time = metrics[c][2].kernel_time + metrics[c][2].transfer_time;
-            metrics[c][2].work = (strcmp(scan_kernel_type, "bl") == 0) ? (2 * num_bins - 1) : 
+            metrics[c][2].work = (strcmp(scan_kernel_type, "hs") != 0) ? (2 * num_bins - 1) : 
                                  (num_bins * (size_t)(log2((double)num_bins)));
             metrics[c][2].span = (size_t)log2((double)num_bins);
+            if (use_compute) backends_agree &= CompareStep("cumulative histogram", c, cum_histogram, compute_results[c].cum_histogram);
 
             CImg<unsigned char> cum_hist_img(num_bins, 200, 1, 1, 0);
             unsigned int max_cum_hist = cum_histogram[num_bins - 1];
@@ -266,6 +704,7 @@ int main(int argc, char **argv) {
             metrics[c][3].total_time = metrics[c][3].kernel_time + metrics[c][3].transfer_time;
             metrics[c][3].work = 65536;
             metrics[c][3].span = 1;
+            if (use_compute) backends_agree &= CompareStep("LUT", c, lut, compute_results[c].lut);
 
             CImg<unsigned char> norm_cum_hist_img(num_bins, 200, 1, 1, 0);
             for (int x = 0; x < num_bins; x++) {
@@ -278,27 +717,69 @@ int main(int argc, char **argv) {
             disp_norm_cum_hist[c] = CImgDisplay(norm_cum_hist_img, norm_cum_hist_title);
             
 
-            // Step 5: Back projection
+            // Step 5: Back projection, with the thumbnail in the same pass when one is requested
             cl::Event event5a, event5b;
-            cl::Kernel backproject_kernel(program, "back_project");
-            backproject_kernel.setArg(0, dev_image_input[c]);
-            backproject_kernel.setArg(1, dev_image_output[c]);
-            backproject_kernel.setArg(2, dev_lut[c]);
-            queue.enqueueNDRangeKernel(backproject_kernel, cl::NullRange, cl::NDRange(image_size), 
-                                     cl::NullRange, NULL, &event5a);
+            if (thumbnail_factor) {
+                // one work item per pixel, cell sums reduced in local memory and then with global atomics
+                size_t tile = (max_work_group_size >= 256) ? 16 : 8;
+                cl::Event fill_event, mean_event;
+                queue.enqueueFillBuffer(dev_thumbnail_sums[c], 0u, 0, thumbnail_width * thumbnail_height * sizeof(unsigned int),
+                                        NULL, &fill_event);
+
+                cl::Kernel backproject_kernel(program, "back_project_thumbnail");
+                backproject_kernel.setArg(0, dev_image_input[c].buffer());
+                backproject_kernel.setArg(1, dev_image_output[c].buffer());
+                backproject_kernel.setArg(2, dev_lut[c]);
+                backproject_kernel.setArg(3, dev_thumbnail_sums[c]);
+                backproject_kernel.setArg(4, (int)width);
+                backproject_kernel.setArg(5, (int)height);
+                backproject_kernel.setArg(6, thumbnail_factor);
+                backproject_kernel.setArg(7, cl::Local(tile * tile * sizeof(unsigned int)));
+                queue.enqueueNDRangeKernel(backproject_kernel, cl::NullRange,
+                                         cl::NDRange((width + tile - 1) / tile * tile, (height + tile - 1) / tile * tile),
+                                         cl::NDRange(tile, tile), NULL, &event5a);
+
+                cl::Kernel mean_kernel(program, "thumbnail_mean");
+                mean_kernel.setArg(0, dev_thumbnail_sums[c]);
+                mean_kernel.setArg(1, dev_thumbnail[c]);
+                mean_kernel.setArg(2, (int)width);
+                mean_kernel.setArg(3, (int)height);
+                mean_kernel.setArg(4, thumbnail_factor);
+                queue.enqueueNDRangeKernel(mean_kernel, cl::NullRange, cl::NDRange(thumbnail_width, thumbnail_height),
+                                         cl::NullRange, NULL, &mean_event);
+                mean_event.wait();
+                metrics[c][4].kernel_time = (fill_event.getProfilingInfo<CL_PROFILING_COMMAND_END>() -
+                                           fill_event.getProfilingInfo<CL_PROFILING_COMMAND_START>()) * 1e-9 +
+                                          (mean_event.getProfilingInfo<CL_PROFILING_COMMAND_END>() -
+                                           mean_event.getProfilingInfo<CL_PROFILING_COMMAND_START>()) * 1e-9;
+            } else {
+                cl::Kernel backproject_kernel(program, "back_project");
+                backproject_kernel.setArg(0, dev_image_input[c].buffer());
+                backproject_kernel.setArg(1, dev_image_output[c].buffer());
+                backproject_kernel.setArg(2, dev_lut[c]);
+                queue.enqueueNDRangeKernel(backproject_kernel, cl::NullRange, cl::NDRange(image_size), 
+                                         cl::NullRange, NULL, &event5a);
+            }
             event5a.wait();
-            metrics[c][4].kernel_time = (event5a.getProfilingInfo<CL_PROFILING_COMMAND_END>() - 
+            metrics[c][4].kernel_time += (event5a.getProfilingInfo<CL_PROFILING_COMMAND_END>() - 
                                        event5a.getProfilingInfo<CL_PROFILING_COMMAND_START>()) * 1e-9;
 
             std::vector<unsigned short> output_buffer(image_size);
-            queue.enqueueReadBuffer(dev_image_output[c], CL_TRUE, 0, image_size * sizeof(unsigned short), 
-                                  output_buffer.data(), NULL, &event5b);
+            dev_image_output[c].read(queue, output_buffer.data(), image_size * sizeof(unsigned short), 0, &event5b);
             event5b.wait();
             metrics[c][4].transfer_time = (event5b.getProfilingInfo<CL_PROFILING_COMMAND_END>() - 
                                          event5b.getProfilingInfo<CL_PROFILING_COMMAND_START>()) * 1e-9;
+            if (thumbnail_factor) {
+                cl::Event event5c;
+                queue.enqueueReadBuffer(dev_thumbnail[c], CL_TRUE, 0, thumbnail_width * thumbnail_height * sizeof(unsigned short),
+                                      thumbnail_image.data(0, 0, 0, c), NULL, &event5c);
+                metrics[c][4].transfer_time += (event5c.getProfilingInfo<CL_PROFILING_COMMAND_END>() -
+                                              event5c.getProfilingInfo<CL_PROFILING_COMMAND_START>()) * 1e-9;
+            }
             metrics[c][4].total_time = metrics[c][4].kernel_time + metrics[c][4].transfer_time;
             metrics[c][4].work = image_size;
             metrics[c][4].span = 1;
+            if (use_compute) backends_agree &= CompareStep("back projection", c, output_buffer, compute_results[c].output);
 
             // Update input channel with output
             cimg_forXY(input_channels[c], x, y) {
@@ -308,10 +789,13 @@ int main(int argc, char **argv) {
 
         // Print metrics
         double combined_total_time = 0.0;
-        const char* scan_name = (strcmp(scan_kernel_type, "bl") == 0) ? "Blelloch" : "Hillis-Steele";
+        const char* scan_name = (strcmp(scan_kernel_type, "bl") == 0) ? "Blelloch" :
+                                (strcmp(scan_kernel_type, "hs") == 0) ? "Hillis-Steele" :
+                                (strcmp(scan_kernel_type, "seg") == 0) ? "Segmented Blelloch" : "Decoupled Look-back";
         for (int c = 0; c < channels; c++) {
             std::cout << "\nPerformance Metrics (seconds) and Complexity for Channel " << (c + 1) 
-                      << " (Bins: " << num_bins << ", Scan Kernel: " << scan_name << "):\n";
+                      << " (Bins: " << num_bins << ", Scan Kernel: " << scan_name
+                      << ", Transfer: " << GetTransferModeName(dev_image_input[c].mode()) << "):\n";
             std::cout << "1: Input Transfer and Initialization\n";
             std::cout << "  Transfer Time: " << metrics[c][0].transfer_time << "\n";
             std::cout << "  Kernel Time: " << metrics[c][0].kernel_time << "\n";
@@ -340,7 +824,9 @@ int main(int argc, char **argv) {
             std::cout << "  Work: " << metrics[c][3].work << " operations\n";
             std::cout << "  Span: " << metrics[c][3].span << " steps\n";
 
-            std::cout << "5: Back Projection\n";
+            std::cout << "5: Back Projection";
+            if (thumbnail_factor) std::cout << " + " << thumbnail_width << "x" << thumbnail_height << " Thumbnail";
+            std::cout << "\n";
             std::cout << "  Transfer Time: " << metrics[c][4].transfer_time << "\n";
             std::cout << "  Kernel Time: " << metrics[c][4].kernel_time << "\n";
             std::cout << "  Total Time: " << metrics[c][4].total_time << "\n";
@@ -352,9 +838,20 @@ int main(int argc, char **argv) {
                                       metrics[c][4].total_time;
             std::cout << "Overall Total Time for Channel " << (c + 1) << ": " 
                       << overall_total_time << " seconds\n";
+            if (use_compute) {
+                double compute_total_time = 0.0;
+                for (int step = 0; step < 5; step++) compute_total_time += compute_results[c].step_time[step];
+                std::cout << "Boost.Compute Wall Time for Channel " << (c + 1) << " (Histogram: "
+                          << GetComputeHistogramName(compute_histogram) << "): " << compute_total_time << " seconds\n";
+            }
             combined_total_time += overall_total_time;
         }
 
+        if (use_compute) {
+            std::cout << "\nBoost.Compute backend " << (backends_agree ? "matches" : "does NOT match")
+                      << " the OpenCL backend on every step of every channel" << std::endl;
+        }
+
         if (channels > 1) {
             std::cout << "\nTotal Time for ALL Channels Combined (RGB Image, Scan Kernel: " 
                       << scan_name << "): " << combined_total_time << " seconds\n";
@@ -367,12 +864,22 @@ int main(int argc, char **argv) {
                 output_image(x, y, 0, c) = input_channels[c](x, y);
             }
         }
+        if (output_filename[0]) {
+            save_pnm(output_filename, output_image, pnm.maxval);
+        }
         CImgDisplay disp_output(output_image, "Equalized Image");
+        CImgDisplay disp_thumbnail;
+        if (thumbnail_factor) {
+            if (output_filename[0]) {
+                save_pnm(thumbnail_filename(output_filename).c_str(), thumbnail_image, pnm.maxval);
+            }
+            disp_thumbnail.assign(thumbnail_image, "Equalized Thumbnail");
+        }
 
         // Wait for user to close windows
         bool all_closed = false;
         while (!all_closed) {
-            all_closed = disp_input.is_closed() && disp_output.is_closed();
+            all_closed = disp_input.is_closed() && disp_output.is_closed() && disp_thumbnail.is_closed();
             for (int c = 0; c < channels; c++) {
                 all_closed &= disp_hist[c].is_closed() && disp_cum_hist[c].is_closed() && 
                             disp_norm_cum_hist[c].is_closed();
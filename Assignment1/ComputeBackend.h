@@ -0,0 +1,188 @@
+#pragma once
+
+// Histogram equalisation written with Boost.Compute algorithms, as a second backend to the hand-written kernels in
+// kernels/my_kernels.cl. It runs on the same context and produces the same histogram, cumulative histogram, LUT and
+// output as the OpenCL path, so that the two can be checked against each other step by step:
+//   histogram   COMPUTE_HISTOGRAM_SORT: bin index per pixel, sort, reduce_by_key over a constant 1, scatter
+//               COMPUTE_HISTOGRAM_ATOMIC: a custom kernel with global atomic_inc, built through the program cache
+//   CDF         exclusive_scan
+//   LUT         the bin of each of the 65536 values (computed once), gathered from the CDF and scaled
+//   projection  gather, i.e. output[i] = lut[input[i]]
+// Step times are wall-clock, each step waiting for the queue. Programs go through the persistent cache of
+// ../tutorial4/ComputeCache.h, so only the first run on a device compiles them; prewarm() builds or loads them all
+// before the timed channels. The backend needs Boost.Compute and boost_filesystem/system, so ComputeEqualiser is
+// only compiled with USE_BOOST_COMPUTE (make BOOST_COMPUTE=1); the declarations the OpenCL path shares with it are
+// always available.
+//
+//   ComputeEqualiser equaliser(context, num_bins, COMPUTE_HISTOGRAM_ATOMIC);
+//   equaliser.prewarm();
+//   ComputeChannelResult result;
+//   equaliser.equalise(channel.data(), width * height, result);
+
+#ifdef USE_BOOST_COMPUTE
+#include "../tutorial4/ComputeCache.h"
+#endif
+
+#include "Utils.h"
+
+enum ComputeHistogram {
+    COMPUTE_HISTOGRAM_SORT,
+    COMPUTE_HISTOGRAM_ATOMIC
+};
+
+bool ParseComputeHistogram(const char* name, ComputeHistogram& method) {
+    if (strcmp(name, "sort") == 0) method = COMPUTE_HISTOGRAM_SORT;
+    else if (strcmp(name, "atomic") == 0) method = COMPUTE_HISTOGRAM_ATOMIC;
+    else return false;
+    return true;
+}
+
+const char* GetComputeHistogramName(ComputeHistogram method) {
+    return (method == COMPUTE_HISTOGRAM_SORT) ? "sort + reduce_by_key" : "atomic";
+}
+
+// Everything one channel produces, copied back to the host
+struct ComputeChannelResult {
+    std::vector<unsigned int> histogram;
+    std::vector<unsigned int> cum_histogram;
+    std::vector<unsigned short> lut;
+    std::vector<unsigned short> output;
+    double step_time[5]; // seconds: input transfer, histogram, scan, LUT, back projection + output transfer
+};
+
+#ifdef USE_BOOST_COMPUTE
+namespace compute = boost::compute;
+
+class ComputeEqualiser {
+public:
+    ComputeEqualiser(const cl::Context& context, int num_bins, ComputeHistogram method)
+        : context_(context()), num_bins_(num_bins), method_(method),
+          histogram_(num_bins, context_), cum_histogram_(num_bins, context_), lut_bins_(65536, context_),
+          lut_values_(65536, context_), lut_(65536, context_), keys_(num_bins, context_), counts_(num_bins, context_) {
+        cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+        queue_ = compute::command_queue(context_, compute::device(device()));
+
+        // same mapping from value to bin as hist_local and normalize_lut
+        int nr_bins = num_bins;
+        BOOST_COMPUTE_CLOSURE(int, value_bin, (int value), (nr_bins), {
+            return (int)(((float)value / 65535.0f) * (nr_bins - 1));
+        });
+        compute::transform(compute::make_counting_iterator<int>(0), compute::make_counting_iterator<int>(65536),
+                           lut_bins_.begin(), value_bin, queue_);
+
+        if (method == COMPUTE_HISTOGRAM_ATOMIC) {
+            const char source[] = BOOST_COMPUTE_STRINGIZE_SOURCE(
+                __kernel void histogram_atomic(__global const ushort* input, __global int* histogram, const int nr_bins, const int n) {
+                    int id = get_global_id(0);
+                    if (id < n)
+                        atomic_inc(&histogram[(int)(((float)input[id] / 65535.0f) * (nr_bins - 1))]);
+                }
+            );
+            compute::program program = compute::program_cache::get_global_cache(context_)->get_or_build(
+                "assignment1_histogram_atomic", "", source, context_);
+            histogram_kernel_ = program.create_kernel("histogram_atomic");
+        }
+        queue_.finish();
+    }
+
+    // Equalises a ramp of all 65536 values, so that every program of every step is built or loaded from the cache
+    void prewarm() {
+        std::vector<unsigned short> ramp(65536);
+        for (size_t i = 0; i < ramp.size(); i++) ramp[i] = (unsigned short)i;
+        ComputeChannelResult result;
+        equalise(ramp.data(), ramp.size(), result);
+    }
+
+    void equalise(const unsigned short* channel, size_t image_size, ComputeChannelResult& result) {
+        // Step 1: input transfer and histogram initialisation
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        if (input_.size() != image_size) {
+            input_ = compute::vector<compute::ushort_>(image_size, context_);
+            output_ = compute::vector<compute::ushort_>(image_size, context_);
+        }
+        compute::copy(channel, channel + image_size, input_.begin(), queue_);
+        compute::fill(histogram_.begin(), histogram_.end(), 0, queue_);
+        step(start, result.step_time[0]);
+
+        // Step 2: histogram
+        start = std::chrono::high_resolution_clock::now();
+        if (method_ == COMPUTE_HISTOGRAM_ATOMIC) {
+            histogram_kernel_.set_args(input_.get_buffer(), histogram_.get_buffer(), (cl_int)num_bins_, (cl_int)image_size);
+            size_t local_size = 256;
+            queue_.enqueue_1d_range_kernel(histogram_kernel_, 0, (image_size + local_size - 1) / local_size * local_size, local_size);
+        } else {
+            int nr_bins = num_bins_;
+            BOOST_COMPUTE_CLOSURE(int, pixel_bin, (compute::ushort_ value), (nr_bins), {
+                return (int)(((float)value / 65535.0f) * (nr_bins - 1));
+            });
+            if (pixel_bins_.size() != image_size) pixel_bins_ = compute::vector<int>(image_size, context_);
+            compute::transform(input_.begin(), input_.end(), pixel_bins_.begin(), pixel_bin, queue_);
+            compute::sort(pixel_bins_.begin(), pixel_bins_.end(), queue_);
+            std::pair<compute::vector<int>::iterator, compute::vector<int>::iterator> ends =
+                compute::reduce_by_key(pixel_bins_.begin(), pixel_bins_.end(), compute::make_constant_iterator<int>(1),
+                                       keys_.begin(), counts_.begin(), queue_);
+            compute::scatter(counts_.begin(), ends.second, keys_.begin(), histogram_.begin(), queue_);
+        }
+        step(start, result.step_time[1]);
+        result.histogram.resize(num_bins_);
+        compute::copy(histogram_.begin(), histogram_.end(), result.histogram.begin(), queue_);
+
+        // Step 3: cumulative histogram
+        start = std::chrono::high_resolution_clock::now();
+        compute::exclusive_scan(histogram_.begin(), histogram_.end(), cum_histogram_.begin(), queue_);
+        step(start, result.step_time[2]);
+        result.cum_histogram.resize(num_bins_);
+        compute::copy(cum_histogram_.begin(), cum_histogram_.end(), result.cum_histogram.begin(), queue_);
+
+        // Step 4: LUT, scaled exactly as normalize_lut does
+        start = std::chrono::high_resolution_clock::now();
+        float scale = 65535.0f / image_size;
+        BOOST_COMPUTE_CLOSURE(compute::ushort_, scale_cum, (int cum), (scale), {
+            return (ushort)(cum * scale);
+        });
+        compute::gather(lut_bins_.begin(), lut_bins_.end(), cum_histogram_.begin(), lut_values_.begin(), queue_);
+        compute::transform(lut_values_.begin(), lut_values_.end(), lut_.begin(), scale_cum, queue_);
+        step(start, result.step_time[3]);
+        result.lut.resize(65536);
+        compute::copy(lut_.begin(), lut_.end(), result.lut.begin(), queue_);
+
+        // Step 5: back projection through the LUT
+        start = std::chrono::high_resolution_clock::now();
+        compute::gather(input_.begin(), input_.end(), lut_.begin(), output_.begin(), queue_);
+        result.output.resize(image_size);
+        compute::copy(output_.begin(), output_.end(), result.output.begin(), queue_);
+        step(start, result.step_time[4]);
+    }
+
+private:
+    compute::context context_;
+    compute::command_queue queue_;
+    int num_bins_;
+    ComputeHistogram method_;
+    compute::kernel histogram_kernel_;
+    compute::vector<unsigned int> histogram_, cum_histogram_;
+    compute::vector<int> lut_bins_, lut_values_;
+    compute::vector<compute::ushort_> lut_, input_, output_;
+    compute::vector<int> pixel_bins_;
+    compute::vector<int> keys_, counts_; // reduce_by_key output of the sort histogram, one entry per bin at most
+
+    // waits for the queue and stores the seconds since start
+    void step(std::chrono::high_resolution_clock::time_point start, double& seconds) {
+        queue_.finish();
+        seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+};
+#endif
+
+// Compares one step of the two backends and prints the first difference; true when they agree
+template <typename T>
+bool CompareStep(const char* step, int channel, const std::vector<T>& opencl, const std::vector<T>& boost_compute) {
+    for (size_t i = 0; i < opencl.size(); i++) {
+        if ((i >= boost_compute.size()) || (opencl[i] != boost_compute[i])) {
+            std::cout << "Channel " << channel + 1 << " " << step << ": Boost.Compute differs from OpenCL at " << i << " ("
+                      << ((i < boost_compute.size()) ? (long long)boost_compute[i] : -1LL) << " vs " << (long long)opencl[i] << ")" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,315 @@
+#pragma once
+
+// Memory-mapped PNM (P2/P3/P5/P6) reader and writer.
+//
+// The file is mapped once and the header parsed in place. For binary files raster_data() is a zero-copy
+// view of the mapping; ASCII files are parsed into an owned buffer with the same layout (interleaved
+// samples, 16-bit samples big-endian) so callers see one representation. Conversion to the planar 16-bit
+// CImg used by the pipeline is a single pass that rescales samples from 0..maxval to the full 0..65535
+// range; 16-bit samples are swapped and de-interleaved 8 at a time with SSSE3, chosen at run time so that
+// one binary runs on any x86-64 CPU (SSE2 or scalar otherwise). Output is written through a shared
+// mapping of the new file and scaled back to its maxval.
+
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <cctype>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+#define PNM_SSSE3_DISPATCH // SSSE3 functions are compiled with target("ssse3") and picked by a CPU check
+#include <tmmintrin.h>
+#endif
+
+#include "CImg.h"
+
+using namespace cimg_library;
+
+class PNMImage {
+public:
+	size_t width;
+	size_t height;
+	size_t channels; // 1 for P2/P5, 3 for P3/P6
+	unsigned int maxval;
+
+	explicit PNMImage(const char* filename) : width(0), height(0), channels(0), maxval(0), mapping(0), mapping_size(0), raster(0) {
+		int fd = open(filename, O_RDONLY);
+		if (fd < 0) throw CImgIOException("PNM: cannot open file '%s'", filename);
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+			close(fd);
+			throw CImgIOException("PNM: cannot read file '%s'", filename);
+		}
+		mapping_size = st.st_size;
+		void* ptr = mmap(0, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd); // the mapping keeps the file alive
+		if (ptr == MAP_FAILED) throw CImgIOException("PNM: cannot map file '%s'", filename);
+		mapping = (const unsigned char*)ptr;
+		madvise(ptr, mapping_size, MADV_SEQUENTIAL);
+
+		try {
+			parse(filename);
+		} catch (...) {
+			munmap((void*)mapping, mapping_size);
+			throw;
+		}
+	}
+
+	~PNMImage() {
+		if (mapping) munmap((void*)mapping, mapping_size);
+	}
+
+	size_t bytes_per_sample() const { return (maxval > 255) ? 2 : 1; }
+	size_t raster_size() const { return width * height * channels * bytes_per_sample(); }
+
+	// The raster as stored: interleaved samples, 16-bit samples big-endian, raster_size() bytes. A view of the
+	// mapping for binary files, so 8-bit P5/P6 data can be used without any copy or conversion.
+	const unsigned char* raster_data() const { return raster; }
+
+	// Convert to a planar 16-bit image, scaling samples to the full 16-bit range
+	void to_planar(CImg<unsigned short>& image) const {
+		image.assign(width, height, 1, channels);
+		read_rows(0, height, image.data(), width * height);
+	}
+
+	// Convert rows [first_row, first_row + rows) to planar 16-bit samples scaled to the full 16-bit range: channel c
+	// of pixel (x, first_row + y) goes to dst[c * plane_stride + y * width + x]
+	void read_rows(size_t first_row, size_t rows, unsigned short* dst, size_t plane_stride) const {
+		size_t n = rows * width;
+		const unsigned char* src = raster_data() + first_row * width * channels * bytes_per_sample();
+
+		if (bytes_per_sample() == 1) {
+			for (size_t c = 0; c < channels; c++) {
+				unsigned short* plane = dst + c * plane_stride;
+				for (size_t i = 0; i < n; i++)
+					plane[i] = scale[src[i * channels + c]];
+			}
+			return;
+		}
+
+		if (channels == 1) swap_copy_16(dst, src, n);
+		else deinterleave_16(dst, plane_stride, src, n);
+		if (maxval != 65535) {
+			for (size_t c = 0; c < channels; c++) {
+				unsigned short* plane = dst + c * plane_stride;
+				for (size_t i = 0; i < n; i++)
+					plane[i] = scale[plane[i]];
+			}
+		}
+	}
+
+private:
+	const unsigned char* mapping;
+	size_t mapping_size;
+	const unsigned char* raster;
+	std::vector<unsigned char> ascii_raster; // owned raster for P2/P3
+	std::vector<unsigned short> scale; // sample -> 0..65535, clamped at maxval; empty for 16-bit samples with maxval 65535
+
+	PNMImage(const PNMImage&);
+	PNMImage& operator=(const PNMImage&);
+
+	// Skip whitespace and '#' comments, then read an unsigned decimal
+	static size_t read_number(const unsigned char*& p, const unsigned char* end, const char* filename) {
+		while (p < end) {
+			if (*p == '#') {
+				while (p < end && *p != '\n') p++;
+			} else if (isspace(*p)) {
+				p++;
+			} else {
+				break;
+			}
+		}
+		if (p >= end || !isdigit(*p)) throw CImgIOException("PNM: malformed file '%s'", filename);
+		size_t value = 0;
+		while (p < end && isdigit(*p)) value = value * 10 + (*p++ - '0');
+		return value;
+	}
+
+	void parse(const char* filename) {
+		const unsigned char* p = mapping;
+		const unsigned char* end = mapping + mapping_size;
+
+		if (mapping_size < 2 || p[0] != 'P' || (p[1] != '2' && p[1] != '3' && p[1] != '5' && p[1] != '6'))
+			throw CImgIOException("PNM: '%s' is not a P2/P3/P5/P6 file", filename);
+		bool binary = (p[1] == '5') || (p[1] == '6');
+		channels = (p[1] == '3' || p[1] == '6') ? 3 : 1;
+		p += 2;
+
+		width = read_number(p, end, filename);
+		height = read_number(p, end, filename);
+		maxval = (unsigned int)read_number(p, end, filename);
+		if (width == 0 || height == 0 || maxval == 0 || maxval > 65535)
+			throw CImgIOException("PNM: invalid header in '%s'", filename);
+
+		if (binary) {
+			p++; // exactly one whitespace character separates the header from the raster
+			if ((size_t)(end - p) < raster_size())
+				throw CImgIOException("PNM: truncated raster in '%s'", filename);
+			raster = p;
+		} else {
+			size_t samples = width * height * channels;
+			size_t bps = bytes_per_sample();
+			ascii_raster.resize(samples * bps);
+			for (size_t i = 0; i < samples; i++) {
+				size_t value = read_number(p, end, filename);
+				if (bps == 2) {
+					ascii_raster[2 * i] = (unsigned char)(value >> 8);
+					ascii_raster[2 * i + 1] = (unsigned char)value;
+				} else {
+					ascii_raster[i] = (unsigned char)value;
+				}
+			}
+			raster = ascii_raster.data();
+		}
+
+		if (maxval != 65535) {
+			scale.resize((bytes_per_sample() == 1) ? 256 : 65536);
+			for (size_t v = 0; v < scale.size(); v++)
+				scale[v] = (unsigned short)((std::min(v, (size_t)maxval) * 65535 + maxval / 2) / maxval);
+		}
+	}
+
+#if defined(PNM_SSSE3_DISPATCH)
+	static bool has_ssse3() {
+		static const bool supported = __builtin_cpu_supports("ssse3");
+		return supported;
+	}
+
+	// swap_copy_16 for the first n - n % 8 samples; returns how many were copied
+	__attribute__((target("ssse3")))
+	static size_t swap_copy_16_ssse3(unsigned short* dst, const unsigned char* src, size_t n) {
+		const __m128i swap = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8)
+			_mm_storeu_si128((__m128i*)(dst + i), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 2 * i)), swap));
+		return i;
+	}
+
+	// deinterleave_16 for the first n - n % 8 pixels; returns how many were copied
+	__attribute__((target("ssse3")))
+	static size_t deinterleave_16_ssse3(unsigned short* const planes[3], const unsigned char* src, size_t n) {
+		// masks[c][v]: the bytes of channel c, swapped, that 8 pixels (48 bytes) hold in their input vector v
+		__m128i masks[3][3];
+		for (int c = 0; c < 3; c++) {
+			for (int v = 0; v < 3; v++) {
+				unsigned char bytes[16];
+				for (int k = 0; k < 16; k++) {
+					int byte = 6 * (k / 2) + 2 * c + ((k % 2) ? 0 : 1);
+					bytes[k] = (byte / 16 == v) ? (unsigned char)(byte % 16) : 0x80;
+				}
+				masks[c][v] = _mm_loadu_si128((const __m128i*)bytes);
+			}
+		}
+
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m128i v0 = _mm_loadu_si128((const __m128i*)(src + 6 * i));
+			__m128i v1 = _mm_loadu_si128((const __m128i*)(src + 6 * i + 16));
+			__m128i v2 = _mm_loadu_si128((const __m128i*)(src + 6 * i + 32));
+			for (int c = 0; c < 3; c++) {
+				__m128i v = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, masks[c][0]), _mm_shuffle_epi8(v1, masks[c][1])),
+				                         _mm_shuffle_epi8(v2, masks[c][2]));
+				_mm_storeu_si128((__m128i*)(planes[c] + i), v);
+			}
+		}
+		return i;
+	}
+#endif
+
+	// Copy n big-endian 16-bit samples to native order
+	static void swap_copy_16(unsigned short* dst, const unsigned char* src, size_t n) {
+		size_t i = 0;
+#if defined(PNM_SSSE3_DISPATCH)
+		if (has_ssse3()) i = swap_copy_16_ssse3(dst, src, n);
+#endif
+		for (; i < n; i++)
+			dst[i] = (unsigned short)((src[2 * i] << 8) | src[2 * i + 1]);
+	}
+
+	// Copy n interleaved big-endian 16-bit RGB pixels to three native-order planes plane_stride samples apart
+	static void deinterleave_16(unsigned short* dst, size_t plane_stride, const unsigned char* src, size_t n) {
+		unsigned short* const planes[3] = { dst, dst + plane_stride, dst + 2 * plane_stride };
+		size_t i = 0;
+#if defined(PNM_SSSE3_DISPATCH)
+		if (has_ssse3()) i = deinterleave_16_ssse3(planes, src, n);
+#endif
+		for (const unsigned char* p = src + 6 * i; i < n; i++, p += 6) {
+			planes[0][i] = (unsigned short)((p[0] << 8) | p[1]);
+			planes[1][i] = (unsigned short)((p[2] << 8) | p[3]);
+			planes[2][i] = (unsigned short)((p[4] << 8) | p[5]);
+		}
+	}
+};
+
+// Writer of a P5 (1 channel) or P6 (3 channels) file through a shared mapping of the new file, filled
+// in bands of rows. Planar 16-bit samples are scaled from 0..65535 to 0..maxval, the inverse of the
+// scaling on load, and stored as 8-bit when maxval <= 255, otherwise as big-endian 16-bit.
+class PNMWriter {
+public:
+	PNMWriter(const char* filename, size_t width, size_t height, size_t channels, unsigned int maxval)
+		: width(width), channels(channels), maxval(maxval), mapping(0), mapping_size(0), raster(0) {
+		if (channels != 1 && channels != 3)
+			throw CImgIOException("PNM: cannot save %u-channel image to '%s'", (unsigned int)channels, filename);
+
+		char header[64];
+		int header_size = sprintf(header, "P%c\n%u %u\n%u\n", (channels == 1) ? '5' : '6', (unsigned int)width, (unsigned int)height, maxval);
+		mapping_size = header_size + width * height * channels * ((maxval > 255) ? 2 : 1);
+
+		int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) throw CImgIOException("PNM: cannot create file '%s'", filename);
+		if (ftruncate(fd, mapping_size) != 0) {
+			close(fd);
+			throw CImgIOException("PNM: cannot resize file '%s'", filename);
+		}
+		void* ptr = mmap(0, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (ptr == MAP_FAILED) throw CImgIOException("PNM: cannot map file '%s'", filename);
+
+		mapping = (unsigned char*)ptr;
+		memcpy(mapping, header, header_size);
+		raster = mapping + header_size;
+	}
+
+	~PNMWriter() {
+		if (mapping) munmap(mapping, mapping_size);
+	}
+
+	// Write rows [first_row, first_row + rows) from planar samples: channel c of pixel (x, first_row + y) is
+	// src[c * plane_stride + y * width + x]
+	void write_rows(size_t first_row, size_t rows, const unsigned short* src, size_t plane_stride) {
+		size_t bps = (maxval > 255) ? 2 : 1;
+		size_t n = rows * width;
+		unsigned char* dst = raster + first_row * width * channels * bps;
+		for (size_t i = 0; i < n; i++) {
+			for (size_t c = 0; c < channels; c++) {
+				unsigned int value = src[i + c * plane_stride];
+				if (maxval != 65535) value = (value * maxval + 32767) / 65535;
+				if (bps == 2) {
+					*dst++ = (unsigned char)(value >> 8);
+					*dst++ = (unsigned char)value;
+				} else {
+					*dst++ = (unsigned char)value;
+				}
+			}
+		}
+	}
+
+private:
+	size_t width;
+	size_t channels;
+	unsigned int maxval;
+	unsigned char* mapping;
+	size_t mapping_size;
+	unsigned char* raster;
+
+	PNMWriter(const PNMWriter&);
+	PNMWriter& operator=(const PNMWriter&);
+};
+
+// Write a whole planar 16-bit image, see PNMWriter
+void save_pnm(const char* filename, const CImg<unsigned short>& image, unsigned int maxval) {
+	PNMWriter writer(filename, image.width(), image.height(), image.spectrum(), maxval);
+	writer.write_rows(0, image.height(), image.data(), (size_t)image.width() * image.height());
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+// Prefix scan library for int, unsigned int and float arrays of any length (kernels/scan.cl).
+//
+// inclusive()/exclusive() run the single-pass decoupled look-back scan: every element is read and written
+// once and tiles pass their running totals to each other through a small status array. The
+// *_reduce_then_scan() variants run the classic three-phase scan (tile totals, recursive scan of the totals,
+// tile scans with offsets) and are kept for comparison. Input and output may be the same buffer.
+//
+//   PrefixScan<int> scan(context);
+//   scan.exclusive(queue, dev_histogram, dev_histogram, num_bins);
+
+#include "Utils.h"
+
+template <typename T> struct ScanTypeName;
+template <> struct ScanTypeName<int> { static const char* get() { return "int"; } };
+template <> struct ScanTypeName<unsigned int> { static const char* get() { return "uint"; } };
+template <> struct ScanTypeName<float> { static const char* get() { return "float"; } };
+
+template <typename T>
+class PrefixScan {
+public:
+	PrefixScan(const cl::Context& context, const string& kernel_file = "kernels/scan.cl", size_t work_group_size = 256, size_t items = 8)
+		: context_(context), state_tiles_(0) {
+		cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+
+		// largest power of two not above the requested and supported work-group sizes
+		size_t max_work_group_size = std::min(work_group_size, (size_t)device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>());
+		work_group_size_ = 1;
+		while (work_group_size_ * 2 <= max_work_group_size) work_group_size_ *= 2;
+		tile_size_ = work_group_size_ * items;
+
+		stringstream options;
+		options << "-DSCAN_T=" << ScanTypeName<T>::get() << " -DWG_SIZE=" << work_group_size_ << " -DITEMS=" << items;
+		program_ = BuildProgram(context, kernel_file, options.str());
+
+		lookback_kernel_ = cl::Kernel(program_, "scan_lookback");
+		reduce_kernel_ = cl::Kernel(program_, "scan_reduce");
+		downsweep_kernel_ = cl::Kernel(program_, "scan_downsweep");
+	}
+
+	void inclusive(const cl::CommandQueue& queue, const cl::Buffer& input, const cl::Buffer& output, size_t n, cl::Event* event = NULL) {
+		lookback(queue, input, output, n, false, event);
+	}
+
+	void exclusive(const cl::CommandQueue& queue, const cl::Buffer& input, const cl::Buffer& output, size_t n, cl::Event* event = NULL) {
+		lookback(queue, input, output, n, true, event);
+	}
+
+	void inclusive_reduce_then_scan(const cl::CommandQueue& queue, const cl::Buffer& input, const cl::Buffer& output, size_t n, cl::Event* event = NULL) {
+		reduce_then_scan(queue, input, output, n, false, 0, event);
+	}
+
+	void exclusive_reduce_then_scan(const cl::CommandQueue& queue, const cl::Buffer& input, const cl::Buffer& output, size_t n, cl::Event* event = NULL) {
+		reduce_then_scan(queue, input, output, n, true, 0, event);
+	}
+
+	size_t tile_size() const { return tile_size_; }
+	size_t work_group_size() const { return work_group_size_; }
+
+private:
+	cl::Context context_;
+	cl::Program program_;
+	cl::Kernel lookback_kernel_, reduce_kernel_, downsweep_kernel_;
+	size_t work_group_size_, tile_size_;
+
+	// look-back status (tile counter + flags), tile totals and tile prefixes, grown on demand
+	cl::Buffer state_, aggregates_, prefixes_;
+	size_t state_tiles_;
+
+	// tile totals for each recursion level of the reduce-then-scan
+	vector<cl::Buffer> tile_sums_;
+	vector<size_t> tile_sums_size_;
+
+	void lookback(const cl::CommandQueue& queue, const cl::Buffer& input, const cl::Buffer& output, size_t n, bool exclusive, cl::Event* event) {
+		if (n == 0) return;
+		size_t tiles = (n + tile_size_ - 1) / tile_size_;
+		if (tiles > state_tiles_) {
+			state_ = cl::Buffer(context_, CL_MEM_READ_WRITE, (tiles + 1) * sizeof(int));
+			aggregates_ = cl::Buffer(context_, CL_MEM_READ_WRITE, tiles * sizeof(T));
+			prefixes_ = cl::Buffer(context_, CL_MEM_READ_WRITE, tiles * sizeof(T));
+			state_tiles_ = tiles;
+		}
+		queue.enqueueFillBuffer(state_, 0, 0, (tiles + 1) * sizeof(int));
+
+		lookback_kernel_.setArg(0, input);
+		lookback_kernel_.setArg(1, output);
+		lookback_kernel_.setArg(2, (int)n);
+		lookback_kernel_.setArg(3, (int)exclusive);
+		lookback_kernel_.setArg(4, state_);
+		lookback_kernel_.setArg(5, aggregates_);
+		lookback_kernel_.setArg(6, prefixes_);
+		queue.enqueueNDRangeKernel(lookback_kernel_, cl::NullRange, cl::NDRange(tiles * work_group_size_),
+			cl::NDRange(work_group_size_), NULL, event);
+	}
+
+	void reduce_then_scan(const cl::CommandQueue& queue, const cl::Buffer& input, const cl::Buffer& output, size_t n, bool exclusive,
+		size_t level, cl::Event* event) {
+		if (n == 0) return;
+		size_t tiles = (n + tile_size_ - 1) / tile_size_;
+
+		if (tiles == 1) {
+			downsweep_kernel_.setArg(0, input);
+			downsweep_kernel_.setArg(1, output);
+			downsweep_kernel_.setArg(2, (int)n);
+			downsweep_kernel_.setArg(3, (int)exclusive);
+			downsweep_kernel_.setArg(4, output); // unused
+			downsweep_kernel_.setArg(5, 0);
+			queue.enqueueNDRangeKernel(downsweep_kernel_, cl::NullRange, cl::NDRange(work_group_size_),
+				cl::NDRange(work_group_size_), NULL, event);
+			return;
+		}
+
+		if (tile_sums_.size() <= level) {
+			tile_sums_.resize(level + 1);
+			tile_sums_size_.resize(level + 1, 0);
+		}
+		if (tile_sums_size_[level] < tiles) {
+			tile_sums_[level] = cl::Buffer(context_, CL_MEM_READ_WRITE, tiles * sizeof(T));
+			tile_sums_size_[level] = tiles;
+		}
+		cl::Buffer tile_sums = tile_sums_[level];
+
+		// phase 1: tile totals
+		reduce_kernel_.setArg(0, input);
+		reduce_kernel_.setArg(1, tile_sums);
+		reduce_kernel_.setArg(2, (int)n);
+		queue.enqueueNDRangeKernel(reduce_kernel_, cl::NullRange, cl::NDRange(tiles * work_group_size_),
+			cl::NDRange(work_group_size_));
+
+		// phase 2: exclusive scan of the totals, recursively
+		reduce_then_scan(queue, tile_sums, tile_sums, tiles, true, level + 1, NULL);
+
+		// phase 3: scan the tiles with their offsets
+		downsweep_kernel_.setArg(0, input);
+		downsweep_kernel_.setArg(1, output);
+		downsweep_kernel_.setArg(2, (int)n);
+		downsweep_kernel_.setArg(3, (int)exclusive);
+		downsweep_kernel_.setArg(4, tile_sums);
+		downsweep_kernel_.setArg(5, 1);
+		queue.enqueueNDRangeKernel(downsweep_kernel_, cl::NullRange, cl::NDRange(tiles * work_group_size_),
+			cl::NDRange(work_group_size_), NULL, event);
+	}
+};
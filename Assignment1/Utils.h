@@ -4,6 +4,12 @@
 #include <vector>
 #include <iostream>
 #include <sstream>
+#include <memory>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
 
 #define CL_USE_DEPRECATED_OPENCL_1_2_APIS
 #define CL_HPP_MINIMUM_OPENCL_VERSION 120
@@ -24,18 +30,195 @@ ostream& operator<< (ostream& out, const vector<T>& v) {
 	return out;
 }
 
-string GetPlatformName(int platform_id) {
+// Properties of one device, queried once when the registry is built
+struct DeviceInfo {
+	int platform_id;
+	int device_id;
+	cl::Device device;
+	string name, version, vendor, extensions;
+	cl_device_type type;
+	cl_uint compute_units;
+	cl_uint clock_mhz;
+	cl_ulong global_mem_size;
+	cl_ulong local_mem_size;
+	cl_ulong max_alloc_size;
+	size_t max_work_group_size;
+	double benchmark_score; // throughput measured by BenchmarkDevices, -1 until then and 0 when the device failed
+
+	bool has_extension(const string& extension) const {
+		return (" " + extensions + " ").find(" " + extension + " ") != string::npos;
+	}
+};
+
+struct PlatformInfo {
+	cl::Platform platform;
+	string name, version, vendor;
+	vector<DeviceInfo> devices;
+};
+
+vector<PlatformInfo> EnumeratePlatforms() {
 	vector<cl::Platform> platforms;
 	cl::Platform::get(&platforms);
-	return platforms[platform_id].getInfo<CL_PLATFORM_NAME>();
+
+	vector<PlatformInfo> registry(platforms.size());
+	for (unsigned int i = 0; i < platforms.size(); i++) {
+		PlatformInfo& platform = registry[i];
+		platform.platform = platforms[i];
+		platform.name = platforms[i].getInfo<CL_PLATFORM_NAME>();
+		platform.version = platforms[i].getInfo<CL_PLATFORM_VERSION>();
+		platform.vendor = platforms[i].getInfo<CL_PLATFORM_VENDOR>();
+
+		vector<cl::Device> devices;
+		platforms[i].getDevices((cl_device_type)CL_DEVICE_TYPE_ALL, &devices);
+		platform.devices.resize(devices.size());
+		for (unsigned int j = 0; j < devices.size(); j++) {
+			DeviceInfo& info = platform.devices[j];
+			info.platform_id = i;
+			info.device_id = j;
+			info.device = devices[j];
+			info.name = devices[j].getInfo<CL_DEVICE_NAME>();
+			info.version = devices[j].getInfo<CL_DEVICE_VERSION>();
+			info.vendor = devices[j].getInfo<CL_DEVICE_VENDOR>();
+			info.extensions = devices[j].getInfo<CL_DEVICE_EXTENSIONS>();
+			info.type = devices[j].getInfo<CL_DEVICE_TYPE>();
+			info.compute_units = devices[j].getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+			info.clock_mhz = devices[j].getInfo<CL_DEVICE_MAX_CLOCK_FREQUENCY>();
+			info.global_mem_size = devices[j].getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>();
+			info.local_mem_size = devices[j].getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+			info.max_alloc_size = devices[j].getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>();
+			info.max_work_group_size = devices[j].getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+			info.benchmark_score = -1.0;
+		}
+	}
+	return registry;
+}
+
+// Every platform and device, enumerated on first use and kept for the rest of the run
+vector<PlatformInfo>& GetDeviceRegistry() {
+	static vector<PlatformInfo> registry = EnumeratePlatforms();
+	return registry;
+}
+
+// NULL when the platform or device does not exist
+const DeviceInfo* FindDevice(int platform_id, int device_id) {
+	vector<PlatformInfo>& registry = GetDeviceRegistry();
+	if ((platform_id < 0) || (platform_id >= (int)registry.size())) return NULL;
+	if ((device_id < 0) || (device_id >= (int)registry[platform_id].devices.size())) return NULL;
+	return &registry[platform_id].devices[device_id];
+}
+
+string GetPlatformName(int platform_id) {
+	return GetDeviceRegistry()[platform_id].name;
 }
 
 string GetDeviceName(int platform_id, int device_id) {
-	vector<cl::Platform> platforms;
-	cl::Platform::get(&platforms);
-	vector<cl::Device> devices;
-	platforms[platform_id].getDevices((cl_device_type)CL_DEVICE_TYPE_ALL, &devices);
-	return devices[device_id].getInfo<CL_DEVICE_NAME>();
+	return GetDeviceRegistry()[platform_id].devices[device_id].name;
+}
+
+// Default micro-benchmark for BenchmarkDevices: a streaming kernel with a few multiply-adds per element, the mix of
+// most kernels in the tutorials. Returns billions of elements per second, best of three runs.
+double MicroBenchmarkDevice(const cl::Context& context, const cl::CommandQueue& queue) {
+	const char* source =
+		"kernel void micro_benchmark(global const float* A, global float* B) {\n"
+		"	int id = get_global_id(0);\n"
+		"	float a = A[id];\n"
+		"	for (int i = 0; i < 16; i++) a = a*0.99f + 0.5f;\n"
+		"	B[id] = a;\n"
+		"}\n";
+	cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+	size_t elements = std::min((size_t)1 << 22, (size_t)(device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>() / sizeof(float)));
+
+	cl::Program program(context, string(source));
+	program.build();
+	cl::Kernel kernel(program, "micro_benchmark");
+	cl::Buffer A(context, CL_MEM_READ_ONLY, elements * sizeof(float));
+	cl::Buffer B(context, CL_MEM_WRITE_ONLY, elements * sizeof(float));
+	queue.enqueueFillBuffer(A, 1.0f, 0, elements * sizeof(float));
+	kernel.setArg(0, A);
+	kernel.setArg(1, B);
+
+	double best = 0.0;
+	for (int i = 0; i < 4; i++) {
+		cl::Event event;
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(elements), cl::NullRange, NULL, &event);
+		event.wait();
+		double seconds = (double)(event.getProfilingInfo<CL_PROFILING_COMMAND_END>() - event.getProfilingInfo<CL_PROFILING_COMMAND_START>()) * 1e-9;
+		if (i > 0) best = std::max(best, elements / seconds * 1e-9); // the first run warms up
+	}
+	return best;
+}
+
+// Scores every device with a workload run on its own context and profiling queue, higher is faster
+void BenchmarkDevices(const function<double(const cl::Context&, const cl::CommandQueue&)>& workload = MicroBenchmarkDevice) {
+	vector<PlatformInfo>& registry = GetDeviceRegistry();
+	for (unsigned int i = 0; i < registry.size(); i++) {
+		for (unsigned int j = 0; j < registry[i].devices.size(); j++) {
+			DeviceInfo& info = registry[i].devices[j];
+			try {
+				cl::Context context({ info.device });
+				cl::CommandQueue queue(context, CL_QUEUE_PROFILING_ENABLE);
+				info.benchmark_score = workload(context, queue);
+			}
+			catch (const cl::Error&) {
+				info.benchmark_score = 0.0;
+			}
+		}
+	}
+}
+
+// Measured throughput once benchmarked, otherwise compute units x clock as a rough guess
+double GetDeviceScore(const DeviceInfo& info) {
+	return (info.benchmark_score >= 0.0) ? info.benchmark_score : (double)info.compute_units * info.clock_mhz;
+}
+
+// Resolves a device selector to platform and device ids:
+//   a number      that device on platform_id
+//   cpu, gpu, accelerator   the best scoring device of that type
+//   fastest       the best scoring device after BenchmarkDevices has measured all of them
+//   anything else the best scoring device whose device or platform name contains it, ignoring case
+// Returns false when no device matches.
+bool SelectDevice(const string& selector, int& platform_id, int& device_id) {
+	if (!selector.empty() && (selector.find_first_not_of("0123456789") == string::npos)) {
+		device_id = atoi(selector.c_str());
+		return FindDevice(platform_id, device_id) != NULL;
+	}
+
+	string key = selector;
+	std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+	cl_device_type type = 0;
+	if (key == "cpu") type = CL_DEVICE_TYPE_CPU;
+	else if (key == "gpu") type = CL_DEVICE_TYPE_GPU;
+	else if (key == "accelerator") type = CL_DEVICE_TYPE_ACCELERATOR;
+
+	vector<PlatformInfo>& registry = GetDeviceRegistry();
+	if (key == "fastest") {
+		bool measured = true;
+		for (unsigned int i = 0; i < registry.size(); i++)
+			for (unsigned int j = 0; j < registry[i].devices.size(); j++)
+				measured = measured && (registry[i].devices[j].benchmark_score >= 0.0);
+		if (!measured) BenchmarkDevices();
+	}
+
+	const DeviceInfo* best = NULL;
+	for (unsigned int i = 0; i < registry.size(); i++) {
+		string platform_name = registry[i].name;
+		std::transform(platform_name.begin(), platform_name.end(), platform_name.begin(), ::tolower);
+		for (unsigned int j = 0; j < registry[i].devices.size(); j++) {
+			const DeviceInfo& info = registry[i].devices[j];
+			string name = info.name;
+			std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+			bool match;
+			if (type) match = (info.type & type) != 0;
+			else if (key == "fastest") match = true;
+			else match = (name.find(key) != string::npos) || (platform_name.find(key) != string::npos);
+			if (match && (!best || (GetDeviceScore(info) > GetDeviceScore(*best)))) best = &info;
+		}
+	}
+	if (!best) return false;
+
+	platform_id = best->platform_id;
+	device_id = best->device_id;
+	return true;
 }
 
 const char *getErrorString(cl_int error) {
@@ -121,41 +304,84 @@ void CheckError(cl_int error) {
 	}
 }
 
+// Kernel sources compiled into the executable. Building with -DEMBED_KERNELS includes embedded_kernels.h, which the
+// Makefiles generate from the .cl files as { "kernels/name.cl", "<source>" }, entries, one per file.
+struct EmbeddedKernel {
+	const char* file_name;
+	const char* source;
+};
+
+const EmbeddedKernel embedded_kernels[] = {
+#ifdef EMBED_KERNELS
+#include "embedded_kernels.h"
+#endif
+	{ NULL, NULL }
+};
+
+// Adds the source of a kernel file. With KERNEL_DIR set in the environment the file is read from disk relative to
+// that directory, for editing kernels without rebuilding; otherwise the embedded copy is used when there is one,
+// and the file is read relative to the working directory when there is not.
 void AddSources(cl::Program::Sources& sources, const string& file_name) {
-	//TODO: add file existence check
-	ifstream file(file_name);
-	string* source_code = new string(istreambuf_iterator<char>(file), (istreambuf_iterator<char>()));
-	sources.push_back((*source_code).c_str());
+	const char* kernel_dir = getenv("KERNEL_DIR");
+	if (!kernel_dir) {
+		for (int i = 0; embedded_kernels[i].file_name; i++) {
+			if (file_name == embedded_kernels[i].file_name) {
+				sources.push_back(embedded_kernels[i].source);
+				return;
+			}
+		}
+	}
+
+	string path = kernel_dir ? string(kernel_dir) + "/" + file_name : file_name;
+	ifstream file(path);
+	if (!file) {
+		cerr << "Cannot open kernel file " << path << endl;
+		throw cl::Error(CL_INVALID_VALUE, "AddSources");
+	}
+	sources.push_back(string(istreambuf_iterator<char>(file), (istreambuf_iterator<char>())));
+}
+
+// Load a kernel file and build it with the given options, printing the build log on failure
+cl::Program BuildProgram(const cl::Context& context, const string& file_name, const string& options = "") {
+	cl::Program::Sources sources;
+	AddSources(sources, file_name);
+	cl::Program program(context, sources);
+	try {
+		program.build(options.c_str());
+	}
+	catch (const cl::Error& err) {
+		cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+		std::cout << "Build Status: " << program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(device) << std::endl;
+		std::cout << "Build Options:\t" << program.getBuildInfo<CL_PROGRAM_BUILD_OPTIONS>(device) << std::endl;
+		std::cout << "Build Log:\t " << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device) << std::endl;
+		throw err;
+	}
+	return program;
 }
 
 string ListPlatformsDevices() {
 
 	stringstream sstream;
-	vector<cl::Platform> platforms;
-
-	cl::Platform::get(&platforms);
+	const vector<PlatformInfo>& platforms = GetDeviceRegistry();
 
 	sstream << "Found " << platforms.size() << " platform(s):" << endl;
 
 	for (unsigned int i = 0; i < platforms.size(); i++)
 	{
-		sstream << "\nPlatform " << i << ", " << platforms[i].getInfo<CL_PLATFORM_NAME>() << ", version: " << platforms[i].getInfo<CL_PLATFORM_VERSION>();
+		sstream << "\nPlatform " << i << ", " << platforms[i].name << ", version: " << platforms[i].version;
 
-		sstream << ", vendor: " << platforms[i].getInfo<CL_PLATFORM_VENDOR>() << endl;
-		//		sstream << ", extensions: " << platforms[i].getInfo<CL_PLATFORM_EXTENSIONS>() << endl;
+		sstream << ", vendor: " << platforms[i].vendor << endl;
 
-		vector<cl::Device> devices;
-
-		platforms[i].getDevices((cl_device_type)CL_DEVICE_TYPE_ALL, &devices);
+		const vector<DeviceInfo>& devices = platforms[i].devices;
 
 		sstream << "\n   Found " << devices.size() << " device(s):" << endl;
 
 		for (unsigned int j = 0; j < devices.size(); j++)
 		{
-			sstream << "\n      Device " << j << ", " << devices[j].getInfo<CL_DEVICE_NAME>() << ", version: " << devices[j].getInfo<CL_DEVICE_VERSION>();
+			sstream << "\n      Device " << j << ", " << devices[j].name << ", version: " << devices[j].version;
 
-			sstream << ", vendor: " << devices[j].getInfo<CL_DEVICE_VENDOR>();
-			cl_device_type device_type = devices[j].getInfo<CL_DEVICE_TYPE>();
+			sstream << ", vendor: " << devices[j].vendor;
+			cl_device_type device_type = devices[j].type;
 			sstream << ", type: ";
 			if (device_type & CL_DEVICE_TYPE_DEFAULT)
 				sstream << "DEFAULT ";
@@ -165,10 +391,14 @@ string ListPlatformsDevices() {
 				sstream << "GPU ";
 			if (device_type & CL_DEVICE_TYPE_ACCELERATOR)
 				sstream << "ACCELERATOR ";
-			sstream << ", compute units: " << devices[j].getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
-			sstream << ", clock freq [MHz]: " << devices[j].getInfo<CL_DEVICE_MAX_CLOCK_FREQUENCY>();
-			sstream << ", max memory size [B]: " << devices[j].getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>();
-			sstream << ", max allocatable memory [B]: " << devices[j].getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>();
+			sstream << ", compute units: " << devices[j].compute_units;
+			sstream << ", clock freq [MHz]: " << devices[j].clock_mhz;
+			sstream << ", max memory size [B]: " << devices[j].global_mem_size;
+			sstream << ", max allocatable memory [B]: " << devices[j].max_alloc_size;
+			sstream << ", local memory [B]: " << devices[j].local_mem_size;
+			sstream << ", max work group size: " << devices[j].max_work_group_size;
+			if (devices[j].benchmark_score >= 0.0)
+				sstream << ", benchmark score: " << devices[j].benchmark_score;
 
 			sstream << endl;
 		}
@@ -179,23 +409,177 @@ string ListPlatformsDevices() {
 }
 
 cl::Context GetContext(int platform_id, int device_id) {
-	vector<cl::Platform> platforms;
+	const DeviceInfo* info = FindDevice(platform_id, device_id);
+	if (info)
+		return cl::Context({ info->device });
 
-	cl::Platform::get(&platforms);
+	return cl::Context();
+}
 
-	for (unsigned int i = 0; i < platforms.size(); i++)
-	{
-		vector<cl::Device> devices;
-		platforms[i].getDevices((cl_device_type)CL_DEVICE_TYPE_ALL, &devices);
+// Host <-> device transfer strategies
+enum TransferMode {
+	TRANSFER_COPY,      // enqueueWriteBuffer/enqueueReadBuffer straight from pageable host memory
+	TRANSFER_PINNED,    // staged through a CL_MEM_ALLOC_HOST_PTR buffer with map/unmap, then a device-side copy
+	TRANSFER_MAPPED,    // the device buffer itself is allocated with CL_MEM_ALLOC_HOST_PTR and filled through map/unmap
+	TRANSFER_ZERO_COPY, // the device buffer wraps page-aligned host memory (CL_MEM_USE_HOST_PTR)
+	TRANSFER_AUTO       // zero-copy on CPU devices, pinned otherwise
+};
 
-		for (unsigned int j = 0; j < devices.size(); j++)
-		{
-			if ((i == platform_id) && (j == device_id))
-				return cl::Context({ devices[j] });
+bool ParseTransferMode(const string& name, TransferMode& mode) {
+	if (name == "copy") mode = TRANSFER_COPY;
+	else if (name == "pinned") mode = TRANSFER_PINNED;
+	else if (name == "mapped") mode = TRANSFER_MAPPED;
+	else if (name == "zerocopy") mode = TRANSFER_ZERO_COPY;
+	else if (name == "auto") mode = TRANSFER_AUTO;
+	else return false;
+	return true;
+}
+
+const char* GetTransferModeName(TransferMode mode) {
+	switch (mode) {
+	case TRANSFER_COPY: return "copy";
+	case TRANSFER_PINNED: return "pinned";
+	case TRANSFER_MAPPED: return "mapped";
+	case TRANSFER_ZERO_COPY: return "zerocopy";
+	default: return "auto";
+	}
+}
+
+// A device buffer together with the host-side resources used to move data in and out of it.
+// write() returns once the source may be reused, read() once the destination holds the data. The optional event
+// covers only the command on the device (copy, map or unmap), not the host-side memcpy of the staged modes, so
+// compare modes by wall-clock time around write() and read().
+class TransferBuffer {
+public:
+	TransferBuffer() : mode_(TRANSFER_COPY), size_(0), host_ptr_(NULL) {}
+
+	TransferBuffer(const cl::Context& context, cl_mem_flags flags, size_t size, TransferMode mode) : mode_(mode), size_(size), host_ptr_(NULL) {
+		if (mode_ == TRANSFER_AUTO) {
+			cl_device_type type = context.getInfo<CL_CONTEXT_DEVICES>()[0].getInfo<CL_DEVICE_TYPE>();
+			mode_ = (type & CL_DEVICE_TYPE_CPU) ? TRANSFER_ZERO_COPY : TRANSFER_PINNED;
+		}
+
+		switch (mode_) {
+		case TRANSFER_PINNED:
+			buffer_ = cl::Buffer(context, flags, size);
+			staging_ = cl::Buffer(context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, size);
+			break;
+		case TRANSFER_MAPPED:
+			buffer_ = cl::Buffer(context, flags | CL_MEM_ALLOC_HOST_PTR, size);
+			break;
+		case TRANSFER_ZERO_COPY: {
+			// page-aligned and padded to a cache line multiple, as CPU runtimes require for zero-copy
+			size_t padded_size = (size + 63) & ~(size_t)63;
+			host_memory_ = std::make_shared<vector<unsigned char> >(padded_size + 4095);
+			host_ptr_ = (void*)(((uintptr_t)host_memory_->data() + 4095) & ~(uintptr_t)4095);
+			buffer_ = cl::Buffer(context, flags | CL_MEM_USE_HOST_PTR, padded_size, host_ptr_);
+			break;
+		}
+		default:
+			buffer_ = cl::Buffer(context, flags, size);
+			break;
 		}
 	}
 
-	return cl::Context();
+	const cl::Buffer& buffer() const { return buffer_; }
+	TransferMode mode() const { return mode_; }
+	size_t size() const { return size_; }
+
+	// Host memory backing a zero-copy buffer (NULL otherwise); producers may fill it directly to skip the copy in write()
+	void* host() const { return host_ptr_; }
+
+	void write(const cl::CommandQueue& queue, const void* src, size_t size, size_t offset = 0, cl::Event* event = NULL) {
+		void* ptr;
+		switch (mode_) {
+		case TRANSFER_PINNED:
+			ptr = queue.enqueueMapBuffer(staging_, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, offset, size);
+			memcpy(ptr, src, size);
+			queue.enqueueUnmapMemObject(staging_, ptr);
+			queue.enqueueCopyBuffer(staging_, buffer_, offset, offset, size, NULL, event);
+			queue.finish();
+			break;
+		case TRANSFER_MAPPED:
+		case TRANSFER_ZERO_COPY:
+			// a zero-copy buffer may already hold the data when the producer wrote through host()
+			ptr = queue.enqueueMapBuffer(buffer_, CL_TRUE, (mode_ == TRANSFER_MAPPED) ? CL_MAP_WRITE_INVALIDATE_REGION : CL_MAP_WRITE, offset, size);
+			if (ptr != src) memcpy(ptr, src, size);
+			queue.enqueueUnmapMemObject(buffer_, ptr, NULL, event);
+			queue.finish();
+			break;
+		default:
+			queue.enqueueWriteBuffer(buffer_, CL_TRUE, offset, size, src, NULL, event);
+			break;
+		}
+	}
+
+	void read(const cl::CommandQueue& queue, void* dst, size_t size, size_t offset = 0, cl::Event* event = NULL) {
+		void* ptr;
+		switch (mode_) {
+		case TRANSFER_PINNED:
+			queue.enqueueCopyBuffer(buffer_, staging_, offset, offset, size, NULL, event);
+			ptr = queue.enqueueMapBuffer(staging_, CL_TRUE, CL_MAP_READ, offset, size);
+			memcpy(dst, ptr, size);
+			queue.enqueueUnmapMemObject(staging_, ptr);
+			queue.finish();
+			break;
+		case TRANSFER_MAPPED:
+		case TRANSFER_ZERO_COPY:
+			ptr = queue.enqueueMapBuffer(buffer_, CL_TRUE, CL_MAP_READ, offset, size, NULL, event);
+			if (ptr != dst) memcpy(dst, ptr, size);
+			queue.enqueueUnmapMemObject(buffer_, ptr);
+			queue.finish();
+			break;
+		default:
+			queue.enqueueReadBuffer(buffer_, CL_TRUE, offset, size, dst, NULL, event);
+			break;
+		}
+	}
+
+private:
+	TransferMode mode_;
+	size_t size_;
+	cl::Buffer buffer_;
+	cl::Buffer staging_;
+	std::shared_ptr<vector<unsigned char> > host_memory_;
+	void* host_ptr_;
+};
+
+// Time an upload and a download of the given size in every transfer mode, end to end by wall clock: a producer fills
+// the data and write() moves it to the device, read() moves it back and a consumer sums it. In zero-copy mode the
+// producer and consumer work on host() directly, as a zero-copy application would, so that no host copy is made.
+string BenchmarkTransfers(const cl::Context& context, const cl::CommandQueue& queue, size_t size, int repeats = 10) {
+	stringstream sstream;
+	vector<unsigned char> host_data(size, 1);
+	TransferMode modes[] = { TRANSFER_COPY, TRANSFER_PINNED, TRANSFER_MAPPED, TRANSFER_ZERO_COPY };
+
+	sstream << "Transfer benchmark, " << size << " bytes, " << repeats << " repeats (producer and consumer included):" << endl;
+	for (int m = 0; m < 4; m++) {
+		TransferBuffer buffer(context, CL_MEM_READ_WRITE, size, modes[m]);
+		unsigned char* data = buffer.host() ? (unsigned char*)buffer.host() : host_data.data();
+		buffer.write(queue, data, size); // warm up
+		buffer.read(queue, data, size);
+
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		for (int i = 0; i < repeats; i++) {
+			memset(data, i, size);
+			buffer.write(queue, data, size);
+		}
+		double upload = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count() / repeats;
+
+		size_t checksum = 0;
+		start = chrono::high_resolution_clock::now();
+		for (int i = 0; i < repeats; i++) {
+			buffer.read(queue, data, size);
+			for (size_t j = 0; j < size; j += 64) checksum += data[j];
+		}
+		double download = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count() / repeats;
+
+		sstream << "   " << GetTransferModeName(modes[m]) << ": upload " << upload * 1e3 << " [ms] (" << size / upload * 1e-9
+			<< " GB/s), download " << download * 1e3 << " [ms] (" << size / download * 1e-9 << " GB/s)"
+			<< ((checksum == (size + 63) / 64 * (size_t)(repeats - 1) * repeats) ? "" : ", WRONG") << endl;
+	}
+
+	return sstream.str();
 }
 
 enum ProfilingResolution {
@@ -223,3 +607,18 @@ string GetFullProfilingInfo(const cl::Event& evnt, ProfilingResolution resolutio
 
 	return sstream.str();
 }
+
+// Kernel or transfer execution time (start to end) of a profiled event in the given unit
+double GetExecutionTime(const cl::Event& evnt, ProfilingResolution resolution = PROF_MS) {
+	return (double)(evnt.getProfilingInfo<CL_PROFILING_COMMAND_END>() - evnt.getProfilingInfo<CL_PROFILING_COMMAND_START>()) / resolution;
+}
+
+// Total execution time of a list of events, waiting for each to complete
+double GetExecutionTime(const vector<cl::Event>& events, ProfilingResolution resolution = PROF_MS) {
+	double time = 0;
+	for (size_t i = 0; i < events.size(); i++) {
+		events[i].wait();
+		time += GetExecutionTime(events[i], resolution);
+	}
+	return time;
+}
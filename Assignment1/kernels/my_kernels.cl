@@ -1,5 +1,6 @@
 // Histogram kernel using local memory for 16-bit input with variable bins
-kernel void hist_local(global const ushort* A, global int* H, int nr_bins, local int* local_hist) {
+// n is the number of valid pixels, the global size may be padded up to a multiple of the work-group size
+kernel void hist_local(global const ushort* A, global int* H, int nr_bins, int n, local int* local_hist) {
     int id = get_global_id(0);
     int lid = get_local_id(0);
     int local_size = get_local_size(0);
@@ -11,7 +12,7 @@ kernel void hist_local(global const ushort* A, global int* H, int nr_bins, local
     barrier(CLK_LOCAL_MEM_FENCE);
 
     // Calculate histogram
-    if (id < get_global_size(0)) {
+    if (id < n) {
         ushort value = A[id];
         int bin_index = (int)(((float)value / 65535.0f) * (nr_bins - 1)); // Scale to 0 to nr_bins-1
         atomic_inc(&local_hist[bin_index]);
@@ -79,6 +80,52 @@ kernel void scan_hs(global int* A, const int nr_bins) {
     }
 }
 
+// Segmented exclusive scan: scans a batch of arrays (channel histograms, tiles, images) in a single launch,
+// one work group per segment. Segment g holds segment_length values starting at A[g * segment_stride].
+// The local size must be a power of two; longer segments are scanned in tiles of that size with a carry.
+kernel void scan_segmented(global int* A, const int segment_length, const int segment_stride, local int* scratch) {
+    int lid = get_local_id(0);
+    int N = get_local_size(0);
+    global int* segment = A + get_group_id(0) * segment_stride;
+    int carry = 0;
+
+    for (int base = 0; base < segment_length; base += N) {
+        int id = base + lid;
+        scratch[lid] = (id < segment_length) ? segment[id] : 0;
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        // Up-sweep
+        for (int stride = 1; stride < N; stride *= 2) {
+            int index = (lid + 1) * stride * 2 - 1;
+            if (index < N)
+                scratch[index] += scratch[index - stride];
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+
+        int total = scratch[N - 1];
+        barrier(CLK_LOCAL_MEM_FENCE);
+        if (lid == 0)
+            scratch[N - 1] = 0;
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        // Down-sweep
+        for (int stride = N / 2; stride > 0; stride /= 2) {
+            int index = (lid + 1) * stride * 2 - 1;
+            if (index < N) {
+                int t = scratch[index - stride];
+                scratch[index - stride] = scratch[index];
+                scratch[index] += t;
+            }
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+
+        if (id < segment_length)
+            segment[id] = scratch[lid] + carry;
+        carry += total;
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+}
+
 // Normalize LUT kernel
 kernel void normalize_lut(global const int* cum_histogram, global ushort* lut, float scale, const int nr_bins) {
     int id = get_global_id(0);
@@ -91,4 +138,59 @@ kernel void normalize_lut(global const int* cum_histogram, global ushort* lut, f
 kernel void back_project(global const ushort* input, global ushort* output, global ushort* lut) {
     int id = get_global_id(0);
     output[id] = lut[input[id]];
-}
\ No newline at end of file
+}
+
+// Back projection fused with an area-averaging downscale: each work item projects one pixel through the LUT,
+// writes it to the full-size output and adds it to the sum of its factor x factor thumbnail cell, so the input is
+// read once for both outputs. The group first sums its pixels per cell in local memory and then adds each partial
+// cell sum to thumbnail_sums with one global atomic, which must be zeroed beforehand; thumbnail_mean turns the
+// sums into the thumbnail. Sums of at most 255 x 255 16-bit values fit in 32 bits.
+// global size: width x height rounded up to the local size, cells: get_local_size(0) * get_local_size(1) uints
+kernel void back_project_thumbnail(global const ushort* input, global ushort* output, global const ushort* lut,
+                                   global uint* thumbnail_sums, const int width, const int height, const int factor,
+                                   local uint* cells) {
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    int lid = get_local_id(0) + get_local_id(1) * get_local_size(0);
+    int group_size = get_local_size(0) * get_local_size(1);
+    int thumbnail_width = (width + factor - 1) / factor;
+    int thumbnail_height = (height + factor - 1) / factor;
+
+    // the thumbnail cells overlapped by this group's tile of pixels
+    int gx0 = get_group_id(0) * get_local_size(0), gy0 = get_group_id(1) * get_local_size(1);
+    int cx0 = gx0 / factor, cy0 = gy0 / factor;
+    int cells_x = (gx0 + get_local_size(0) - 1) / factor - cx0 + 1;
+    int cells_y = (gy0 + get_local_size(1) - 1) / factor - cy0 + 1;
+
+    for (int i = lid; i < cells_x * cells_y; i += group_size)
+        cells[i] = 0;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (x < width && y < height) {
+        ushort value = lut[input[x + y * width]];
+        output[x + y * width] = value;
+        atomic_add(&cells[(x / factor - cx0) + (y / factor - cy0) * cells_x], value);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int i = lid; i < cells_x * cells_y; i += group_size) {
+        int tx = cx0 + i % cells_x, ty = cy0 + i / cells_x;
+        if (tx < thumbnail_width && ty < thumbnail_height)
+            atomic_add(&thumbnail_sums[tx + ty * thumbnail_width], cells[i]);
+    }
+}
+
+// Mean of each thumbnail cell from the sums of back_project_thumbnail. Cells at the right and bottom edges average
+// only the pixels that exist.
+// global size: ceil(width / factor) x ceil(height / factor)
+kernel void thumbnail_mean(global const uint* thumbnail_sums, global ushort* thumbnail, const int width, const int height,
+                           const int factor) {
+    int tx = get_global_id(0);
+    int ty = get_global_id(1);
+    int thumbnail_width = (width + factor - 1) / factor;
+    int x0 = tx * factor, x1 = min(x0 + factor, width);
+    int y0 = ty * factor, y1 = min(y0 + factor, height);
+
+    uint count = (x1 - x0) * (y1 - y0);
+    thumbnail[tx + ty * thumbnail_width] = (ushort)((thumbnail_sums[tx + ty * thumbnail_width] + count / 2) / count);
+}
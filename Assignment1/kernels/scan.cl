@@ -0,0 +1,186 @@
+// Prefix scan (sum) over arrays of any length: a single-pass scan with decoupled look-back and a
+// three-phase reduce-then-scan. Build options select the element type and tile shape:
+//   -DSCAN_T=int|uint|float  element type (default int)
+//   -DWG_SIZE=256            work-group size the kernels must be launched with (power of two)
+//   -DITEMS=8                elements per work item, a tile is WG_SIZE * ITEMS elements
+
+#ifndef SCAN_T
+#define SCAN_T int
+#endif
+#ifndef WG_SIZE
+#define WG_SIZE 256
+#endif
+#ifndef ITEMS
+#define ITEMS 8
+#endif
+#define TILE (WG_SIZE * ITEMS)
+
+// tile status flags for the look-back
+#define FLAG_AGGREGATE 1 // the tile's own total is available
+#define FLAG_PREFIX 2    // the inclusive prefix up to and including the tile is available
+
+// Exclusive Blelloch scan of one value per work item; returns the work item's prefix and the group total
+SCAN_T group_exclusive_scan(SCAN_T value, local SCAN_T* scratch, SCAN_T* total) {
+    int lid = get_local_id(0);
+    scratch[lid] = value;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Up-sweep
+    for (int stride = 1; stride < WG_SIZE; stride *= 2) {
+        int index = (lid + 1) * stride * 2 - 1;
+        if (index < WG_SIZE)
+            scratch[index] += scratch[index - stride];
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    *total = scratch[WG_SIZE - 1];
+    barrier(CLK_LOCAL_MEM_FENCE);
+    if (lid == 0)
+        scratch[WG_SIZE - 1] = 0;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Down-sweep
+    for (int stride = WG_SIZE / 2; stride > 0; stride /= 2) {
+        int index = (lid + 1) * stride * 2 - 1;
+        if (index < WG_SIZE) {
+            SCAN_T t = scratch[index - stride];
+            scratch[index - stride] = scratch[index];
+            scratch[index] += t;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    SCAN_T prefix = scratch[lid];
+    barrier(CLK_LOCAL_MEM_FENCE);
+    return prefix;
+}
+
+// Coalesced load of one tile into local memory, padding past the end of the array with zeros
+void load_tile(global const SCAN_T* in, local SCAN_T* tile, int base, int n) {
+    for (int i = get_local_id(0); i < TILE; i += WG_SIZE)
+        tile[i] = (base + i < n) ? in[base + i] : 0;
+    barrier(CLK_LOCAL_MEM_FENCE);
+}
+
+// Coalesced store of one tile, adding the prefix of all preceding tiles
+void store_tile(global SCAN_T* out, local const SCAN_T* tile, int base, int n, SCAN_T offset) {
+    for (int i = get_local_id(0); i < TILE; i += WG_SIZE)
+        if (base + i < n)
+            out[base + i] = tile[i] + offset;
+}
+
+// Scan a tile in local memory in place: each work item scans ITEMS consecutive elements sequentially,
+// the per-item totals are combined with a work-group scan. Returns the tile total.
+SCAN_T scan_tile(local SCAN_T* tile, local SCAN_T* scratch, int exclusive) {
+    local SCAN_T* items = tile + get_local_id(0) * ITEMS;
+    SCAN_T sum = 0;
+    for (int i = 0; i < ITEMS; i++)
+        sum += items[i];
+
+    SCAN_T total;
+    SCAN_T running = group_exclusive_scan(sum, scratch, &total);
+    for (int i = 0; i < ITEMS; i++) {
+        SCAN_T value = items[i];
+        if (exclusive) {
+            items[i] = running;
+            running += value;
+        } else {
+            running += value;
+            items[i] = running;
+        }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+    return total;
+}
+
+// Single-pass scan with decoupled look-back. state must hold (number of tiles + 1) zeros before the launch:
+// state[0] hands out tile indices and state[1 + t] is the status flag of tile t. Tiles are numbered in the
+// order work groups start, so a group only ever waits on groups that are already running.
+kernel void scan_lookback(global const SCAN_T* in, global SCAN_T* out, const int n, const int exclusive,
+                          global int* state, global volatile SCAN_T* aggregates, global volatile SCAN_T* prefixes) {
+    local SCAN_T tile[TILE];
+    local SCAN_T scratch[WG_SIZE];
+    local int tile_id;
+    local SCAN_T tile_offset;
+    int lid = get_local_id(0);
+
+    if (lid == 0)
+        tile_id = atomic_inc(&state[0]);
+    barrier(CLK_LOCAL_MEM_FENCE);
+    int tile_index = tile_id;
+    int base = tile_index * TILE;
+
+    load_tile(in, tile, base, n);
+    SCAN_T aggregate = scan_tile(tile, scratch, exclusive);
+
+    if (lid == 0) {
+        global int* flags = state + 1;
+        SCAN_T prefix = 0;
+
+        if (tile_index > 0) {
+            // publish the tile total so that successors can proceed without waiting for our prefix
+            aggregates[tile_index] = aggregate;
+            write_mem_fence(CLK_GLOBAL_MEM_FENCE);
+            atomic_xchg(&flags[tile_index], FLAG_AGGREGATE);
+
+            // walk back, accumulating totals, until a predecessor with a complete prefix is found
+            int j = tile_index - 1;
+            while (j >= 0) {
+                int flag = atomic_or(&flags[j], 0);
+                if (flag == 0)
+                    continue; // predecessor has not published yet
+                read_mem_fence(CLK_GLOBAL_MEM_FENCE);
+                if (flag == FLAG_PREFIX) {
+                    prefix += prefixes[j];
+                    break;
+                }
+                prefix += aggregates[j];
+                j--;
+            }
+        }
+
+        prefixes[tile_index] = prefix + aggregate;
+        write_mem_fence(CLK_GLOBAL_MEM_FENCE);
+        atomic_xchg(&flags[tile_index], FLAG_PREFIX);
+        tile_offset = prefix;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    store_tile(out, tile, base, n, tile_offset);
+}
+
+// Reduce-then-scan, phase 1: total of each tile
+kernel void scan_reduce(global const SCAN_T* in, global SCAN_T* tile_sums, const int n) {
+    local SCAN_T scratch[WG_SIZE];
+    int lid = get_local_id(0);
+    int base = get_group_id(0) * TILE;
+
+    SCAN_T sum = 0;
+    for (int i = lid; i < TILE; i += WG_SIZE)
+        if (base + i < n)
+            sum += in[base + i];
+    scratch[lid] = sum;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int stride = WG_SIZE / 2; stride > 0; stride /= 2) {
+        if (lid < stride)
+            scratch[lid] += scratch[lid + stride];
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (lid == 0)
+        tile_sums[get_group_id(0)] = scratch[0];
+}
+
+// Reduce-then-scan, phase 3: scan each tile and add the exclusive scan of the tile totals (phase 2).
+// The input and output may be the same buffer.
+kernel void scan_downsweep(global const SCAN_T* in, global SCAN_T* out, const int n, const int exclusive,
+                           global const SCAN_T* tile_offsets, const int use_offsets) {
+    local SCAN_T tile[TILE];
+    local SCAN_T scratch[WG_SIZE];
+    int base = get_group_id(0) * TILE;
+
+    load_tile(in, tile, base, n);
+    scan_tile(tile, scratch, exclusive);
+    store_tile(out, tile, base, n, use_offsets ? tile_offsets[get_group_id(0)] : 0);
+}
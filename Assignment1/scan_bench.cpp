@@ -0,0 +1,257 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "Utils.h"
+#include "Scan.h"
+
+void print_help() {
+    std::cerr << "Scan benchmark usage:" << std::endl;
+    std::cerr << "  -p : select platform " << std::endl;
+    std::cerr << "  -d : select device (index on the platform, cpu, gpu, accelerator, fastest or part of a device name)" << std::endl;
+    std::cerr << "  -l : list all platforms and devices" << std::endl;
+    std::cerr << "  -r : repeats per measurement (default 20)" << std::endl;
+    std::cerr << "  -t : element type for the large-array sweep (int, uint, float; default int)" << std::endl;
+    std::cerr << "  -n : largest array size in the sweep as a power of two (default 28)" << std::endl;
+    std::cerr << "  -h : print this message" << std::endl;
+}
+
+// Host reference: exclusive scan of each segment
+std::vector<int> reference_segmented_scan(const std::vector<int>& data, size_t segments, size_t length, size_t stride) {
+    std::vector<int> result(data);
+    for (size_t s = 0; s < segments; s++) {
+        int sum = 0;
+        for (size_t i = 0; i < length; i++) {
+            result[s * stride + i] = sum;
+            sum += data[s * stride + i];
+        }
+    }
+    return result;
+}
+
+bool segments_match(const std::vector<int>& a, const std::vector<int>& b, size_t segments, size_t length, size_t stride) {
+    for (size_t s = 0; s < segments; s++)
+        for (size_t i = 0; i < length; i++)
+            if (a[s * stride + i] != b[s * stride + i]) return false;
+    return true;
+}
+
+// Many small scans: one launch per segment against a single segmented launch
+void benchmark_segmented(const cl::Context& context, const cl::CommandQueue& queue, const cl::Program& program, int repeats) {
+    cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+    size_t max_work_group_size = device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+    cl_uint base_addr_align = device.getInfo<CL_DEVICE_MEM_BASE_ADDR_ALIGN>();
+    size_t align_ints = std::max((size_t)1, (size_t)base_addr_align / (8 * sizeof(int)));
+
+    size_t lengths[] = { 256, 1024, 2500 };
+    size_t counts[] = { 1, 3, 16, 64, 256, 1024 };
+
+    std::cout << "\nSegmented scan: one launch per segment vs a single launch (" << repeats << " repeats, wall clock)" << std::endl;
+    std::cout << "segments\tlength\tper-segment [ms]\tsingle [ms]\tspeedup\tcorrect" << std::endl;
+
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        for (size_t n = 0; n < sizeof(counts) / sizeof(counts[0]); n++) {
+            size_t length = lengths[l];
+            size_t segments = counts[n];
+            size_t stride = ((length + align_ints - 1) / align_ints) * align_ints;
+            size_t local_size = 1;
+            while (local_size * 2 <= std::min(length, max_work_group_size)) local_size *= 2;
+
+            std::vector<int> input(segments * stride);
+            for (size_t i = 0; i < input.size(); i++) input[i] = rand() % 16;
+            std::vector<int> expected = reference_segmented_scan(input, segments, length, stride);
+            std::vector<int> output(input.size());
+
+            cl::Buffer buffer(context, CL_MEM_READ_WRITE, input.size() * sizeof(int));
+            std::vector<cl::Buffer> sub_buffers(segments);
+            for (size_t s = 0; s < segments; s++) {
+                cl_buffer_region region = { s * stride * sizeof(int), length * sizeof(int) };
+                sub_buffers[s] = buffer.createSubBuffer(CL_MEM_READ_WRITE, CL_BUFFER_CREATE_TYPE_REGION, &region);
+            }
+
+            cl::Kernel kernel(program, "scan_segmented");
+            kernel.setArg(1, (int)length);
+            kernel.setArg(2, (int)stride);
+            kernel.setArg(3, cl::Local(local_size * sizeof(int)));
+
+            // one launch per segment
+            double per_segment_time = 0.0;
+            bool correct = true;
+            for (int r = 0; r < repeats; r++) {
+                queue.enqueueWriteBuffer(buffer, CL_TRUE, 0, input.size() * sizeof(int), input.data());
+                std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+                for (size_t s = 0; s < segments; s++) {
+                    kernel.setArg(0, sub_buffers[s]);
+                    queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(local_size), cl::NDRange(local_size));
+                }
+                queue.finish();
+                per_segment_time += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+            }
+            queue.enqueueReadBuffer(buffer, CL_TRUE, 0, output.size() * sizeof(int), output.data());
+            correct &= segments_match(output, expected, segments, length, stride);
+
+            // all segments in one launch
+            double single_time = 0.0;
+            kernel.setArg(0, buffer);
+            for (int r = 0; r < repeats; r++) {
+                queue.enqueueWriteBuffer(buffer, CL_TRUE, 0, input.size() * sizeof(int), input.data());
+                std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+                queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(segments * local_size), cl::NDRange(local_size));
+                queue.finish();
+                single_time += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+            }
+            queue.enqueueReadBuffer(buffer, CL_TRUE, 0, output.size() * sizeof(int), output.data());
+            correct &= segments_match(output, expected, segments, length, stride);
+
+            per_segment_time /= repeats;
+            single_time /= repeats;
+            std::cout << segments << "\t\t" << length << "\t" << per_segment_time * 1e3 << "\t\t\t" << single_time * 1e3
+                      << "\t\t" << per_segment_time / single_time << "\t" << (correct ? "yes" : "NO") << std::endl;
+        }
+    }
+}
+
+template <typename T>
+bool scan_matches(const std::vector<T>& result, const std::vector<T>& expected) {
+    for (size_t i = 0; i < result.size(); i++) {
+        double tolerance = 1e-4 * std::max(1.0, std::fabs((double)expected[i]));
+        if (std::fabs((double)result[i] - (double)expected[i]) > tolerance) return false;
+    }
+    return true;
+}
+
+// Average wall-clock time of a scan, the input is restored before each run as the textbook kernels work in place
+template <typename T, typename Run>
+double time_scan(const cl::CommandQueue& queue, const cl::Buffer& buffer, const std::vector<T>& input, int repeats, Run run) {
+    double total = 0.0;
+    for (int r = 0; r <= repeats; r++) {
+        queue.enqueueWriteBuffer(buffer, CL_TRUE, 0, input.size() * sizeof(T), input.data());
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        run();
+        queue.finish();
+        if (r > 0) // the first run is a warm-up
+            total += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+    return total / repeats;
+}
+
+// Large arrays: single-pass look-back vs reduce-then-scan vs the single work-group textbook kernels
+template <typename T>
+void benchmark_sizes(const cl::Context& context, const cl::CommandQueue& queue, const cl::Program& program, int repeats, int max_log2) {
+    cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+    size_t max_work_group_size = device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+    cl_ulong max_alloc_size = device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>();
+    cl_ulong global_mem_size = device.getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>();
+    bool textbook = (strcmp(ScanTypeName<T>::get(), "int") == 0); // scan_bl/scan_hs are int only
+
+    PrefixScan<T> scan(context);
+    std::cout << "\nInclusive scan of " << ScanTypeName<T>::get() << " arrays (" << repeats << " repeats, wall clock, tile "
+              << scan.tile_size() << ")" << std::endl;
+    std::cout << "n\tlook-back [ms]\t(Gelem/s)\treduce-then-scan [ms]\t(Gelem/s)\tscan_bl [ms]\tscan_hs [ms]\tcorrect" << std::endl;
+
+    for (int k = 8; k <= max_log2; k += 2) {
+        size_t n = (size_t)1 << k;
+        if (n * sizeof(T) > max_alloc_size || 3 * n * sizeof(T) > global_mem_size) {
+            std::cout << n << "\tskipped (exceeds device memory)" << std::endl;
+            continue;
+        }
+
+        std::vector<T> input(n);
+        for (size_t i = 0; i < n; i++) input[i] = (T)(rand() % 4);
+        std::vector<T> inclusive(n), exclusive(n);
+        double sum = 0.0;
+        for (size_t i = 0; i < n; i++) {
+            exclusive[i] = (T)sum;
+            sum += (double)input[i];
+            inclusive[i] = (T)sum;
+        }
+        std::vector<T> output(n);
+
+        cl::Buffer dev_input(context, CL_MEM_READ_WRITE, n * sizeof(T));
+        cl::Buffer dev_output(context, CL_MEM_READ_WRITE, n * sizeof(T));
+        bool correct = true;
+
+        double lookback_time = time_scan(queue, dev_input, input, repeats, [&]() { scan.inclusive(queue, dev_input, dev_output, n); });
+        queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, n * sizeof(T), output.data());
+        correct &= scan_matches(output, inclusive);
+
+        double three_phase_time = time_scan(queue, dev_input, input, repeats, [&]() { scan.inclusive_reduce_then_scan(queue, dev_input, dev_output, n); });
+        queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, n * sizeof(T), output.data());
+        correct &= scan_matches(output, inclusive);
+
+        std::cout << n << "\t" << lookback_time * 1e3 << "\t" << n / lookback_time * 1e-9 << "\t\t"
+                  << three_phase_time * 1e3 << "\t\t\t" << n / three_phase_time * 1e-9 << "\t\t";
+
+        // the textbook kernels only scan within a single work group (exclusive, in place)
+        if (textbook && n <= max_work_group_size) {
+            const char* names[] = { "scan_bl", "scan_hs" };
+            for (int i = 0; i < 2; i++) {
+                cl::Kernel kernel(program, names[i]);
+                kernel.setArg(0, dev_input);
+                kernel.setArg(1, (int)n);
+                double time = time_scan(queue, dev_input, input, repeats, [&]() {
+                    queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(n), cl::NDRange(n));
+                });
+                queue.enqueueReadBuffer(dev_input, CL_TRUE, 0, n * sizeof(T), output.data());
+                correct &= scan_matches(output, exclusive);
+                std::cout << time * 1e3 << "\t";
+            }
+        } else {
+            std::cout << "n/a\tn/a\t";
+        }
+        std::cout << "\t" << (correct ? "yes" : "NO") << std::endl;
+    }
+}
+
+int main(int argc, char **argv) {
+    int platform_id = 0;
+    int device_id = 0;
+    std::string device_selector = "0";
+    int repeats = 20;
+    std::string type = "int";
+    int max_log2 = 28;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0 && i < argc - 1) { platform_id = atoi(argv[++i]); }
+        else if (strcmp(argv[i], "-d") == 0 && i < argc - 1) { device_selector = argv[++i]; }
+        else if (strcmp(argv[i], "-l") == 0) { std::cout << ListPlatformsDevices() << std::endl; return 0; }
+        else if (strcmp(argv[i], "-r") == 0 && i < argc - 1) { repeats = std::max(1, atoi(argv[++i])); }
+        else if (strcmp(argv[i], "-t") == 0 && i < argc - 1) { type = argv[++i]; }
+        else if (strcmp(argv[i], "-n") == 0 && i < argc - 1) { max_log2 = std::min(30, atoi(argv[++i])); }
+        else if (strcmp(argv[i], "-h") == 0) { print_help(); return 0; }
+    }
+
+    try {
+        if (!SelectDevice(device_selector, platform_id, device_id)) {
+            std::cerr << "Error: no device matches " << device_selector << std::endl;
+            return 1;
+        }
+        cl::Context context = GetContext(platform_id, device_id);
+        std::cout << "Running on " << GetPlatformName(platform_id) << ", "
+                  << GetDeviceName(platform_id, device_id) << std::endl;
+        cl::CommandQueue queue(context, context.getInfo<CL_CONTEXT_DEVICES>()[0], CL_QUEUE_PROFILING_ENABLE);
+
+        cl::Program::Sources sources;
+        AddSources(sources, "kernels/my_kernels.cl");
+        cl::Program program(context, sources);
+        try {
+            program.build();
+        } catch (const cl::Error& err) {
+            std::cout << "Build Status: " << program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(context.getInfo<CL_CONTEXT_DEVICES>()[0]) << std::endl;
+            std::cout << "Build Log:\t " << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(context.getInfo<CL_CONTEXT_DEVICES>()[0]) << std::endl;
+            throw err;
+        }
+
+        benchmark_segmented(context, queue, program, repeats);
+
+        if (type == "uint") benchmark_sizes<unsigned int>(context, queue, program, repeats, max_log2);
+        else if (type == "float") benchmark_sizes<float>(context, queue, program, repeats, max_log2);
+        else benchmark_sizes<int>(context, queue, program, repeats, max_log2);
+    } catch (const cl::Error& err) {
+        std::cerr << "ERROR: " << err.what() << ", " << getErrorString(err.err()) << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,312 @@
+#pragma once
+
+// Dense single-precision matrix operations (kernels/matrix.cl) on row-major buffers of any size:
+//   gemm               C = alpha*A*B + beta*C, tiled in local memory with WPT elements per work item in registers
+//   transpose          through a local-memory tile padded by one column against bank conflicts
+//   axpby              C = alpha*A + beta*B, element-wise
+//   multiply_elements  C = A .* B
+// gemm_naive and the untiled transpose are kept for comparison. The GEMM tile size and work per thread are
+// autotuned the first time gemm runs on a device (the queue must have profiling enabled) and remembered for
+// every engine on that device, or can be set with set_tile.
+//
+//   MatrixEngine matrix(context);
+//   matrix.gemm(queue, dev_A, dev_B, dev_C, M, N, K);
+//   matrix.transpose(queue, dev_C, dev_Ct, M, N);
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+#include "Utils.h"
+
+struct GemmTile {
+	int tile_size;       // TS: TS x TS blocks of A and B in local memory
+	int work_per_thread; // WPT: elements of C per work item, the work group is TS x TS/WPT
+
+	GemmTile(int tile_size = 0, int work_per_thread = 0) : tile_size(tile_size), work_per_thread(work_per_thread) {}
+	bool operator==(const GemmTile& other) const { return (tile_size == other.tile_size) && (work_per_thread == other.work_per_thread); }
+	bool operator<(const GemmTile& other) const {
+		return (tile_size < other.tile_size) || ((tile_size == other.tile_size) && (work_per_thread < other.work_per_thread));
+	}
+};
+
+// tuned tiles by device, shared by all engines
+std::map<string, GemmTile>& GemmTileCache() {
+	static std::map<string, GemmTile> cache;
+	return cache;
+}
+
+class MatrixEngine {
+public:
+	MatrixEngine(const cl::Context& context, const string& kernel_file = "kernels/matrix.cl")
+		: context_(context), kernel_file_(kernel_file) {
+		device_ = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+		device_key_ = device_.getInfo<CL_DEVICE_NAME>() + "|" + device_.getInfo<CL_DRIVER_VERSION>();
+		max_group_size_ = device_.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+		transpose_tile_ = (max_group_size_ >= 256) ? 16 : 8;
+
+		// the tiles that fit in the device's work groups and local memory
+		const int sizes[] = { 8, 16, 32, 64 }, works[] = { 1, 2, 4, 8 };
+		cl_ulong local_memory = device_.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+		for (int s = 0; s < 4; s++) {
+			for (int w = 0; w < 4; w++) {
+				size_t group_size = sizes[s] * sizes[s] / works[w];
+				if ((works[w] < sizes[s]) && (group_size <= max_group_size_) && (2 * sizes[s] * sizes[s] * sizeof(float) <= local_memory))
+					candidates_.push_back(GemmTile(sizes[s], works[w]));
+			}
+		}
+		if (candidates_.empty())
+			throw cl::Error(CL_INVALID_DEVICE, "MatrixEngine: the device cannot run 8 x 8 work groups");
+
+		std::map<string, GemmTile>::iterator it = GemmTileCache().find(device_key_);
+		if (it != GemmTileCache().end()) tile_ = it->second;
+	}
+
+	void gemm(const cl::CommandQueue& queue, const cl::Buffer& A, const cl::Buffer& B, const cl::Buffer& C, int M, int N, int K,
+		float alpha = 1.f, float beta = 0.f, vector<cl::Event>* events = NULL) {
+		if (!tile_.tile_size) tune(queue);
+		gemm(queue, tile_, A, B, C, M, N, K, alpha, beta, events);
+	}
+
+	void gemm_naive(const cl::CommandQueue& queue, const cl::Buffer& A, const cl::Buffer& B, const cl::Buffer& C, int M, int N, int K,
+		float alpha = 1.f, float beta = 0.f, vector<cl::Event>* events = NULL) {
+		Variant& variant = current();
+		set_gemm_args(variant.gemm_naive, A, B, C, M, N, K, alpha, beta);
+		launch(queue, variant.gemm_naive, cl::NDRange(round_up(N, 16), round_up(M, 16)), cl::NDRange(16, std::min((size_t)16, max_group_size_ / 16)), events);
+	}
+
+	// B = transpose(A) with A rows x cols; A and B must be different buffers
+	void transpose(const cl::CommandQueue& queue, const cl::Buffer& A, const cl::Buffer& B, int rows, int cols, vector<cl::Event>* events = NULL,
+		bool tiled = true) {
+		cl::Kernel& kernel = tiled ? current().transpose : current().transpose_naive;
+		kernel.setArg(0, A);
+		kernel.setArg(1, B);
+		kernel.setArg(2, rows);
+		kernel.setArg(3, cols);
+		launch(queue, kernel, cl::NDRange(round_up(cols, transpose_tile_), round_up(rows, transpose_tile_)),
+			cl::NDRange(transpose_tile_, transpose_tile_), events);
+	}
+
+	void axpby(const cl::CommandQueue& queue, const cl::Buffer& A, const cl::Buffer& B, const cl::Buffer& C, int rows, int cols,
+		float alpha, float beta, vector<cl::Event>* events = NULL) {
+		cl::Kernel& kernel = current().axpby;
+		set_element_args(kernel, A, B, C, rows, cols);
+		kernel.setArg(5, alpha);
+		kernel.setArg(6, beta);
+		launch(queue, kernel, cl::NDRange(round_up(cols, 16), rows), cl::NDRange(16, 1), events);
+	}
+
+	void multiply_elements(const cl::CommandQueue& queue, const cl::Buffer& A, const cl::Buffer& B, const cl::Buffer& C, int rows, int cols,
+		vector<cl::Event>* events = NULL) {
+		cl::Kernel& kernel = current().multiply_elements;
+		set_element_args(kernel, A, B, C, rows, cols);
+		launch(queue, kernel, cl::NDRange(round_up(cols, 16), rows), cl::NDRange(16, 1), events);
+	}
+
+	// the tiles gemm can use on this device
+	const vector<GemmTile>& candidates() const { return candidates_; }
+
+	// the tile gemm uses, 0 x 0 before tuning
+	GemmTile tile() const { return tile_; }
+
+	void set_tile(const GemmTile& tile) {
+		if (std::find(candidates_.begin(), candidates_.end(), tile) == candidates_.end())
+			throw cl::Error(CL_INVALID_VALUE, "MatrixEngine: the tile does not fit this device");
+		tile_ = tile;
+	}
+
+	// Time every candidate on a size x size product (best of 3) and keep the fastest for this device; the time of
+	// each candidate in ns goes to times if given, 0 for the ones the compiler could not fit
+	GemmTile tune(const cl::CommandQueue& queue, int size = 512, vector<double>* times = NULL) {
+		size_t bytes = (size_t)size * size * sizeof(float);
+		vector<float> ones((size_t)size * size, 1.f);
+		cl::Buffer A(context_, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, bytes, &ones[0]);
+		cl::Buffer B(context_, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, bytes, &ones[0]);
+		cl::Buffer C(context_, CL_MEM_WRITE_ONLY, bytes);
+
+		double best_time = 0;
+		if (times) times->assign(candidates_.size(), 0.0);
+		for (size_t c = 0; c < candidates_.size(); c++) {
+			Variant& variant = get_variant(candidates_[c]);
+			size_t group_size = candidates_[c].tile_size * candidates_[c].tile_size / candidates_[c].work_per_thread;
+			if (variant.gemm_tiled.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device_) < group_size) continue; // too many registers
+
+			for (int i = 0; i < 3; i++) {
+				vector<cl::Event> events;
+				gemm(queue, candidates_[c], A, B, C, size, size, size, 1.f, 0.f, &events);
+				double time = GetExecutionTime(events, PROF_NS);
+				if (times && (((*times)[c] == 0) || (time < (*times)[c]))) (*times)[c] = time;
+				if ((best_time == 0) || (time < best_time)) {
+					best_time = time;
+					tile_ = candidates_[c];
+				}
+			}
+		}
+		if (!tile_.tile_size)
+			throw cl::Error(CL_INVALID_WORK_GROUP_SIZE, "MatrixEngine: no GEMM tile fits this device");
+
+		GemmTileCache()[device_key_] = tile_;
+		return tile_;
+	}
+
+private:
+	// one program per GEMM tile; the other kernels are the same in every program
+	struct Variant {
+		cl::Program program;
+		cl::Kernel gemm_naive, gemm_tiled, transpose_naive, transpose, axpby, multiply_elements;
+	};
+
+	cl::Context context_;
+	cl::Device device_;
+	string kernel_file_, device_key_;
+	size_t max_group_size_;
+	int transpose_tile_;
+	vector<GemmTile> candidates_;
+	GemmTile tile_;
+	std::map<GemmTile, Variant> variants_;
+
+	static int round_up(int n, int multiple) { return (n + multiple - 1) / multiple * multiple; }
+
+	Variant& get_variant(const GemmTile& tile) {
+		std::map<GemmTile, Variant>::iterator it = variants_.find(tile);
+		if (it != variants_.end())
+			return it->second;
+
+		stringstream options;
+		options << "-DTS=" << tile.tile_size << " -DWPT=" << tile.work_per_thread << " -DTTS=" << transpose_tile_;
+		Variant variant;
+		variant.program = BuildProgram(context_, kernel_file_, options.str());
+		variant.gemm_naive = cl::Kernel(variant.program, "gemm_naive");
+		variant.gemm_tiled = cl::Kernel(variant.program, "gemm_tiled");
+		variant.transpose_naive = cl::Kernel(variant.program, "transpose_naive");
+		variant.transpose = cl::Kernel(variant.program, "transpose");
+		variant.axpby = cl::Kernel(variant.program, "axpby");
+		variant.multiply_elements = cl::Kernel(variant.program, "multiply_elements");
+		return (variants_[tile] = variant);
+	}
+
+	// the tuned program, or the smallest tile's before tuning
+	Variant& current() { return get_variant(tile_.tile_size ? tile_ : candidates_[0]); }
+
+	void gemm(const cl::CommandQueue& queue, const GemmTile& tile, const cl::Buffer& A, const cl::Buffer& B, const cl::Buffer& C,
+		int M, int N, int K, float alpha, float beta, vector<cl::Event>* events) {
+		cl::Kernel& kernel = get_variant(tile).gemm_tiled;
+		set_gemm_args(kernel, A, B, C, M, N, K, alpha, beta);
+		int ts = tile.tile_size, rts = tile.tile_size / tile.work_per_thread;
+		launch(queue, kernel, cl::NDRange(round_up(N, ts), round_up(M, ts) / ts * rts), cl::NDRange(ts, rts), events);
+	}
+
+	static void set_gemm_args(cl::Kernel& kernel, const cl::Buffer& A, const cl::Buffer& B, const cl::Buffer& C, int M, int N, int K,
+		float alpha, float beta) {
+		kernel.setArg(0, A);
+		kernel.setArg(1, B);
+		kernel.setArg(2, C);
+		kernel.setArg(3, M);
+		kernel.setArg(4, N);
+		kernel.setArg(5, K);
+		kernel.setArg(6, alpha);
+		kernel.setArg(7, beta);
+	}
+
+	static void set_element_args(cl::Kernel& kernel, const cl::Buffer& A, const cl::Buffer& B, const cl::Buffer& C, int rows, int cols) {
+		kernel.setArg(0, A);
+		kernel.setArg(1, B);
+		kernel.setArg(2, C);
+		kernel.setArg(3, rows);
+		kernel.setArg(4, cols);
+	}
+
+	static void launch(const cl::CommandQueue& queue, cl::Kernel& kernel, const cl::NDRange& global, const cl::NDRange& local,
+		vector<cl::Event>* events) {
+		cl::Event event;
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, global, local, NULL, &event);
+		if (events) events->push_back(event);
+	}
+};
+
+// GEMM, transpose and axpby on square matrices up to max_size, naive against tuned, in GFLOP/s (2*M*N*K
+// operations per product) and GB/s (one read and one write per element for the transpose, three arrays for axpby).
+// OpenCL reports neither peak, so pass the figures from the device's data sheet to get percentages. Results are
+// checked against the host up to 1024 x 1024; the queue must have profiling enabled.
+string BenchmarkMatrix(const cl::Context& context, const cl::CommandQueue& queue, int max_size = 2048, double peak_gflops = 0.0,
+	double peak_gbps = 0.0, int repeats = 5) {
+	stringstream sstream;
+	MatrixEngine matrix(context);
+
+	vector<double> times;
+	matrix.tune(queue, 512, &times);
+	sstream << "GEMM tiles (TS x TS/WPT work items, 512 x 512 product):";
+	for (size_t c = 0; c < matrix.candidates().size(); c++) {
+		const GemmTile& tile = matrix.candidates()[c];
+		sstream << " " << tile.tile_size << "/" << tile.work_per_thread << " ";
+		if (times[c] > 0) sstream << 2.0 * 512 * 512 * 512 / times[c] << " GFLOP/s"; else sstream << "-";
+	}
+	sstream << ", using TS " << matrix.tile().tile_size << " WPT " << matrix.tile().work_per_thread << endl;
+
+	const int sizes[] = { 256, 500, 512, 1000, 1024, 2048, 4096 };
+	sstream << "Matrix benchmark, " << repeats << " repeats (best):" << endl;
+	for (int s = 0; s < 7 && sizes[s] <= max_size; s++) {
+		int n = sizes[s];
+		size_t elements = (size_t)n * n, bytes = elements * sizeof(float);
+		vector<float> A(elements), B(elements), C(elements);
+		for (size_t i = 0; i < elements; i++) {
+			A[i] = (rand() % 1000) * 0.001f;
+			B[i] = (rand() % 1000) * 0.001f;
+		}
+		cl::Buffer dev_A(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, bytes, &A[0]);
+		cl::Buffer dev_B(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, bytes, &B[0]);
+		cl::Buffer dev_C(context, CL_MEM_READ_WRITE, bytes);
+
+		double best[5] = { 0, 0, 0, 0, 0 }; // gemm naive, gemm tiled, transpose naive, transpose tiled, axpby
+		for (int i = 0; i <= repeats; i++) { // the first run is a warm up
+			vector<cl::Event> events;
+			matrix.gemm_naive(queue, dev_A, dev_B, dev_C, n, n, n, 1.f, 0.f, &events);
+			matrix.gemm(queue, dev_A, dev_B, dev_C, n, n, n, 1.f, 0.f, &events);
+			matrix.transpose(queue, dev_A, dev_C, n, n, &events, false);
+			matrix.transpose(queue, dev_A, dev_C, n, n, &events, true);
+			matrix.axpby(queue, dev_A, dev_B, dev_C, n, n, 2.f, -1.f, &events);
+			cl::Event::waitForEvents(events);
+			for (int k = 0; k < 5 && i > 0; k++) {
+				double time = GetExecutionTime(events[k], PROF_NS);
+				if ((best[k] == 0) || (time < best[k])) best[k] = time;
+			}
+		}
+
+		// the last launch was axpby; check it, then the transpose and the product
+		string wrong;
+		if (n <= 1024) {
+			queue.enqueueReadBuffer(dev_C, CL_TRUE, 0, bytes, &C[0]);
+			for (size_t i = 0; i < elements; i++)
+				if (std::fabs(C[i] - (2.f * A[i] - B[i])) > 1e-5f) { wrong += ", axpby WRONG"; break; }
+
+			matrix.transpose(queue, dev_A, dev_C, n, n);
+			queue.enqueueReadBuffer(dev_C, CL_TRUE, 0, bytes, &C[0]);
+			for (int y = 0; y < n && wrong.find("transpose") == string::npos; y++)
+				for (int x = 0; x < n; x++)
+					if (C[(size_t)x * n + y] != A[(size_t)y * n + x]) { wrong += ", transpose WRONG"; break; }
+
+			matrix.gemm(queue, dev_A, dev_B, dev_C, n, n, n);
+			queue.enqueueReadBuffer(dev_C, CL_TRUE, 0, bytes, &C[0]);
+			vector<double> row(n);
+			for (int y = 0; y < n && wrong.find("gemm") == string::npos; y++) {
+				std::fill(row.begin(), row.end(), 0.0);
+				for (int k = 0; k < n; k++)
+					for (int x = 0; x < n; x++)
+						row[x] += (double)A[(size_t)y * n + k] * B[(size_t)k * n + x];
+				for (int x = 0; x < n; x++)
+					if (std::fabs(C[(size_t)y * n + x] - row[x]) > 1e-3 * (1.0 + std::fabs(row[x]))) { wrong += ", gemm WRONG"; break; }
+			}
+		}
+
+		double flops = 2.0 * n * n * n;
+		sstream << "   " << n << " x " << n << ": gemm naive " << flops / best[0] << " GFLOP/s, tiled " << flops / best[1] << " GFLOP/s";
+		if (peak_gflops > 0) sstream << " (" << (int)(100.0 * flops / best[1] / peak_gflops + 0.5) << "% of peak)";
+		sstream << "; transpose naive " << 2.0 * bytes / best[2] << " GB/s, tiled " << 2.0 * bytes / best[3] << " GB/s";
+		if (peak_gbps > 0) sstream << " (" << (int)(100.0 * 2.0 * bytes / best[3] / peak_gbps + 0.5) << "% of peak)";
+		sstream << "; axpby " << 3.0 * bytes / best[4] << " GB/s";
+		if (peak_gbps > 0) sstream << " (" << (int)(100.0 * 3.0 * bytes / best[4] / peak_gbps + 0.5) << "% of peak)";
+		sstream << ((n <= 1024) ? wrong : string(", not checked")) << endl;
+	}
+
+	return sstream.str();
+}
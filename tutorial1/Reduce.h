@@ -0,0 +1,349 @@
+#pragma once
+
+// Parallel reductions (kernels/reduce.cl): sum, min, max and argmin of a buffer of uchar, ushort, int or float
+// elements, with three strategies:
+//   REDUCE_TREE         one element per work item and a local-memory tree per group, relaunched on the partial
+//                       results until one value is left (log_L(n) launches)
+//   REDUCE_GRID_STRIDE  a fixed number of groups, each work item accumulating many elements in registers before
+//                       the tree, then one single-group launch over the partial results (2 launches)
+//   REDUCE_BUILTIN      as grid-stride with OpenCL C 2.0 work-group functions (work_group_reduce_*) instead of
+//                       the tree, or sub-group functions (sub_group_reduce_*, cl_khr_subgroups/cl_intel_subgroups)
+//                       on devices without them; not available when the device has neither
+// REDUCE_AUTO times every available strategy the first time an operation is run and keeps the fastest.
+// Integer sums are accumulated in 64 bits, and min/max of uchar and ushort in int.
+//
+//   Reducer<cl_ushort> reducer(context);
+//   cl_ulong total = reducer.sum(queue, dev_image, pixels);
+//   int darkest = reducer.argmin(queue, dev_image, pixels);
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+#include "Utils.h"
+
+enum ReduceOp {
+	REDUCE_SUM,
+	REDUCE_MIN,
+	REDUCE_MAX,
+	REDUCE_ARGMIN
+};
+
+enum ReduceStrategy {
+	REDUCE_TREE,
+	REDUCE_GRID_STRIDE,
+	REDUCE_BUILTIN,
+	REDUCE_AUTO
+};
+
+const char* GetReduceOpName(ReduceOp op) {
+	switch (op) {
+	case REDUCE_SUM: return "sum";
+	case REDUCE_MIN: return "min";
+	case REDUCE_MAX: return "max";
+	default: return "argmin";
+	}
+}
+
+const char* GetReduceStrategyName(ReduceStrategy strategy) {
+	switch (strategy) {
+	case REDUCE_TREE: return "tree";
+	case REDUCE_GRID_STRIDE: return "grid-stride";
+	case REDUCE_BUILTIN: return "built-in";
+	default: return "auto";
+	}
+}
+
+// element type -> OpenCL type names and accumulator types for sums (sum_type) and comparisons (min_type)
+template <typename T> struct ReduceTraits;
+
+template <> struct ReduceTraits<cl_uchar> {
+	typedef cl_ulong sum_type;
+	typedef cl_int min_type;
+	static const char* name() { return "uchar"; }
+	static const char* sum_name() { return "ulong"; }
+	static const char* min_name() { return "int"; }
+};
+
+template <> struct ReduceTraits<cl_ushort> {
+	typedef cl_ulong sum_type;
+	typedef cl_int min_type;
+	static const char* name() { return "ushort"; }
+	static const char* sum_name() { return "ulong"; }
+	static const char* min_name() { return "int"; }
+};
+
+template <> struct ReduceTraits<cl_int> {
+	typedef cl_long sum_type;
+	typedef cl_int min_type;
+	static const char* name() { return "int"; }
+	static const char* sum_name() { return "long"; }
+	static const char* min_name() { return "int"; }
+};
+
+template <> struct ReduceTraits<cl_float> {
+	typedef cl_float sum_type;
+	typedef cl_float min_type;
+	static const char* name() { return "float"; }
+	static const char* sum_name() { return "float"; }
+	static const char* min_name() { return "float"; }
+};
+
+template <typename T>
+class Reducer {
+public:
+	typedef typename ReduceTraits<T>::sum_type sum_type;
+	typedef typename ReduceTraits<T>::min_type min_type;
+
+	Reducer(const cl::Context& context, const string& kernel_file = "kernels/reduce.cl")
+		: context_(context), kernel_file_(kernel_file), partial_count_(0) {
+		cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+		size_t max_work_group_size = device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+		group_size_ = 1;
+		while (group_size_ * 2 <= std::min((size_t)256, max_work_group_size)) group_size_ *= 2;
+		compute_units_ = device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+
+		// work-group functions need OpenCL C 2.0, and are optional again in 3.0
+		string version = device.getInfo<CL_DEVICE_OPENCL_C_VERSION>(); // "OpenCL C major.minor ..."
+		int major = (version.size() > 9) ? atoi(version.c_str() + 9) : 1;
+		std_option_ = (major >= 3) ? " -cl-std=CL3.0" : (major == 2) ? " -cl-std=CL2.0" : "";
+
+		for (int op = 0; op < 4; op++) {
+			built_[op] = false;
+			strategy_[op] = REDUCE_AUTO;
+		}
+	}
+
+	sum_type sum(const cl::CommandQueue& queue, const cl::Buffer& input, int n, ReduceStrategy strategy = REDUCE_AUTO, vector<cl::Event>* events = NULL) {
+		sum_type result;
+		run(queue, REDUCE_SUM, input, n, strategy, &result, NULL, events);
+		return result;
+	}
+
+	min_type min(const cl::CommandQueue& queue, const cl::Buffer& input, int n, ReduceStrategy strategy = REDUCE_AUTO, vector<cl::Event>* events = NULL) {
+		min_type result;
+		run(queue, REDUCE_MIN, input, n, strategy, &result, NULL, events);
+		return result;
+	}
+
+	min_type max(const cl::CommandQueue& queue, const cl::Buffer& input, int n, ReduceStrategy strategy = REDUCE_AUTO, vector<cl::Event>* events = NULL) {
+		min_type result;
+		run(queue, REDUCE_MAX, input, n, strategy, &result, NULL, events);
+		return result;
+	}
+
+	// index of the smallest element (the first one on ties), and its value if value is given
+	int argmin(const cl::CommandQueue& queue, const cl::Buffer& input, int n, min_type* value = NULL, ReduceStrategy strategy = REDUCE_AUTO,
+		vector<cl::Event>* events = NULL) {
+		min_type result;
+		int index;
+		run(queue, REDUCE_ARGMIN, input, n, strategy, &result, &index, events);
+		if (value) *value = result;
+		return index;
+	}
+
+	bool supports(ReduceOp op, ReduceStrategy strategy) {
+		build(op);
+		return (strategy != REDUCE_BUILTIN) || has_builtin_[op];
+	}
+
+	// the strategy REDUCE_AUTO picked for op, REDUCE_AUTO before the first run
+	ReduceStrategy strategy(ReduceOp op) const { return strategy_[op]; }
+
+private:
+	cl::Context context_;
+	string kernel_file_, std_option_;
+	size_t group_size_, compute_units_;
+
+	cl::Program programs_[4];
+	cl::Kernel kernels_[4][3];
+	bool built_[4], has_builtin_[4];
+	ReduceStrategy strategy_[4];
+
+	// partial results of the passes, ping-ponged; large enough for the first tree pass
+	cl::Buffer partials_[2], partial_indices_[2];
+	size_t partial_count_;
+
+	static size_t accumulator_size(ReduceOp op) { return (op == REDUCE_SUM) ? sizeof(sum_type) : sizeof(min_type); }
+
+	// one program per operation, built on first use
+	void build(ReduceOp op) {
+		if (built_[op]) return;
+
+		const bool is_float = (string(ReduceTraits<T>::name()) == "float");
+		const char* identity;
+		switch (op) {
+		case REDUCE_SUM: identity = "0"; break;
+		case REDUCE_MAX: identity = is_float ? "-INFINITY" : "INT_MIN"; break;
+		default: identity = is_float ? "INFINITY" : "INT_MAX"; break;
+		}
+		const char* op_names[] = { "OP_SUM", "OP_MIN", "OP_MAX", "OP_ARGMIN" };
+
+		stringstream options;
+		options << "-DDATA_T=" << ReduceTraits<T>::name() << " -DACC_T="
+			<< ((op == REDUCE_SUM) ? ReduceTraits<T>::sum_name() : ReduceTraits<T>::min_name())
+			<< " -DIDENTITY=" << identity << " -D" << op_names[op] << std_option_;
+		programs_[op] = BuildProgram(context_, kernel_file_, options.str());
+		kernels_[op][REDUCE_TREE] = cl::Kernel(programs_[op], "reduce_tree");
+		kernels_[op][REDUCE_GRID_STRIDE] = cl::Kernel(programs_[op], "reduce_grid_stride");
+		try {
+			kernels_[op][REDUCE_BUILTIN] = cl::Kernel(programs_[op], "reduce_builtin");
+			has_builtin_[op] = true;
+		}
+		catch (const cl::Error&) {
+			has_builtin_[op] = false; // not compiled for this device (CL_INVALID_KERNEL_NAME)
+		}
+		built_[op] = true;
+	}
+
+	void launch(const cl::CommandQueue& queue, ReduceOp op, ReduceStrategy strategy, const cl::Buffer& input, const cl::Buffer& P,
+		const cl::Buffer& P_indices, int slot, int n, bool first_pass, size_t groups, vector<cl::Event>* events) {
+		cl::Kernel& kernel = kernels_[op][strategy];
+		kernel.setArg(0, input);
+		kernel.setArg(1, P);
+		kernel.setArg(2, P_indices);
+		kernel.setArg(3, partials_[slot]);
+		kernel.setArg(4, partial_indices_[slot]);
+		kernel.setArg(5, n);
+		kernel.setArg(6, first_pass ? 1 : 0);
+		kernel.setArg(7, cl::Local(group_size_ * accumulator_size(op)));
+		kernel.setArg(8, cl::Local(group_size_ * sizeof(cl_int)));
+
+		cl::Event event;
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(groups * group_size_), cl::NDRange(group_size_), NULL, &event);
+		if (events) events->push_back(event);
+	}
+
+	// all passes of one strategy; returns the slot holding the single final value
+	int reduce(const cl::CommandQueue& queue, ReduceOp op, ReduceStrategy strategy, const cl::Buffer& input, int n, vector<cl::Event>* events) {
+		if (strategy == REDUCE_TREE) {
+			int slot = 0;
+			bool first_pass = true;
+			do {
+				size_t groups = (n + group_size_ - 1) / group_size_;
+				launch(queue, op, strategy, input, partials_[1 - slot], partial_indices_[1 - slot], slot, n, first_pass, groups, events);
+				n = (int)groups;
+				slot = 1 - slot;
+				first_pass = false;
+			} while (n > 1);
+			return 1 - slot;
+		}
+
+		// enough groups to fill the device, no more than the data can occupy
+		size_t groups = std::min(compute_units_ * 4, (n + group_size_ - 1) / group_size_);
+		launch(queue, op, strategy, input, partials_[1], partial_indices_[1], 0, n, true, groups, events);
+		launch(queue, op, strategy, input, partials_[0], partial_indices_[0], 1, (int)groups, false, 1, events);
+		return 1;
+	}
+
+	template <typename A>
+	void run(const cl::CommandQueue& queue, ReduceOp op, const cl::Buffer& input, int n, ReduceStrategy strategy, A* result, int* index,
+		vector<cl::Event>* events) {
+		if (n < 1)
+			throw cl::Error(CL_INVALID_VALUE, "Reducer: nothing to reduce");
+		build(op);
+
+		size_t partial_count = std::max((size_t)(n + group_size_ - 1) / group_size_, compute_units_ * 4);
+		if (partial_count > partial_count_) {
+			for (int i = 0; i < 2; i++) {
+				partials_[i] = cl::Buffer(context_, CL_MEM_READ_WRITE, partial_count * sizeof(cl_long));
+				partial_indices_[i] = cl::Buffer(context_, CL_MEM_READ_WRITE, partial_count * sizeof(cl_int));
+			}
+			partial_count_ = partial_count;
+		}
+
+		if (strategy == REDUCE_AUTO) {
+			if (strategy_[op] == REDUCE_AUTO) tune(queue, op, input, n);
+			strategy = strategy_[op];
+		}
+		else if (!supports(op, strategy)) {
+			throw cl::Error(CL_INVALID_VALUE, "Reducer: neither work-group nor sub-group functions are supported by this device");
+		}
+
+		int slot = reduce(queue, op, strategy, input, n, events);
+		queue.enqueueReadBuffer(partials_[slot], CL_TRUE, 0, sizeof(A), result);
+		if (index) queue.enqueueReadBuffer(partial_indices_[slot], CL_TRUE, 0, sizeof(int), index);
+	}
+
+	// time each available strategy on this input (best of 3) and keep the fastest
+	void tune(const cl::CommandQueue& queue, ReduceOp op, const cl::Buffer& input, int n) {
+		double best_time = 0;
+		for (int s = REDUCE_TREE; s <= REDUCE_BUILTIN; s++) {
+			if (!supports(op, (ReduceStrategy)s)) continue;
+			for (int i = 0; i < 3; i++) {
+				vector<cl::Event> events;
+				reduce(queue, op, (ReduceStrategy)s, input, n, &events);
+				double time = GetExecutionTime(events, PROF_NS);
+				if ((best_time == 0) || (time < best_time)) {
+					best_time = time;
+					strategy_[op] = (ReduceStrategy)s;
+				}
+			}
+		}
+	}
+};
+
+// Every operation and strategy on n random elements against a host loop, in GB/s of input read; the queue must
+// have profiling enabled
+template <typename T>
+string BenchmarkReduce(const cl::Context& context, const cl::CommandQueue& queue, int n, int repeats = 10) {
+	typedef typename Reducer<T>::min_type min_type;
+	stringstream sstream;
+	vector<T> data(n);
+	for (int i = 0; i < n; i++)
+		data[i] = (T)(rand() % 200 + 10);
+	data[rand() % n] = (T)1;
+
+	double host_sum = 0, tolerance = std::numeric_limits<T>::is_integer ? 0.0 : 1e-4;
+	for (int i = 0; i < n; i++) host_sum += (double)data[i];
+	int host_argmin = (int)(std::min_element(data.begin(), data.end()) - data.begin());
+	min_type host_min = (min_type)data[host_argmin], host_max = (min_type)*std::max_element(data.begin(), data.end());
+
+	Reducer<T> reducer(context);
+	cl::Buffer input(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, n * sizeof(T), &data[0]);
+
+	sstream << "Reduction benchmark, " << n << " " << ReduceTraits<T>::name() << " elements, " << repeats << " repeats:" << endl;
+	for (int op = REDUCE_SUM; op <= REDUCE_ARGMIN; op++) {
+		sstream << "   " << GetReduceOpName((ReduceOp)op) << ":";
+		for (int s = REDUCE_TREE; s <= REDUCE_BUILTIN; s++) {
+			if (!reducer.supports((ReduceOp)op, (ReduceStrategy)s)) { sstream << " " << GetReduceStrategyName((ReduceStrategy)s) << " -"; continue; }
+
+			double time = 0;
+			bool correct = true;
+			for (int i = 0; i <= repeats; i++) { // the first run is a warm up
+				vector<cl::Event> events;
+				switch (op) {
+				case REDUCE_SUM: {
+					double sum = (double)reducer.sum(queue, input, n, (ReduceStrategy)s, &events);
+					correct = std::fabs(sum - host_sum) <= tolerance * host_sum;
+					break;
+				}
+				case REDUCE_MIN: correct = (reducer.min(queue, input, n, (ReduceStrategy)s, &events) == host_min); break;
+				case REDUCE_MAX: correct = (reducer.max(queue, input, n, (ReduceStrategy)s, &events) == host_max); break;
+				default: correct = (reducer.argmin(queue, input, n, NULL, (ReduceStrategy)s, &events) == host_argmin); break;
+				}
+				double t = GetExecutionTime(events, PROF_NS);
+				if (i > 0) time += t / repeats;
+			}
+			sstream << " " << GetReduceStrategyName((ReduceStrategy)s) << " " << time / 1e6 << " [ms] (" << n * sizeof(T) / time << " GB/s"
+				<< (correct ? "" : ", WRONG") << ")";
+		}
+		sstream << endl;
+	}
+
+	sstream << "   auto picks:";
+	for (int op = REDUCE_SUM; op <= REDUCE_ARGMIN; op++) {
+		switch (op) {
+		case REDUCE_SUM: reducer.sum(queue, input, n); break;
+		case REDUCE_MIN: reducer.min(queue, input, n); break;
+		case REDUCE_MAX: reducer.max(queue, input, n); break;
+		default: reducer.argmin(queue, input, n); break;
+		}
+		sstream << " " << GetReduceOpName((ReduceOp)op) << " " << GetReduceStrategyName(reducer.strategy((ReduceOp)op));
+	}
+	sstream << endl;
+
+	return sstream.str();
+}
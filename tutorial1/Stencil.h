@@ -0,0 +1,258 @@
+#pragma once
+
+// 1D stencils on float signals: B[i] = sum over k of weights[k]*A[i + k - radius], for any odd number of weights.
+//
+// The kernel source is generated for each set of weights and boundary policy, with the weights as literals and
+// the taps unrolled. Each work group loads its tile of the signal plus radius elements either side (the halo)
+// into local memory once, and the taps read from there, so every element is read from global memory about once.
+// The same program also has stencil_global, which reads every tap from global memory, for comparison. Programs
+// are cached by signature.
+//
+// Boundary policies for taps outside [0, n):
+//   clamp   repeat the end element            (..., a0, a0 | a0, a1, ...)
+//   mirror  reflect without repeating the end (..., a2, a1 | a0, a1, ...)
+//   zero    read zeros
+//   wrap    periodic signal                   (..., an-2, an-1 | a0, a1, ...)
+//
+//   StencilEngine stencil(context);
+//   stencil.apply(queue, dev_signal, dev_smoothed, n, weights, STENCIL_MIRROR);
+
+#include <cmath>
+#include <iomanip>
+#include <map>
+
+#include "Utils.h"
+
+enum StencilBoundary {
+	STENCIL_CLAMP,
+	STENCIL_MIRROR,
+	STENCIL_ZERO,
+	STENCIL_WRAP
+};
+
+bool ParseStencilBoundary(const string& name, StencilBoundary& boundary) {
+	if (name == "clamp") boundary = STENCIL_CLAMP;
+	else if (name == "mirror") boundary = STENCIL_MIRROR;
+	else if (name == "zero") boundary = STENCIL_ZERO;
+	else if (name == "wrap") boundary = STENCIL_WRAP;
+	else return false;
+	return true;
+}
+
+const char* GetStencilBoundaryName(StencilBoundary boundary) {
+	switch (boundary) {
+	case STENCIL_CLAMP: return "clamp";
+	case STENCIL_MIRROR: return "mirror";
+	case STENCIL_ZERO: return "zero";
+	default: return "wrap";
+	}
+}
+
+// "1,4,6,4,1" -> weights; false if a field is not a number
+bool ParseStencilWeights(const string& list, vector<float>& weights) {
+	stringstream sstream(list);
+	string field;
+	weights.clear();
+	while (std::getline(sstream, field, ',')) {
+		char* end;
+		float weight = (float)strtod(field.c_str(), &end);
+		if (field.empty() || *end) return false;
+		weights.push_back(weight);
+	}
+	return !weights.empty();
+}
+
+// float constant as an OpenCL C literal that round-trips exactly
+string StencilLiteral(float value) {
+	stringstream sstream;
+	sstream << std::scientific << std::setprecision(9) << value << "f";
+	return sstream.str();
+}
+
+// Source of stencil(global const float* A, global float* B, const int n, local float* tile) and
+// stencil_global(global const float* A, global float* B, const int n) for these weights and boundary policy
+string GenerateStencilKernel(const vector<float>& weights, StencilBoundary boundary) {
+	int radius = (int)weights.size() / 2;
+	stringstream src;
+
+	// value of element i of the signal, applying the boundary policy
+	src << "float element(global const float* A, int i, const int n) {\n";
+	switch (boundary) {
+	case STENCIL_CLAMP: src << "\treturn A[clamp(i, 0, n - 1)];\n"; break;
+	case STENCIL_MIRROR: src << "\treturn A[(i < 0) ? -i : (i >= n) ? 2*n - 2 - i : i];\n"; break;
+	case STENCIL_ZERO: src << "\treturn ((i >= 0) && (i < n)) ? A[i] : 0.0f;\n"; break;
+	case STENCIL_WRAP: src << "\treturn A[(i < 0) ? i + n : (i >= n) ? i - n : i];\n"; break;
+	}
+	src << "}\n\n";
+
+	// weighted sum of the taps t[0] .. t[2*radius] around the output element
+	stringstream sum;
+	for (size_t k = 0; k < weights.size(); k++) {
+		if (weights[k] == 0.f) continue;
+		if (sum.tellp() > 0) sum << " + ";
+		sum << StencilLiteral(weights[k]) << "*t" << k;
+	}
+	if (sum.tellp() == 0) sum << "0.0f";
+
+	src << "kernel void stencil(global const float* A, global float* B, const int n, local float* tile) {\n";
+	src << "\tint id = get_global_id(0);\n";
+	src << "\tint lid = get_local_id(0);\n";
+	src << "\tint origin = get_group_id(0)*get_local_size(0) - " << radius << ";\n";
+	src << "\tfor (int i = lid; i < get_local_size(0) + " << 2 * radius << "; i += get_local_size(0))\n";
+	src << "\t\ttile[i] = element(A, min(origin + i, n - 1 + " << radius << "), n); //the padding past n is never used\n";
+	src << "\tbarrier(CLK_LOCAL_MEM_FENCE);\n";
+	src << "\tif (id >= n) return;\n";
+	for (size_t k = 0; k < weights.size(); k++)
+		if (weights[k] != 0.f) src << "\tfloat t" << k << " = tile[lid + " << k << "];\n";
+	src << "\tB[id] = " << sum.str() << ";\n";
+	src << "}\n\n";
+
+	src << "kernel void stencil_global(global const float* A, global float* B, const int n) {\n";
+	src << "\tint id = get_global_id(0);\n";
+	src << "\tif (id >= n) return;\n";
+	for (size_t k = 0; k < weights.size(); k++)
+		if (weights[k] != 0.f) src << "\tfloat t" << k << " = element(A, id " << (((int)k < radius) ? "- " : "+ ") << std::abs((int)k - radius) << ", n);\n";
+	src << "\tB[id] = " << sum.str() << ";\n";
+	src << "}\n";
+
+	return src.str();
+}
+
+class StencilEngine {
+public:
+	StencilEngine(const cl::Context& context) : context_(context) {
+		cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+		group_size_ = std::min((size_t)256, (size_t)device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>());
+	}
+
+	// Apply the stencil to a signal of n elements; input and output must be different buffers. The signal must be
+	// longer than the radius for the mirror and wrap policies.
+	void apply(const cl::CommandQueue& queue, const cl::Buffer& input, const cl::Buffer& output, int n, const vector<float>& weights,
+		StencilBoundary boundary, vector<cl::Event>* events = NULL, bool tiled = true) {
+		int radius = (int)weights.size() / 2;
+		if (weights.size() % 2 == 0)
+			throw cl::Error(CL_INVALID_VALUE, "StencilEngine: the number of weights must be odd");
+		if (((boundary == STENCIL_MIRROR) || (boundary == STENCIL_WRAP)) && (n <= radius))
+			throw cl::Error(CL_INVALID_VALUE, "StencilEngine: the signal is shorter than the stencil radius");
+
+		Entry& entry = get_entry(weights, boundary);
+		cl::Kernel& kernel = tiled ? entry.kernel : entry.global_kernel;
+		kernel.setArg(0, input);
+		kernel.setArg(1, output);
+		kernel.setArg(2, n);
+		if (tiled) kernel.setArg(3, cl::Local((group_size_ + 2 * radius) * sizeof(float)));
+
+		cl::Event event;
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange((n + group_size_ - 1) / group_size_ * group_size_),
+			cl::NDRange(group_size_), NULL, &event);
+		if (events) events->push_back(event);
+	}
+
+private:
+	struct Entry {
+		cl::Program program;
+		cl::Kernel kernel, global_kernel;
+	};
+
+	cl::Context context_;
+	size_t group_size_;
+	std::map<string, Entry> cache_;
+
+	Entry& get_entry(const vector<float>& weights, StencilBoundary boundary) {
+		stringstream signature;
+		signature << boundary;
+		for (size_t k = 0; k < weights.size(); k++)
+			signature << "|" << StencilLiteral(weights[k]);
+		std::map<string, Entry>::iterator it = cache_.find(signature.str());
+		if (it != cache_.end())
+			return it->second;
+
+		Entry entry;
+		entry.program = cl::Program(context_, GenerateStencilKernel(weights, boundary));
+		try {
+			entry.program.build();
+		}
+		catch (const cl::Error& err) {
+			cl::Device device = context_.getInfo<CL_CONTEXT_DEVICES>()[0];
+			std::cout << "Build Status: " << entry.program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(device) << std::endl;
+			std::cout << "Build Log:\t " << entry.program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device) << std::endl;
+			throw err;
+		}
+		entry.kernel = cl::Kernel(entry.program, "stencil");
+		entry.global_kernel = cl::Kernel(entry.program, "stencil_global");
+
+		return (cache_[signature.str()] = entry);
+	}
+};
+
+// Single-threaded reference with the same boundary policies
+void StencilHost(const vector<float>& A, vector<float>& B, const vector<float>& weights, StencilBoundary boundary) {
+	int n = (int)A.size(), radius = (int)weights.size() / 2;
+	B.assign(n, 0.f);
+	for (int i = 0; i < n; i++) {
+		float sum = 0.f;
+		for (int k = 0; k < (int)weights.size(); k++) {
+			int j = i + k - radius;
+			float value;
+			if ((j >= 0) && (j < n)) value = A[j];
+			else if (boundary == STENCIL_CLAMP) value = A[(j < 0) ? 0 : n - 1];
+			else if (boundary == STENCIL_MIRROR) value = A[(j < 0) ? -j : 2 * n - 2 - j];
+			else if (boundary == STENCIL_WRAP) value = A[(j < 0) ? j + n : j - n];
+			else value = 0.f;
+			sum += weights[k] * value;
+		}
+		B[i] = sum;
+	}
+}
+
+// Tiled and global-memory stencils against a device copy of the same signal for 1K to 100M elements, in GB/s of
+// one read and one write per element; the queue must have profiling enabled
+string BenchmarkStencil(const cl::Context& context, const cl::CommandQueue& queue, const vector<float>& weights, StencilBoundary boundary,
+	int repeats = 10) {
+	stringstream sstream;
+	StencilEngine stencil(context);
+	cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+	size_t max_bytes = (size_t)std::min(device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>(), device.getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>() / 3);
+
+	sstream << "Stencil benchmark, " << weights.size() << " taps, " << GetStencilBoundaryName(boundary) << " boundary, "
+		<< repeats << " repeats (best):" << endl;
+	for (int n = 1000; n <= 100000000; n *= 10) {
+		size_t bytes = n * sizeof(float);
+		if (bytes > max_bytes) { sstream << "   " << n << ": too large for the device" << endl; break; }
+
+		vector<float> signal(n), result(n), reference;
+		for (int i = 0; i < n; i++)
+			signal[i] = std::sin(i * 0.01f) + (rand() % 100) * 0.01f; // a noisy trace
+		cl::Buffer dev_input(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, bytes, &signal[0]);
+		cl::Buffer dev_output(context, CL_MEM_READ_WRITE, bytes);
+
+		double times[3] = { 0, 0, 0 }; // copy, tiled, global
+		for (int i = 0; i <= repeats; i++) { // the first run is a warm up
+			vector<cl::Event> events(1);
+			queue.enqueueCopyBuffer(dev_input, dev_output, 0, 0, bytes, NULL, &events[0]);
+			stencil.apply(queue, dev_input, dev_output, n, weights, boundary, &events, true);
+			stencil.apply(queue, dev_input, dev_output, n, weights, boundary, &events, false);
+			cl::Event::waitForEvents(events);
+			for (int k = 0; k < 3 && i > 0; k++) {
+				double time = GetExecutionTime(events[k], PROF_NS);
+				if ((times[k] == 0) || (time < times[k])) times[k] = time;
+			}
+		}
+
+		// the last launch was the global-memory kernel; check it and then the tiled one
+		StencilHost(signal, reference, weights, boundary);
+		bool correct = true;
+		for (int pass = 0; pass < 2; pass++) {
+			if (pass == 1) stencil.apply(queue, dev_input, dev_output, n, weights, boundary);
+			queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, bytes, &result[0]);
+			for (int i = 0; i < n && correct; i++)
+				correct = std::fabs(result[i] - reference[i]) <= 1e-4f * (1.f + std::fabs(reference[i]));
+		}
+
+		sstream << "   " << n << ": copy " << 2.0 * bytes / times[0] << " GB/s, tiled " << 2.0 * bytes / times[1] << " GB/s ("
+			<< (int)(100.0 * times[0] / times[1] + 0.5) << "% of copy), global " << 2.0 * bytes / times[2] << " GB/s ("
+			<< (int)(100.0 * times[0] / times[2] + 0.5) << "% of copy)" << (correct ? "" : ", WRONG") << endl;
+	}
+
+	return sstream.str();
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+// STREAM-style memory bandwidth benchmark (kernels/stream.cl): copy, scale, add and triad over int and float
+// elements of vector width 1 to 16, array sizes from a few KB up to the largest buffer the device allows, and a
+// range of work-group sizes. Each result is the best of several runs, reported in GB/s (10^9 bytes per second)
+// counting one read or write of every array element. OpenCL does not report the theoretical memory bandwidth,
+// so pass the figure from the device's data sheet as peak to get the percentage reached.
+//
+//   StreamOptions options;
+//   options.peak = 448.0;
+//   std::cout << BenchmarkStream(context, queue, options);
+
+#include <algorithm>
+
+#include "Utils.h"
+
+enum StreamKernel {
+	STREAM_COPY,
+	STREAM_SCALE,
+	STREAM_ADD,
+	STREAM_TRIAD
+};
+
+const char* GetStreamKernelName(StreamKernel kernel) {
+	switch (kernel) {
+	case STREAM_COPY: return "copy";
+	case STREAM_SCALE: return "scale";
+	case STREAM_ADD: return "add";
+	default: return "triad";
+	}
+}
+
+// number of arrays read or written per element
+int GetStreamArrays(StreamKernel kernel) {
+	return ((kernel == STREAM_ADD) || (kernel == STREAM_TRIAD)) ? 3 : 2;
+}
+
+struct StreamOptions {
+	vector<string> types;       // "int" and/or "float"
+	vector<int> widths;         // vector widths: 1, 2, 4, 8, 16
+	vector<size_t> local_sizes; // 0 lets the implementation choose
+	size_t min_bytes;           // per array
+	size_t max_bytes;           // per array, 0 for the device limit
+	double peak;                // theoretical bandwidth in GB/s, 0 if unknown
+	int repeats;
+
+	StreamOptions() : min_bytes(4 << 10), max_bytes(0), peak(0.0), repeats(5) {
+		types.push_back("int");
+		types.push_back("float");
+		for (int width = 1; width <= 16; width *= 2) widths.push_back(width);
+		local_sizes.push_back(0);
+		for (size_t local_size = 64; local_size <= 1024; local_size *= 2) local_sizes.push_back(local_size);
+	}
+};
+
+// 4096 -> "4 KB"
+string FormatBytes(size_t bytes) {
+	const char* units[] = { "B", "KB", "MB", "GB" };
+	int unit = 0;
+	while ((unit < 3) && (bytes >= 1024) && (bytes % 1024 == 0)) { bytes /= 1024; unit++; }
+	stringstream sstream;
+	sstream << bytes << " " << units[unit];
+	return sstream.str();
+}
+
+// One element type and width over every size; A is filled with 1 and B with 2 and the scale factor is 3, so each
+// kernel's output is a known constant that is checked at the smallest size
+template <typename T>
+string StreamSweep(const cl::Context& context, const cl::CommandQueue& queue, const string& type_name, int width,
+	const StreamOptions& options, const cl::Buffer& A, const cl::Buffer& B, const cl::Buffer& C, size_t max_bytes, double best[4]) {
+	stringstream sstream, build_options;
+	string data_type = type_name + ((width > 1) ? std::to_string(width) : "");
+	build_options << "-DDATA_T=" << data_type << " -DSCALAR_T=" << type_name;
+	cl::Program program = BuildProgram(context, "kernels/stream.cl", build_options.str());
+	cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+
+	cl::Kernel kernels[4] = { cl::Kernel(program, "stream_copy"), cl::Kernel(program, "stream_scale"),
+		cl::Kernel(program, "stream_add"), cl::Kernel(program, "stream_triad") };
+	const T expected[4] = { (T)1, (T)3, (T)3, (T)7 };
+	T s = (T)3;
+	kernels[STREAM_COPY].setArg(0, A);
+	kernels[STREAM_COPY].setArg(1, C);
+	kernels[STREAM_SCALE].setArg(0, A);
+	kernels[STREAM_SCALE].setArg(1, C);
+	kernels[STREAM_SCALE].setArg(2, s);
+	kernels[STREAM_ADD].setArg(0, A);
+	kernels[STREAM_ADD].setArg(1, B);
+	kernels[STREAM_ADD].setArg(2, C);
+	kernels[STREAM_TRIAD].setArg(0, A);
+	kernels[STREAM_TRIAD].setArg(1, B);
+	kernels[STREAM_TRIAD].setArg(2, C);
+	kernels[STREAM_TRIAD].setArg(3, s);
+
+	size_t element_bytes = sizeof(T) * width;
+	for (size_t bytes = std::max(options.min_bytes, element_bytes); bytes <= max_bytes; bytes *= 4) {
+		size_t elements = bytes / element_bytes;
+		sstream << "   " << data_type << ", " << FormatBytes(elements * element_bytes) << ":";
+
+		for (int k = STREAM_COPY; k <= STREAM_TRIAD; k++) {
+			size_t max_local_size = kernels[k].getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device);
+			double best_time = 0;
+			size_t best_local_size = 0;
+			for (size_t l = 0; l < options.local_sizes.size(); l++) {
+				size_t local_size = options.local_sizes[l];
+				if ((local_size > max_local_size) || (local_size > elements) || (local_size && (elements % local_size))) continue;
+				for (int i = 0; i <= options.repeats; i++) { // the first run is a warm up
+					cl::Event event;
+					queue.enqueueNDRangeKernel(kernels[k], cl::NullRange, cl::NDRange(elements),
+						local_size ? cl::NDRange(local_size) : cl::NullRange, NULL, &event);
+					event.wait();
+					double time = GetExecutionTime(event, PROF_NS);
+					if ((i > 0) && ((best_time == 0) || (time < best_time))) {
+						best_time = time;
+						best_local_size = local_size;
+					}
+				}
+			}
+			if (best_time == 0) { sstream << " " << GetStreamKernelName((StreamKernel)k) << " -"; continue; }
+
+			if (bytes == std::max(options.min_bytes, element_bytes)) {
+				vector<T> result(elements * width);
+				queue.enqueueReadBuffer(C, CL_TRUE, 0, elements * element_bytes, &result[0]);
+				if (std::count(result.begin(), result.end(), expected[k]) != (ptrdiff_t)result.size())
+					sstream << " [" << GetStreamKernelName((StreamKernel)k) << " gave wrong results]";
+			}
+
+			double gbps = GetStreamArrays((StreamKernel)k) * elements * element_bytes / best_time; // bytes per ns
+			best[k] = std::max(best[k], gbps);
+			sstream << " " << GetStreamKernelName((StreamKernel)k) << " " << gbps << " GB/s (local "
+				<< (best_local_size ? std::to_string(best_local_size) : string("auto"));
+			if (options.peak > 0) sstream << ", " << (int)(100.0 * gbps / options.peak + 0.5) << "%";
+			sstream << ")" << ((k < STREAM_TRIAD) ? "," : "");
+		}
+		sstream << endl;
+	}
+
+	return sstream.str();
+}
+
+// The whole sweep; the queue must have profiling enabled
+string BenchmarkStream(const cl::Context& context, const cl::CommandQueue& queue, const StreamOptions& options = StreamOptions()) {
+	stringstream sstream;
+	cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+
+	// the three arrays must fit in global memory at the same time; sizes are powers of two
+	size_t limit = (size_t)std::min(device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>(), device.getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>() / 4);
+	if (options.max_bytes) limit = std::min(limit, options.max_bytes);
+	size_t max_bytes = options.min_bytes;
+	while (max_bytes * 4 <= limit) max_bytes *= 4;
+
+	cl::Buffer A(context, CL_MEM_READ_WRITE, max_bytes), B(context, CL_MEM_READ_WRITE, max_bytes), C(context, CL_MEM_READ_WRITE, max_bytes);
+	double best[4] = { 0, 0, 0, 0 };
+
+	sstream << "STREAM benchmark, " << options.repeats << " repeats (best), arrays of " << FormatBytes(options.min_bytes) << " to "
+		<< FormatBytes(max_bytes) << ":" << endl;
+	for (size_t t = 0; t < options.types.size(); t++) {
+		if (options.types[t] == "float") {
+			queue.enqueueFillBuffer(A, 1.f, 0, max_bytes);
+			queue.enqueueFillBuffer(B, 2.f, 0, max_bytes);
+		}
+		else {
+			queue.enqueueFillBuffer(A, (cl_int)1, 0, max_bytes);
+			queue.enqueueFillBuffer(B, (cl_int)2, 0, max_bytes);
+		}
+		for (size_t w = 0; w < options.widths.size(); w++) {
+			if (options.types[t] == "float")
+				sstream << StreamSweep<cl_float>(context, queue, "float", options.widths[w], options, A, B, C, max_bytes, best);
+			else
+				sstream << StreamSweep<cl_int>(context, queue, "int", options.widths[w], options, A, B, C, max_bytes, best);
+		}
+	}
+
+	sstream << "Best:";
+	for (int k = STREAM_COPY; k <= STREAM_TRIAD; k++) {
+		sstream << " " << GetStreamKernelName((StreamKernel)k) << " " << best[k] << " GB/s";
+		if (options.peak > 0) sstream << " (" << (int)(100.0 * best[k] / options.peak + 0.5) << "% of " << options.peak << " GB/s)";
+		sstream << ((k < STREAM_TRIAD) ? "," : "");
+	}
+	sstream << endl;
+
+	return sstream.str();
+}
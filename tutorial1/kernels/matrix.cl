@@ -0,0 +1,123 @@
+//dense single-precision matrix kernels on row-major matrices of any size
+//build options:
+//  -DTS=16   tile size of gemm_tiled: TS x TS blocks of A and B are staged in local memory
+//  -DWPT=4   work per thread of gemm_tiled: each work item keeps WPT elements of a tile column of C in registers
+//  -DTTS=16  tile size of transpose
+//gemm_tiled runs with local size (TS, TS/WPT) and global size (N, M/WPT) rounded up to whole tiles; transpose with
+//local size (TTS, TTS) and global size (cols, rows) rounded up to whole tiles
+
+#ifndef TS
+#define TS 16
+#endif
+#ifndef WPT
+#define WPT 4
+#endif
+#ifndef TTS
+#define TTS 16
+#endif
+
+#define RTS (TS/WPT) //rows of work items in a tile
+
+//C = alpha*A*B + beta*C, with A M x K, B K x N and C M x N; C is not read when beta is 0
+//one element of C per work item, every operand read from global memory
+kernel void gemm_naive(global const float* A, global const float* B, global float* C, const int M, const int N, const int K,
+	const float alpha, const float beta) {
+	int col = get_global_id(0);
+	int row = get_global_id(1);
+	if ((col >= N) || (row >= M)) return;
+
+	float acc = 0.0f;
+	for (int k = 0; k < K; k++)
+		acc += A[row*K + k] * B[k*N + col];
+	C[row*N + col] = (beta == 0.0f) ? alpha*acc : alpha*acc + beta*C[row*N + col];
+}
+
+//as gemm_naive with local-memory blocking: the work group walks along K one TS x TS tile of A and of B at a time,
+//and every element of a tile is loaded from global memory once instead of TS times. Each work item accumulates
+//WPT rows of its column in registers, RTS rows apart, so one value of B read from local memory feeds WPT
+//multiply-adds. Tiles overhanging the matrices are padded with zeros.
+kernel void gemm_tiled(global const float* A, global const float* B, global float* C, const int M, const int N, const int K,
+	const float alpha, const float beta) {
+	local float Asub[TS][TS];
+	local float Bsub[TS][TS];
+
+	int col = get_local_id(0);
+	int row = get_local_id(1);
+	int first_row = get_group_id(1)*TS;
+	int global_col = get_group_id(0)*TS + col;
+
+	float acc[WPT];
+	for (int w = 0; w < WPT; w++)
+		acc[w] = 0.0f;
+
+	for (int t = 0; t < K; t += TS) {
+		//consecutive work items load consecutive elements of a row of A and of B
+		for (int w = 0; w < WPT; w++) {
+			int r = row + w*RTS;
+			Asub[r][col] = ((first_row + r < M) && (t + col < K)) ? A[(first_row + r)*K + t + col] : 0.0f;
+			Bsub[r][col] = ((t + r < K) && (global_col < N)) ? B[(t + r)*N + global_col] : 0.0f;
+		}
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		for (int k = 0; k < TS; k++) {
+			float b = Bsub[k][col];
+			for (int w = 0; w < WPT; w++)
+				acc[w] += Asub[row + w*RTS][k] * b;
+		}
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	if (global_col >= N) return;
+	for (int w = 0; w < WPT; w++) {
+		int global_row = first_row + row + w*RTS;
+		if (global_row < M) {
+			int id = global_row*N + global_col;
+			C[id] = (beta == 0.0f) ? alpha*acc[w] : alpha*acc[w] + beta*C[id];
+		}
+	}
+}
+
+//B = transpose(A), with A rows x cols; the reads are coalesced and the writes scattered
+kernel void transpose_naive(global const float* A, global float* B, const int rows, const int cols) {
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	if ((x < cols) && (y < rows))
+		B[x*rows + y] = A[y*cols + x];
+}
+
+//B = transpose(A) through a TTS x TTS tile in local memory, so that both the reads and the writes are coalesced.
+//The extra column of the tile puts the elements of a tile column in different banks, so reading it back
+//transposed has no bank conflicts.
+kernel void transpose(global const float* A, global float* B, const int rows, const int cols) {
+	local float tile[TTS][TTS + 1];
+
+	int lx = get_local_id(0);
+	int ly = get_local_id(1);
+	int x = get_group_id(0)*TTS + lx;
+	int y = get_group_id(1)*TTS + ly;
+	if ((x < cols) && (y < rows))
+		tile[ly][lx] = A[y*cols + x];
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	x = get_group_id(1)*TTS + lx;
+	y = get_group_id(0)*TTS + ly;
+	if ((x < rows) && (y < cols))
+		B[y*rows + x] = tile[lx][ly];
+}
+
+//C = alpha*A + beta*B, element-wise; add2D from my_kernels.cl with scale factors and any matrix size
+kernel void axpby(global const float* A, global const float* B, global float* C, const int rows, const int cols,
+	const float alpha, const float beta) {
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	if ((x < cols) && (y < rows))
+		C[y*cols + x] = alpha*A[y*cols + x] + beta*B[y*cols + x];
+}
+
+//C = A .* B, element-wise
+kernel void multiply_elements(global const float* A, global const float* B, global float* C, const int rows, const int cols) {
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	if ((x < cols) && (y < rows))
+		C[y*cols + x] = A[y*cols + x] * B[y*cols + x];
+}
@@ -4,10 +4,12 @@ kernel void add(global const int* A, global const int* B, global int* C) {
 	C[id] = A[id] + B[id];
 }
 
-//a simple smoothing kernel averaging values in a local window (radius 1)
+//a simple smoothing kernel averaging values in a local window (radius 1), repeating the end elements at the
+//boundaries; see Stencil.h for any weights, other boundary policies and a version using local memory
 kernel void avg_filter(global const int* A, global int* B) {
 	int id = get_global_id(0);
-	B[id] = (A[id - 1] + A[id] + A[id + 1])/3;
+	int n = get_global_size(0);
+	B[id] = (A[max(id - 1, 0)] + A[id] + A[min(id + 1, n - 1)])/3;
 }
 
 //a simple 2D kernel
@@ -18,7 +20,5 @@ kernel void add2D(global const int* A, global const int* B, global int* C) {
 	int height = get_global_size(1);
 	int id = x + y*width;
 
-	printf("id = %d x = %d y = %d w = %d h = %d\n", id, x, y, width, height);
-
 	C[id]= A[id]+ B[id];
 }
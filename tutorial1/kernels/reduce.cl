@@ -0,0 +1,179 @@
+//parallel reductions: sum, min, max and argmin (smallest value, lowest index on ties) of n elements
+//build options:
+//  -DDATA_T=uchar|ushort|int|float   input type
+//  -DACC_T=int|long|ulong|float      accumulator and partial result type
+//  -DIDENTITY=...                    identity of the operation in ACC_T (0, INT_MAX, -INFINITY, ...)
+//  -DOP_SUM|-DOP_MIN|-DOP_MAX|-DOP_ARGMIN
+//every kernel writes one partial result per work group to B (and its index to B_indices for argmin). The first
+//pass reads the input A; later passes set first_pass to 0 and read the partial results P of the pass before.
+//local sizes must be powers of two.
+
+#ifndef DATA_T
+#define DATA_T int
+#define ACC_T long
+#define IDENTITY 0
+#define OP_SUM
+#endif
+
+//a = combine(a, b), with the indices only for argmin
+#if defined(OP_SUM)
+#define COMBINE(a, a_index, b, b_index) a += b
+#elif defined(OP_MIN)
+#define COMBINE(a, a_index, b, b_index) a = min(a, b)
+#elif defined(OP_MAX)
+#define COMBINE(a, a_index, b, b_index) a = max(a, b)
+#else
+#define COMBINE(a, a_index, b, b_index) if ((b < a) || ((b == a) && (b_index < a_index))) { a = b; a_index = b_index; }
+#endif
+
+void load(global const DATA_T* A, global const ACC_T* P, global const int* P_indices, int first_pass, int i, ACC_T* value, int* index) {
+	*value = first_pass ? (ACC_T)A[i] : P[i];
+#ifdef OP_ARGMIN
+	*index = first_pass ? i : P_indices[i];
+#endif
+}
+
+//combine the values of all work items of the group with a tree in local memory
+void group_reduce(local ACC_T* values, local int* indices, ACC_T* value, int* index) {
+	int lid = get_local_id(0);
+	values[lid] = *value;
+#ifdef OP_ARGMIN
+	indices[lid] = *index;
+#endif
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int stride = get_local_size(0)/2; stride > 0; stride /= 2) {
+		if (lid < stride) {
+			ACC_T a = values[lid];
+			int a_index = 0;
+#ifdef OP_ARGMIN
+			a_index = indices[lid];
+#endif
+			COMBINE(a, a_index, values[lid + stride], indices[lid + stride]);
+			values[lid] = a;
+#ifdef OP_ARGMIN
+			indices[lid] = a_index;
+#endif
+		}
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	*value = values[0];
+#ifdef OP_ARGMIN
+	*index = indices[0];
+#endif
+}
+
+//every global-size-th element from the work item's own, combined in registers
+void accumulate(global const DATA_T* A, global const ACC_T* P, global const int* P_indices, int n, int first_pass, ACC_T* value, int* index) {
+	for (int i = get_global_id(0); i < n; i += get_global_size(0)) {
+		ACC_T b;
+		int b_index = 0;
+		load(A, P, P_indices, first_pass, i, &b, &b_index);
+		COMBINE(*value, *index, b, b_index);
+	}
+}
+
+void store(global ACC_T* B, global int* B_indices, ACC_T value, int index) {
+	if (get_local_id(0) == 0) {
+		B[get_group_id(0)] = value;
+#ifdef OP_ARGMIN
+		B_indices[get_group_id(0)] = index;
+#endif
+	}
+}
+
+//tree: one element per work item, repeated until a single value is left
+//global size: n rounded up to the local size, values/indices: local size elements
+kernel void reduce_tree(global const DATA_T* A, global const ACC_T* P, global const int* P_indices, global ACC_T* B, global int* B_indices,
+	const int n, const int first_pass, local ACC_T* values, local int* indices) {
+	int i = get_global_id(0);
+	ACC_T value = IDENTITY;
+	int index = INT_MAX;
+	if (i < n)
+		load(A, P, P_indices, first_pass, i, &value, &index);
+
+	group_reduce(values, indices, &value, &index);
+	store(B, B_indices, value, index);
+}
+
+//grid-stride: a fixed number of work groups, each work item first accumulates every global-size-th element in
+//registers; a second launch with a single work group finishes the partial results
+kernel void reduce_grid_stride(global const DATA_T* A, global const ACC_T* P, global const int* P_indices, global ACC_T* B, global int* B_indices,
+	const int n, const int first_pass, local ACC_T* values, local int* indices) {
+	ACC_T value = IDENTITY;
+	int index = INT_MAX;
+	accumulate(A, P, P_indices, n, first_pass, &value, &index);
+
+	group_reduce(values, indices, &value, &index);
+	store(B, B_indices, value, index);
+}
+
+//as reduce_grid_stride with built-in collective functions in place of the local-memory tree: the work-group
+//functions of OpenCL C 2.0 where the device has them, otherwise the sub-group functions of cl_khr_subgroups (or
+//cl_intel_subgroups, also found on OpenCL 1.2 drivers) with the sub-group results combined in local memory; not
+//built when the device has neither
+#if (__OPENCL_C_VERSION__ >= 200) && ((__OPENCL_C_VERSION__ < 300) || defined(__opencl_c_work_group_collective_functions))
+kernel void reduce_builtin(global const DATA_T* A, global const ACC_T* P, global const int* P_indices, global ACC_T* B, global int* B_indices,
+	const int n, const int first_pass, local ACC_T* values, local int* indices) {
+	ACC_T value = IDENTITY;
+	int index = INT_MAX;
+	accumulate(A, P, P_indices, n, first_pass, &value, &index);
+
+#if defined(OP_SUM)
+	value = work_group_reduce_add(value);
+#elif defined(OP_MAX)
+	value = work_group_reduce_max(value);
+#else
+	ACC_T minimum = work_group_reduce_min(value);
+#ifdef OP_ARGMIN
+	index = work_group_reduce_min((value == minimum) ? index : INT_MAX);
+#endif
+	value = minimum;
+#endif
+
+	store(B, B_indices, value, index);
+}
+#elif defined(cl_khr_subgroups) || defined(cl_intel_subgroups)
+#ifdef cl_khr_subgroups
+#pragma OPENCL EXTENSION cl_khr_subgroups : enable
+#endif
+kernel void reduce_builtin(global const DATA_T* A, global const ACC_T* P, global const int* P_indices, global ACC_T* B, global int* B_indices,
+	const int n, const int first_pass, local ACC_T* values, local int* indices) {
+	ACC_T value = IDENTITY;
+	int index = INT_MAX;
+	accumulate(A, P, P_indices, n, first_pass, &value, &index);
+
+#if defined(OP_SUM)
+	value = sub_group_reduce_add(value);
+#elif defined(OP_MAX)
+	value = sub_group_reduce_max(value);
+#else
+	ACC_T minimum = sub_group_reduce_min(value);
+#ifdef OP_ARGMIN
+	index = sub_group_reduce_min((value == minimum) ? index : INT_MAX);
+#endif
+	value = minimum;
+#endif
+
+	//one value per sub-group, combined in order by the first work item
+	if (get_sub_group_local_id() == 0) {
+		values[get_sub_group_id()] = value;
+#ifdef OP_ARGMIN
+		indices[get_sub_group_id()] = index;
+#endif
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if (get_local_id(0) == 0) {
+		value = values[0];
+#ifdef OP_ARGMIN
+		index = indices[0];
+#endif
+		for (int s = 1; s < (int)get_num_sub_groups(); s++)
+			COMBINE(value, index, values[s], indices[s]);
+	}
+
+	store(B, B_indices, value, index);
+}
+#endif
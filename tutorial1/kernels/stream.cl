@@ -0,0 +1,34 @@
+//STREAM-style bandwidth kernels: the add kernel from my_kernels.cl and its copy, scale and triad variants,
+//one element per work item
+//build options:
+//  -DDATA_T=int|float|int2|float4|...  element type (a scalar or vector type)
+//  -DSCALAR_T=int|float                type of the scale factor
+
+#ifndef DATA_T
+#define DATA_T int
+#define SCALAR_T int
+#endif
+
+//C = A: 2 arrays of traffic per element
+kernel void stream_copy(global const DATA_T* A, global DATA_T* C) {
+	int id = get_global_id(0);
+	C[id] = A[id];
+}
+
+//C = s*A: 2 arrays
+kernel void stream_scale(global const DATA_T* A, global DATA_T* C, const SCALAR_T s) {
+	int id = get_global_id(0);
+	C[id] = s*A[id];
+}
+
+//C = A + B: 3 arrays
+kernel void stream_add(global const DATA_T* A, global const DATA_T* B, global DATA_T* C) {
+	int id = get_global_id(0);
+	C[id] = A[id] + B[id];
+}
+
+//C = A + s*B: 3 arrays
+kernel void stream_triad(global const DATA_T* A, global const DATA_T* B, global DATA_T* C, const SCALAR_T s) {
+	int id = get_global_id(0);
+	C[id] = A[id] + s*B[id];
+}
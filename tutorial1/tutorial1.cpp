@@ -1,8 +1,9 @@
 //g++ -std=c++0x tutorial1.cpp -o tutorial1 -lOpenCL
-#define CL_HPP_TARGET_OPENCL_VERSION 120
-#define CL_HPP_MINIMUM_OPENCL_VERSION 120
-#include <CL/opencl.hpp>
 #include "Utils.h"
+#include "Stream.h"
+#include "Reduce.h"
+#include "Stencil.h"
+#include "Matrix.h"
 
 #include <iostream>
 #include <vector>
@@ -10,8 +11,19 @@
 void print_help() {
 	std::cerr << "Application usage:" << std::endl;
 	std::cerr << "  -p : select platform " << std::endl;
-	std::cerr << "  -d : select device" << std::endl;
+	std::cerr << "  -d : select device (index on the platform, cpu, gpu, accelerator, fastest or part of a device name)" << std::endl;
 	std::cerr << "  -l : list all platforms and devices" << std::endl;
+	std::cerr << "  -b : run the STREAM bandwidth benchmark (copy, scale, add, triad) and exit" << std::endl;
+	std::cerr << "  -r : run the reduction benchmark (sum, min, max, argmin) on this many elements and exit" << std::endl;
+	std::cerr << "  -f : run the 1D stencil benchmark (tiled vs global memory) and exit" << std::endl;
+	std::cerr << "  -F : stencil weights for -f, normalised to sum to 1 (default: 1,4,6,4,1)" << std::endl;
+	std::cerr << "  -B : stencil boundary policy for -f (clamp, mirror, zero, wrap; default: clamp)" << std::endl;
+	std::cerr << "  -m : run the matrix benchmark (GEMM, transpose, axpby) on square matrices up to this size and exit" << std::endl;
+	std::cerr << "  -G : theoretical single-precision throughput of the device in GFLOP/s, to report -m results as a percentage" << std::endl;
+	std::cerr << "  -t : element type for -b and -r (int, float; default: both)" << std::endl;
+	std::cerr << "  -w : vector width for -b (1, 2, 4, 8, 16; default: all)" << std::endl;
+	std::cerr << "  -s : largest array for -b in MB (default: device limit)" << std::endl;
+	std::cerr << "  -P : theoretical memory bandwidth of the device in GB/s, to report -b and -m results as a percentage" << std::endl;
 	std::cerr << "  -h : print this message" << std::endl;
 }
 
@@ -19,22 +31,66 @@ int main(int argc, char **argv) {
 	//Part 1 - handle command line options such as device selection, verbosity, etc.
 	int platform_id = 0;
 	int device_id = 0;
+	string device_selector = "0";
+	bool benchmark = false;
+	int reduce_elements = 0;
+	bool stencil = false;
+	int matrix_size = 0;
+	double peak_gflops = 0.0;
+	string stencil_weights = "1,4,6,4,1";
+	string stencil_boundary = "clamp";
+	StreamOptions stream_options;
 
 	for (int i = 1; i < argc; i++)	{
 		if ((strcmp(argv[i], "-p") == 0) && (i < (argc - 1))) { platform_id = atoi(argv[++i]); }
-		else if ((strcmp(argv[i], "-d") == 0) && (i < (argc - 1))) { device_id = atoi(argv[++i]); }
+		else if ((strcmp(argv[i], "-d") == 0) && (i < (argc - 1))) { device_selector = argv[++i]; }
 		else if (strcmp(argv[i], "-l") == 0) { std::cout << ListPlatformsDevices() << std::endl; }
+		else if (strcmp(argv[i], "-b") == 0) { benchmark = true; }
+		else if ((strcmp(argv[i], "-r") == 0) && (i < (argc - 1))) { reduce_elements = atoi(argv[++i]); }
+		else if (strcmp(argv[i], "-f") == 0) { stencil = true; }
+		else if ((strcmp(argv[i], "-F") == 0) && (i < (argc - 1))) { stencil_weights = argv[++i]; }
+		else if ((strcmp(argv[i], "-B") == 0) && (i < (argc - 1))) { stencil_boundary = argv[++i]; }
+		else if ((strcmp(argv[i], "-m") == 0) && (i < (argc - 1))) { matrix_size = atoi(argv[++i]); }
+		else if ((strcmp(argv[i], "-G") == 0) && (i < (argc - 1))) { peak_gflops = atof(argv[++i]); }
+		else if ((strcmp(argv[i], "-t") == 0) && (i < (argc - 1))) { stream_options.types.assign(1, argv[++i]); }
+		else if ((strcmp(argv[i], "-w") == 0) && (i < (argc - 1))) { stream_options.widths.assign(1, atoi(argv[++i])); }
+		else if ((strcmp(argv[i], "-s") == 0) && (i < (argc - 1))) { stream_options.max_bytes = (size_t)atoi(argv[++i]) << 20; }
+		else if ((strcmp(argv[i], "-P") == 0) && (i < (argc - 1))) { stream_options.peak = atof(argv[++i]); }
 		else if (strcmp(argv[i], "-h") == 0) { print_help(); return 0; }
 	}
 
+	if ((stream_options.types[0] != "int") && (stream_options.types[0] != "float")) { std::cerr << "Unknown type: " << stream_options.types[0] << std::endl; return 1; }
+	int width = stream_options.widths[0];
+	if ((stream_options.widths.size() == 1) && (width != 1) && (width != 2) && (width != 4) && (width != 8) && (width != 16)) {
+		std::cerr << "Vector width must be 1, 2, 4, 8 or 16" << std::endl;
+		return 1;
+	}
+
+	vector<float> weights;
+	if (!ParseStencilWeights(stencil_weights, weights) || (weights.size() % 2 == 0)) {
+		std::cerr << "Stencil weights must be an odd number of comma separated values" << std::endl;
+		return 1;
+	}
+	float weight_sum = 0;
+	for (size_t k = 0; k < weights.size(); k++) weight_sum += weights[k];
+	if (weight_sum != 0)
+		for (size_t k = 0; k < weights.size(); k++) weights[k] /= weight_sum;
+	StencilBoundary boundary;
+	if (!ParseStencilBoundary(stencil_boundary, boundary)) { std::cerr << "Unknown boundary policy: " << stencil_boundary << std::endl; return 1; }
+
 	//detect any potential exceptions
 	try {
 		//Part 2 - host operations
 		//2.1 Select computing devices
+		if (!SelectDevice(device_selector, platform_id, device_id)) {
+			std::cerr << "Error: no device matches " << device_selector << std::endl;
+			return 1;
+		}
 		cl::Context context = GetContext(platform_id, device_id);
 		std::cout << "Runinng on " << GetPlatformName(platform_id) << ", " << GetDeviceName(platform_id, device_id) << std::endl;
 
-		cl::CommandQueue queue(context);
+		//profiling is enabled for the bandwidth benchmark
+		cl::CommandQueue queue(context, CL_QUEUE_PROFILING_ENABLE);
 
 		cl::Program::Sources sources;
 		AddSources(sources, "kernels/my_kernels.cl");
@@ -52,6 +108,29 @@ int main(int argc, char **argv) {
 			//throw err;
 		}
 
+		if (benchmark) {
+			std::cout << BenchmarkStream(context, queue, stream_options);
+			return 0;
+		}
+
+		if (stencil) {
+			std::cout << BenchmarkStencil(context, queue, weights, boundary);
+			return 0;
+		}
+
+		if (matrix_size > 0) {
+			std::cout << BenchmarkMatrix(context, queue, matrix_size, peak_gflops, stream_options.peak);
+			return 0;
+		}
+
+		if (reduce_elements > 0) {
+			for (size_t t = 0; t < stream_options.types.size(); t++) {
+				if (stream_options.types[t] == "float") std::cout << BenchmarkReduce<cl_float>(context, queue, reduce_elements);
+				else std::cout << BenchmarkReduce<cl_int>(context, queue, reduce_elements);
+			}
+			return 0;
+		}
+
 		//Part 3 - memory allocation
 		//host - input
 		std::vector<int> A = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 }; //C++11 allows this type of initialisation
@@ -89,9 +168,9 @@ int main(int argc, char **argv) {
 		std::cout << "B = " << B << std::endl;
 		std::cout << "C = " << C << std::endl;
 	}
-	//catch (cl::Error err) {
-	catch (...) {
-		//std::cerr << "ERROR: " << err.what() << ", " << getErrorString(err.err()) << std::endl;
+	catch (const cl::Error& err) {
+		std::cerr << "ERROR: " << err.what() << ", " << getErrorString(err.err()) << std::endl;
+		return 1;
 	}
 
 	return 0;
@@ -0,0 +1,234 @@
+#pragma once
+
+// Bilateral (edge-preserving) filter for planar uchar or ushort images (kernels/bilateral.cl), edges clamped.
+//
+// apply() is the direct filter over a +-2 sigma_spatial window read from a local-memory tile. The spatial weights
+// and a range-weight table are uploaded to constant memory whenever the sigmas change, so the kernel does no exp().
+// The table has one entry per intensity for 8-bit data and one per 64 intensities for 16-bit data. apply_grid()
+// is the bilateral grid approximation: its cost hardly depends on sigma_spatial, so it is the one to use for
+// large spatial sigmas. Both take sigma_range in 8-bit units, scaled to the pixel type.
+//
+//   BilateralFilter<unsigned char> bilateral(context);
+//   bilateral.apply(queue, dev_input, dev_output, width, height, channels, 3.f, 25.f);
+
+#include <cmath>
+
+#include "Pixel.h"
+
+template <typename T>
+class BilateralFilter {
+public:
+	BilateralFilter(const cl::Context& context, const string& kernel_file = "kernels/bilateral.cl")
+		: context_(context), sigma_spatial_(0), sigma_range_(0), grid_size_(0) {
+		cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+		stringstream options;
+		options << PixelBuildOptions<T>() << " -DRANGE_SHIFT=" << range_shift();
+		program_ = BuildProgram(context, kernel_file, options.str());
+		bilateral_ = cl::Kernel(program_, "bilateral");
+		splat_ = cl::Kernel(program_, "grid_splat");
+		blur_ = cl::Kernel(program_, "grid_blur");
+		slice_ = cl::Kernel(program_, "grid_slice");
+
+		size_t max_work_group_size = device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+		group_size_ = 16;
+		while (group_size_ > 1 && group_size_ * group_size_ > max_work_group_size) group_size_ /= 2;
+		local_mem_size_ = device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+		max_constant_size_ = device.getInfo<CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE>();
+		dev_range_ = cl::Buffer(context, CL_MEM_READ_ONLY, range_entries() * sizeof(float));
+	}
+
+	static int radius(float sigma_spatial) { return std::max(1, (int)std::ceil(2.f * sigma_spatial)); }
+
+	// true when the tile and the spatial weights for this sigma fit in local and constant memory
+	bool supports_direct(float sigma_spatial) const {
+		size_t tile_width = group_size_ + 2 * radius(sigma_spatial);
+		size_t mask_size = 2 * radius(sigma_spatial) + 1;
+		return (tile_width * tile_width * sizeof(T) <= local_mem_size_) && ((mask_size * mask_size + range_entries()) * sizeof(float) <= max_constant_size_);
+	}
+
+	// Direct bilateral filter; input and output must be different buffers
+	void apply(const cl::CommandQueue& queue, const cl::Buffer& input, const cl::Buffer& output, int width, int height, int channels,
+		float sigma_spatial, float sigma_range, vector<cl::Event>* events = NULL) {
+		if (!supports_direct(sigma_spatial))
+			throw cl::Error(CL_INVALID_VALUE, "BilateralFilter: sigma_spatial too large for the direct filter, use apply_grid()");
+		set_weights(queue, sigma_spatial, sigma_range);
+
+		int r = radius(sigma_spatial);
+		size_t tile_width = group_size_ + 2 * r;
+		bilateral_.setArg(0, input);
+		bilateral_.setArg(1, output);
+		bilateral_.setArg(2, dev_spatial_);
+		bilateral_.setArg(3, dev_range_);
+		bilateral_.setArg(4, width);
+		bilateral_.setArg(5, height);
+		bilateral_.setArg(6, r);
+		bilateral_.setArg(7, cl::Local(tile_width * tile_width * sizeof(T)));
+
+		cl::Event event;
+		queue.enqueueNDRangeKernel(bilateral_, cl::NullRange, cl::NDRange(round_up(width), round_up(height), channels),
+			cl::NDRange(group_size_, group_size_, 1), NULL, &event);
+		if (events) events->push_back(event);
+	}
+
+	// Bilateral grid: splat into cells of sigma_spatial pixels x sigma_range intensities, blur with [1 2 1] along
+	// each axis and slice with trilinear interpolation; input and output must be different buffers
+	void apply_grid(const cl::CommandQueue& queue, const cl::Buffer& input, const cl::Buffer& output, int width, int height, int channels,
+		float sigma_spatial, float sigma_range, vector<cl::Event>* events = NULL) {
+		int spacing = std::max(1, (int)(sigma_spatial + 0.5f));
+		float range_spacing = std::max(sigma_range * PixelTraits<T>::scale(), 1.f);
+		int grid_width = (width - 1) / spacing + 2, grid_height = (height - 1) / spacing + 2;
+		int grid_depth = (int)(PixelTraits<T>::max_value() / range_spacing + 0.5f) + 2;
+
+		size_t grid_size = (size_t)grid_width * grid_height * grid_depth * channels * 2 * sizeof(float);
+		if (grid_size > grid_size_) {
+			grid_[0] = cl::Buffer(context_, CL_MEM_READ_WRITE, grid_size);
+			grid_[1] = cl::Buffer(context_, CL_MEM_READ_WRITE, grid_size);
+			grid_size_ = grid_size;
+		}
+
+		cl::Event event;
+		queue.enqueueFillBuffer(grid_[0], 0.f, 0, grid_size, NULL, &event);
+		if (events) events->push_back(event);
+
+		splat_.setArg(0, input);
+		splat_.setArg(1, grid_[0]);
+		splat_.setArg(2, width);
+		splat_.setArg(3, height);
+		splat_.setArg(4, spacing);
+		splat_.setArg(5, range_spacing);
+		splat_.setArg(6, grid_width);
+		splat_.setArg(7, grid_height);
+		splat_.setArg(8, grid_depth);
+		queue.enqueueNDRangeKernel(splat_, cl::NullRange, cl::NDRange(grid_width, grid_height, channels), cl::NullRange, NULL, &event);
+		if (events) events->push_back(event);
+
+		// x, y and intensity passes, ping-ponging between the two grids
+		for (int axis = 0; axis < 3; axis++) {
+			blur_.setArg(0, grid_[axis % 2]);
+			blur_.setArg(1, grid_[(axis + 1) % 2]);
+			blur_.setArg(2, grid_width);
+			blur_.setArg(3, grid_height);
+			blur_.setArg(4, grid_depth);
+			blur_.setArg(5, axis);
+			queue.enqueueNDRangeKernel(blur_, cl::NullRange, cl::NDRange(grid_width, grid_height, grid_depth * channels), cl::NullRange, NULL, &event);
+			if (events) events->push_back(event);
+		}
+
+		slice_.setArg(0, input);
+		slice_.setArg(1, grid_[1]);
+		slice_.setArg(2, output);
+		slice_.setArg(3, width);
+		slice_.setArg(4, height);
+		slice_.setArg(5, spacing);
+		slice_.setArg(6, range_spacing);
+		slice_.setArg(7, grid_width);
+		slice_.setArg(8, grid_height);
+		slice_.setArg(9, grid_depth);
+		queue.enqueueNDRangeKernel(slice_, cl::NullRange, cl::NDRange(width, height, channels), cl::NullRange, NULL, &event);
+		if (events) events->push_back(event);
+	}
+
+private:
+	cl::Context context_;
+	cl::Program program_;
+	cl::Kernel bilateral_, splat_, blur_, slice_;
+	size_t group_size_, local_mem_size_, max_constant_size_;
+
+	// weights currently held in the constant buffers
+	float sigma_spatial_, sigma_range_;
+	cl::Buffer dev_spatial_, dev_range_;
+
+	// two grids for the blur passes, grown on demand
+	cl::Buffer grid_[2];
+	size_t grid_size_;
+
+	static int range_shift() { return (sizeof(T) == 1) ? 0 : 6; }
+	static size_t range_entries() { return ((size_t)PixelTraits<T>::max_value() >> range_shift()) + 1; }
+
+	size_t round_up(size_t n) const { return (n + group_size_ - 1) / group_size_ * group_size_; }
+
+	// recompute and upload the spatial weights and the range table if a sigma changed; the range entry for a
+	// difference d is taken at the bottom of its bin, d & ~((1 << RANGE_SHIFT) - 1), so equal pixels weigh 1
+	void set_weights(const cl::CommandQueue& queue, float sigma_spatial, float sigma_range) {
+		if (sigma_spatial != sigma_spatial_) {
+			int r = radius(sigma_spatial), mask_size = 2 * r + 1;
+			vector<float> spatial(mask_size * mask_size);
+			for (int j = 0; j < mask_size; j++)
+				for (int i = 0; i < mask_size; i++)
+					spatial[i + j * mask_size] = std::exp(-((i - r) * (i - r) + (j - r) * (j - r)) / (2.f * sigma_spatial * sigma_spatial));
+			dev_spatial_ = cl::Buffer(context_, CL_MEM_READ_ONLY, spatial.size() * sizeof(float));
+			queue.enqueueWriteBuffer(dev_spatial_, CL_TRUE, 0, spatial.size() * sizeof(float), &spatial[0]);
+			sigma_spatial_ = sigma_spatial;
+		}
+
+		if (sigma_range != sigma_range_) {
+			float sigma = sigma_range * PixelTraits<T>::scale();
+			vector<float> range(range_entries());
+			for (size_t i = 0; i < range.size(); i++) {
+				float d = (float)(i << range_shift());
+				range[i] = std::exp(-d * d / (2.f * sigma * sigma));
+			}
+			queue.enqueueWriteBuffer(dev_range_, CL_TRUE, 0, range.size() * sizeof(float), &range[0]);
+			sigma_range_ = sigma_range;
+		}
+	}
+};
+
+// Direct filter against the bilateral grid over a sweep of spatial and range sigmas; the difference is the mean
+// absolute difference between the two results in 8-bit units. The queue must have profiling enabled.
+template <typename T>
+string BenchmarkBilateral(const cl::Context& context, const cl::CommandQueue& queue, const CImg<T>& image, int repeats = 3) {
+	const float sigmas_spatial[] = { 1.f, 2.f, 4.f, 8.f, 16.f };
+	const float sigmas_range[] = { 10.f, 30.f, 100.f };
+	stringstream sstream;
+	BilateralFilter<T> bilateral(context);
+	size_t image_bytes = image.size() * sizeof(T);
+	int width = image.width(), height = image.height(), channels = image.spectrum();
+	cl::Buffer dev_input(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, image_bytes, (void*)image.data());
+	cl::Buffer dev_output(context, CL_MEM_READ_WRITE, image_bytes);
+	CImg<T> direct(width, height, 1, channels), grid(width, height, 1, channels);
+
+	sstream << "Bilateral benchmark, " << width << "x" << height << "x" << channels << " " << PixelTraits<T>::name() << ", "
+		<< repeats << " repeats:" << endl;
+	for (int s = 0; s < 5; s++)
+		for (int r = 0; r < 3; r++) {
+			float sigma_spatial = sigmas_spatial[s], sigma_range = sigmas_range[r];
+			sstream << "   sigma_spatial " << sigma_spatial << ", sigma_range " << sigma_range << ":";
+
+			double direct_time = 0, grid_time = 0;
+			bool has_direct = bilateral.supports_direct(sigma_spatial);
+			if (has_direct) {
+				for (int i = 0; i <= repeats; i++) { // the first run is a warm up
+					vector<cl::Event> events;
+					bilateral.apply(queue, dev_input, dev_output, width, height, channels, sigma_spatial, sigma_range, &events);
+					double time = GetExecutionTime(events);
+					if (i > 0) direct_time += time / repeats;
+				}
+				queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, image_bytes, direct.data());
+				sstream << " direct (" << 2 * BilateralFilter<T>::radius(sigma_spatial) + 1 << "x"
+					<< 2 * BilateralFilter<T>::radius(sigma_spatial) + 1 << ") " << direct_time << " [ms],";
+			}
+			else {
+				sstream << " direct (too large),";
+			}
+
+			for (int i = 0; i <= repeats; i++) {
+				vector<cl::Event> events;
+				bilateral.apply_grid(queue, dev_input, dev_output, width, height, channels, sigma_spatial, sigma_range, &events);
+				double time = GetExecutionTime(events);
+				if (i > 0) grid_time += time / repeats;
+			}
+			queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, image_bytes, grid.data());
+			sstream << " grid " << grid_time << " [ms]";
+
+			if (has_direct) {
+				double difference = 0;
+				for (size_t i = 0; i < image.size(); i++)
+					difference += std::fabs((double)direct[i] - (double)grid[i]);
+				sstream << " (" << direct_time / grid_time << "x, difference " << difference / image.size() / PixelTraits<T>::scale() << ")";
+			}
+			sstream << endl;
+		}
+
+	return sstream.str();
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+// Box (mean) filter of any radius for planar uchar or ushort images, through a summed-area table (kernels/sat.cl).
+//
+// The table is built with a row scan and a column scan, after which every output pixel costs four reads no
+// matter how large the box is. The accumulator is 32-bit when the largest possible channel sum fits and
+// 64-bit otherwise; the two variants are built on first use.
+//
+//   BoxFilter<unsigned char> box(context);
+//   box.apply(queue, dev_input, dev_output, width, height, channels, 15, 15);
+
+#include <climits>
+
+#include "Convolution.h"
+
+template <typename T>
+class BoxFilter {
+public:
+	BoxFilter(const cl::Context& context, const string& kernel_file = "kernels/sat.cl")
+		: context_(context), kernel_file_(kernel_file), sat_size_(0) {
+		cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+		size_t max_work_group_size = device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+		group_size_ = 1;
+		while (group_size_ * 2 <= std::min(max_work_group_size, (size_t)256)) group_size_ *= 2;
+	}
+
+	// Mean over a (2*radius_x + 1) x (2*radius_y + 1) box, cut to the image at the edges
+	void apply(const cl::CommandQueue& queue, const cl::Buffer& input, const cl::Buffer& output, int width, int height, int channels,
+		int radius_x, int radius_y, vector<cl::Event>* events = NULL) {
+		bool wide = wide_sums(width, height);
+		Kernels& kernels = get_kernels(wide);
+		size_t sat_size = (size_t)width * height * channels * (wide ? sizeof(cl_ulong) : sizeof(cl_uint));
+		if (sat_size > sat_size_) {
+			sat_ = cl::Buffer(context_, CL_MEM_READ_WRITE, sat_size);
+			sat_size_ = sat_size;
+		}
+
+		cl::Event event;
+		kernels.rows.setArg(0, input);
+		kernels.rows.setArg(1, sat_);
+		kernels.rows.setArg(2, width);
+		kernels.rows.setArg(3, height);
+		kernels.rows.setArg(4, cl::Local(group_size_ * (wide ? sizeof(cl_ulong) : sizeof(cl_uint))));
+		queue.enqueueNDRangeKernel(kernels.rows, cl::NullRange, cl::NDRange(group_size_, height, channels),
+			cl::NDRange(group_size_, 1, 1), NULL, &event);
+		if (events) events->push_back(event);
+
+		kernels.columns.setArg(0, sat_);
+		kernels.columns.setArg(1, width);
+		kernels.columns.setArg(2, height);
+		queue.enqueueNDRangeKernel(kernels.columns, cl::NullRange, cl::NDRange(width, channels), cl::NullRange, NULL, &event);
+		if (events) events->push_back(event);
+
+		kernels.box.setArg(0, sat_);
+		kernels.box.setArg(1, output);
+		kernels.box.setArg(2, width);
+		kernels.box.setArg(3, height);
+		kernels.box.setArg(4, radius_x);
+		kernels.box.setArg(5, radius_y);
+		queue.enqueueNDRangeKernel(kernels.box, cl::NullRange, cl::NDRange(width, height, channels), cl::NullRange, NULL, &event);
+		if (events) events->push_back(event);
+	}
+
+	// true when a channel sum can exceed 32 bits
+	static bool wide_sums(int width, int height) {
+		return (double)width * height * PixelTraits<T>::max_value() > (double)UINT_MAX;
+	}
+
+private:
+	struct Kernels {
+		Kernels() : built(false) {}
+		bool built;
+		cl::Program program;
+		cl::Kernel rows, columns, box;
+	};
+
+	cl::Context context_;
+	string kernel_file_;
+	size_t group_size_;
+	Kernels kernels_[2]; // 32-bit and 64-bit accumulators
+	cl::Buffer sat_;
+	size_t sat_size_;
+
+	Kernels& get_kernels(bool wide) {
+		Kernels& kernels = kernels_[wide ? 1 : 0];
+		if (!kernels.built) {
+			kernels.program = BuildProgram(context_, kernel_file_, PixelBuildOptions<T>() + (wide ? " -DSUM_T=ulong" : " -DSUM_T=uint"));
+			kernels.rows = cl::Kernel(kernels.program, "sat_rows");
+			kernels.columns = cl::Kernel(kernels.program, "sat_columns");
+			kernels.box = cl::Kernel(kernels.program, "box_filter");
+			kernels.built = true;
+		}
+		return kernels;
+	}
+};
+
+// SAT box filter against the separable convolution engine with an averaging mask of the same size, for radii
+// 1 to 64; the queue must have profiling enabled. The two differ at the edges (cut box against clamped pixels), so
+// their outputs are compared over the pixels at least radius away from every edge.
+template <typename T>
+string BenchmarkBoxFilter(const cl::Context& context, const cl::CommandQueue& queue, const CImg<T>& image, int repeats = 5) {
+	stringstream sstream;
+	BoxFilter<T> box(context);
+	Convolution<T> convolution(context);
+	size_t image_bytes = image.size() * sizeof(T);
+	int width = image.width(), height = image.height(), channels = image.spectrum();
+	cl::Buffer dev_input(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, image_bytes, (void*)image.data());
+	cl::Buffer dev_output(context, CL_MEM_READ_WRITE, image_bytes);
+	vector<T> sat_result(image.size()), convolution_result(image.size());
+
+	sstream << "Box filter benchmark, " << width << "x" << height << "x" << channels << " " << PixelTraits<T>::name() << ", "
+		<< (BoxFilter<T>::wide_sums(width, height) ? "64" : "32") << "-bit sums, " << repeats << " repeats:" << endl;
+	sstream << "   radius   SAT [ms]   separable convolution [ms]   max interior diff" << endl;
+
+	for (int radius = 1; radius <= 64; radius *= 2) {
+		vector<float> row(2 * radius + 1, 1.f / (2 * radius + 1));
+		double sat_time = 0, convolution_time = 0;
+		for (int i = 0; i <= repeats; i++) { // the first run is a warm up
+			vector<cl::Event> events;
+			box.apply(queue, dev_input, dev_output, width, height, channels, radius, radius, &events);
+			double time = GetExecutionTime(events);
+			if (i > 0) sat_time += time / repeats;
+			if (i == repeats) queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, image_bytes, &sat_result[0]);
+
+			events.clear();
+			convolution.apply_separable(queue, dev_input, dev_output, width, height, channels, row, row, BORDER_CLAMP, &events);
+			time = GetExecutionTime(events);
+			if (i > 0) convolution_time += time / repeats;
+		}
+		queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, image_bytes, &convolution_result[0]);
+
+		double max_diff = 0;
+		for (int c = 0; c < channels; c++)
+			for (int y = radius; y < height - radius; y++)
+				for (int x = radius; x < width - radius; x++) {
+					size_t i = x + (size_t)width * (y + (size_t)height * c);
+					max_diff = std::max(max_diff, std::fabs((double)sat_result[i] - (double)convolution_result[i]));
+				}
+		sstream << "   " << radius << "   " << sat_time << "   " << convolution_time << "   " << max_diff << endl;
+	}
+
+	return sstream.str();
+}
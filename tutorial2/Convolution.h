@@ -0,0 +1,315 @@
+#pragma once
+
+// K x K convolution engine for planar images of uchar, ushort or float pixels (kernels/convolution.cl).
+//
+// apply_2d() runs the tiled kernel: each work group stages its input tile plus a halo of mask_size/2 pixels in
+// local memory, so every input pixel is read from global memory about once instead of K*K times. The mask
+// is kept in constant memory. Masks whose tile does not fit in local memory fall back to the naive kernel.
+// apply() first checks whether the mask is rank 1 (an outer product of a column and a row vector, as for box
+// and Gaussian blurs) and if so runs a horizontal and a vertical pass instead, 2K taps per pixel instead of K*K.
+//
+//   Convolution<unsigned char> convolution(context);
+//   convolution.apply(queue, dev_input, dev_output, width, height, channels, MakeMask(MASK_GAUSSIAN, 7), BORDER_MIRROR);
+
+#include <algorithm>
+#include <cmath>
+
+#include "Pixel.h"
+
+enum BorderMode {
+	BORDER_CLAMP = 0,
+	BORDER_MIRROR = 1,
+	BORDER_ZERO = 2
+};
+
+bool ParseBorderMode(const string& name, BorderMode& mode) {
+	if (name == "clamp") mode = BORDER_CLAMP;
+	else if (name == "mirror") mode = BORDER_MIRROR;
+	else if (name == "zero") mode = BORDER_ZERO;
+	else return false;
+	return true;
+}
+
+const char* GetBorderModeName(BorderMode mode) {
+	switch (mode) {
+	case BORDER_CLAMP: return "clamp";
+	case BORDER_MIRROR: return "mirror";
+	case BORDER_ZERO: return "zero";
+	default: return "unknown";
+	}
+}
+
+enum MaskType {
+	MASK_AVERAGE,
+	MASK_GAUSSIAN,
+	MASK_SHARPEN
+};
+
+bool ParseMaskType(const string& name, MaskType& type) {
+	if (name == "avg") type = MASK_AVERAGE;
+	else if (name == "gauss") type = MASK_GAUSSIAN;
+	else if (name == "sharpen") type = MASK_SHARPEN;
+	else return false;
+	return true;
+}
+
+// Normalised mask_size x mask_size mask, row-major. The sharpening mask (2 x identity - average) is not separable.
+vector<float> MakeMask(MaskType type, int mask_size) {
+	vector<float> mask(mask_size * mask_size, 1.f / (mask_size * mask_size));
+	int radius = mask_size / 2;
+
+	if (type == MASK_GAUSSIAN) {
+		// sigma chosen so that the mask covers about +-3 sigma
+		float sigma = 0.3f * (radius - 1) + 0.8f;
+		float sum = 0.f;
+		for (int j = 0; j < mask_size; j++)
+			for (int i = 0; i < mask_size; i++)
+				sum += mask[i + j * mask_size] = std::exp(-((i - radius) * (i - radius) + (j - radius) * (j - radius)) / (2.f * sigma * sigma));
+		for (size_t i = 0; i < mask.size(); i++)
+			mask[i] /= sum;
+	}
+	else if (type == MASK_SHARPEN) {
+		for (size_t i = 0; i < mask.size(); i++)
+			mask[i] = -mask[i];
+		mask[radius + radius * mask_size] += 2.f;
+	}
+
+	return mask;
+}
+
+// Rank-1 test: split a K x K mask into column * row (mask[i + j*K] = column[j] * row[i]) if every element is
+// reproduced to within tolerance relative to the largest one. The largest element is used as the pivot, which
+// keeps the division well conditioned.
+bool SeparateMask(const vector<float>& mask, vector<float>& column, vector<float>& row, float tolerance = 1e-5f) {
+	int mask_size = (int)(std::sqrt((double)mask.size()) + 0.5);
+	if (mask_size * mask_size != (int)mask.size())
+		return false;
+
+	size_t pivot = 0;
+	for (size_t i = 1; i < mask.size(); i++)
+		if (std::fabs(mask[i]) > std::fabs(mask[pivot])) pivot = i;
+	float pivot_value = mask[pivot];
+	int pivot_x = (int)(pivot % mask_size), pivot_y = (int)(pivot / mask_size);
+
+	column.assign(mask_size, 0.f);
+	row.assign(mask_size, 0.f);
+	if (pivot_value == 0.f)
+		return true; // all-zero mask
+
+	for (int j = 0; j < mask_size; j++)
+		column[j] = mask[pivot_x + j * mask_size];
+	for (int i = 0; i < mask_size; i++)
+		row[i] = mask[i + pivot_y * mask_size] / pivot_value;
+
+	for (int j = 0; j < mask_size; j++)
+		for (int i = 0; i < mask_size; i++)
+			if (std::fabs(mask[i + j * mask_size] - column[j] * row[i]) > tolerance * std::fabs(pivot_value))
+				return false;
+	return true;
+}
+
+template <typename T>
+class Convolution {
+public:
+	Convolution(const cl::Context& context, const string& kernel_file = "kernels/convolution.cl") : context_(context), temp_size_(0) {
+		cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+		program_ = BuildProgram(context, kernel_file, PixelBuildOptions<T>());
+		kernel_ = cl::Kernel(program_, "convolution2D");
+		naive_kernel_ = cl::Kernel(program_, "convolution2D_naive");
+		rows_kernel_ = cl::Kernel(program_, "convolution_rows");
+		columns_kernel_ = cl::Kernel(program_, "convolution_columns");
+
+		// square work groups of 16x16 where supported
+		size_t max_work_group_size = std::min((size_t)device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>(),
+			kernel_.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device));
+		max_work_group_size = std::min(max_work_group_size, rows_kernel_.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device));
+		max_work_group_size = std::min(max_work_group_size, columns_kernel_.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device));
+		group_size_ = 16;
+		while (group_size_ > 1 && group_size_ * group_size_ > max_work_group_size) group_size_ /= 2;
+
+		local_mem_size_ = device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+		max_constant_size_ = device.getInfo<CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE>();
+	}
+
+	// Convolve a planar width x height x channels image, with the separable path when the mask is rank 1.
+	// Input and output must be different buffers. The events of the launched kernels are appended to events.
+	void apply(const cl::CommandQueue& queue, const cl::Buffer& input, const cl::Buffer& output, int width, int height, int channels,
+		const vector<float>& mask, BorderMode border, vector<cl::Event>* events = NULL) {
+		vector<float> column, row;
+		if (SeparateMask(mask, column, row) && tiled_separable((int)row.size()))
+			apply_separable(queue, input, output, width, height, channels, row, column, border, events);
+		else
+			apply_2d(queue, input, output, width, height, channels, mask, border, events);
+	}
+
+	// Tiled 2D kernel, or the naive kernel if the tile does not fit in local memory
+	void apply_2d(const cl::CommandQueue& queue, const cl::Buffer& input, const cl::Buffer& output, int width, int height, int channels,
+		const vector<float>& mask, BorderMode border, vector<cl::Event>* events = NULL) {
+		int mask_size = set_mask(queue, mask_, dev_mask_, mask, true);
+		if (!tiled(mask_size)) {
+			apply_naive(queue, input, output, width, height, channels, mask, border, events);
+			return;
+		}
+
+		int radius = mask_size / 2;
+		size_t tile_width = group_size_ + 2 * radius;
+		kernel_.setArg(0, input);
+		kernel_.setArg(1, output);
+		kernel_.setArg(2, dev_mask_);
+		kernel_.setArg(3, width);
+		kernel_.setArg(4, height);
+		kernel_.setArg(5, radius);
+		kernel_.setArg(6, (int)border);
+		kernel_.setArg(7, cl::Local(tile_width * tile_width * sizeof(float)));
+		launch(queue, kernel_, width, height, channels, events);
+	}
+
+	// Horizontal pass with row followed by a vertical pass with column, through a float intermediate image
+	void apply_separable(const cl::CommandQueue& queue, const cl::Buffer& input, const cl::Buffer& output, int width, int height, int channels,
+		const vector<float>& row, const vector<float>& column, BorderMode border, vector<cl::Event>* events = NULL) {
+		int mask_size = set_mask(queue, row_mask_, dev_row_mask_, row, false);
+		if (set_mask(queue, column_mask_, dev_column_mask_, column, false) != mask_size)
+			throw cl::Error(CL_INVALID_VALUE, "Convolution: row and column masks differ in size");
+
+		size_t temp_size = (size_t)width * height * channels * sizeof(float);
+		if (temp_size > temp_size_) {
+			temp_ = cl::Buffer(context_, CL_MEM_READ_WRITE, temp_size);
+			temp_size_ = temp_size;
+		}
+
+		int radius = mask_size / 2;
+		rows_kernel_.setArg(0, input);
+		rows_kernel_.setArg(1, temp_);
+		rows_kernel_.setArg(2, dev_row_mask_);
+		rows_kernel_.setArg(3, width);
+		rows_kernel_.setArg(4, height);
+		rows_kernel_.setArg(5, radius);
+		rows_kernel_.setArg(6, (int)border);
+		rows_kernel_.setArg(7, cl::Local((group_size_ + 2 * radius) * group_size_ * sizeof(float)));
+		launch(queue, rows_kernel_, width, height, channels, events);
+
+		columns_kernel_.setArg(0, temp_);
+		columns_kernel_.setArg(1, output);
+		columns_kernel_.setArg(2, dev_column_mask_);
+		columns_kernel_.setArg(3, width);
+		columns_kernel_.setArg(4, height);
+		columns_kernel_.setArg(5, radius);
+		columns_kernel_.setArg(6, (int)border);
+		columns_kernel_.setArg(7, cl::Local((group_size_ + 2 * radius) * group_size_ * sizeof(float)));
+		launch(queue, columns_kernel_, width, height, channels, events);
+	}
+
+	// Reference version reading all K*K neighbours from global memory
+	void apply_naive(const cl::CommandQueue& queue, const cl::Buffer& input, const cl::Buffer& output, int width, int height, int channels,
+		const vector<float>& mask, BorderMode border, vector<cl::Event>* events = NULL) {
+		int mask_size = set_mask(queue, mask_, dev_mask_, mask, true);
+		naive_kernel_.setArg(0, input);
+		naive_kernel_.setArg(1, output);
+		naive_kernel_.setArg(2, dev_mask_);
+		naive_kernel_.setArg(3, width);
+		naive_kernel_.setArg(4, height);
+		naive_kernel_.setArg(5, mask_size / 2);
+		naive_kernel_.setArg(6, (int)border);
+		cl::Event event;
+		queue.enqueueNDRangeKernel(naive_kernel_, cl::NullRange, cl::NDRange(width, height, channels), cl::NullRange, NULL, &event);
+		if (events) events->push_back(event);
+	}
+
+	// true when the input tile for this mask size fits in local memory
+	bool tiled(int mask_size) const {
+		size_t tile_width = group_size_ + 2 * (mask_size / 2);
+		return tile_width * tile_width * sizeof(float) <= local_mem_size_;
+	}
+
+	bool tiled_separable(int mask_size) const {
+		return (group_size_ + 2 * (mask_size / 2)) * group_size_ * sizeof(float) <= local_mem_size_;
+	}
+
+	size_t group_size() const { return group_size_; }
+
+private:
+	cl::Context context_;
+	cl::Program program_;
+	cl::Kernel kernel_, naive_kernel_, rows_kernel_, columns_kernel_;
+	size_t group_size_;
+	size_t local_mem_size_, max_constant_size_;
+
+	// masks currently held in the device buffers
+	vector<float> mask_, row_mask_, column_mask_;
+	cl::Buffer dev_mask_, dev_row_mask_, dev_column_mask_;
+
+	// float intermediate image between the separable passes, grown on demand
+	cl::Buffer temp_;
+	size_t temp_size_;
+
+	size_t round_up(size_t n) const { return (n + group_size_ - 1) / group_size_ * group_size_; }
+
+	void launch(const cl::CommandQueue& queue, const cl::Kernel& kernel, int width, int height, int channels, vector<cl::Event>* events) {
+		cl::Event event;
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(round_up(width), round_up(height), channels),
+			cl::NDRange(group_size_, group_size_, 1), NULL, &event);
+		if (events) events->push_back(event);
+	}
+
+	// upload a K x K (square) or 1 x K mask if it changed and return K
+	int set_mask(const cl::CommandQueue& queue, vector<float>& current, cl::Buffer& buffer, const vector<float>& mask, bool square) {
+		int mask_size = square ? (int)(std::sqrt((double)mask.size()) + 0.5) : (int)mask.size();
+		if ((square && mask_size * mask_size != (int)mask.size()) || mask_size % 2 == 0)
+			throw cl::Error(CL_INVALID_VALUE, "Convolution: the mask must be K x K with K odd");
+		if (mask.size() * sizeof(float) > max_constant_size_)
+			throw cl::Error(CL_INVALID_BUFFER_SIZE, "Convolution: the mask does not fit in constant memory");
+
+		if (mask != current) {
+			if (mask.size() != current.size())
+				buffer = cl::Buffer(context_, CL_MEM_READ_ONLY, mask.size() * sizeof(float));
+			queue.enqueueWriteBuffer(buffer, CL_TRUE, 0, mask.size() * sizeof(float), &mask[0]);
+			current = mask;
+		}
+		return mask_size;
+	}
+};
+
+// Naive, tiled 2D and separable kernels for Gaussian masks of size 3 to 31 on the given image
+template <typename T>
+string BenchmarkConvolution(const cl::Context& context, const cl::CommandQueue& queue, const CImg<T>& image, BorderMode border, int repeats = 5) {
+	stringstream sstream;
+	Convolution<T> convolution(context);
+	size_t image_bytes = image.size() * sizeof(T);
+	cl::Buffer dev_input(context, CL_MEM_READ_ONLY, image_bytes);
+	cl::Buffer dev_output(context, CL_MEM_READ_WRITE, image_bytes);
+	queue.enqueueWriteBuffer(dev_input, CL_TRUE, 0, image_bytes, image.data());
+	vector<T> reference(image.size()), result(image.size());
+	size_t g = convolution.group_size();
+	int width = image.width(), height = image.height(), channels = image.spectrum();
+
+	sstream << "Convolution benchmark, " << width << "x" << height << "x" << channels << " " << PixelTraits<T>::name()
+		<< ", " << GetBorderModeName(border) << " border, " << g << "x" << g << " work groups, " << repeats << " repeats:" << endl;
+	sstream << "   mask   naive [ms]   tiled 2D [ms]   separable [ms]   global reads/pixel (naive, tiled)   max diff (tiled, separable)" << endl;
+
+	for (int mask_size = 3; mask_size <= 31; mask_size += 2) {
+		vector<float> mask = MakeMask(MASK_GAUSSIAN, mask_size), column, row;
+		SeparateMask(mask, column, row);
+		double times[3] = { 0, 0, 0 }, max_diff[3] = { 0, 0, 0 };
+
+		for (int path = 0; path < 3; path++) {
+			for (int i = 0; i <= repeats; i++) { // the first run is a warm up
+				vector<cl::Event> events;
+				if (path == 0) convolution.apply_naive(queue, dev_input, dev_output, width, height, channels, mask, border, &events);
+				else if (path == 1) convolution.apply_2d(queue, dev_input, dev_output, width, height, channels, mask, border, &events);
+				else convolution.apply_separable(queue, dev_input, dev_output, width, height, channels, row, column, border, &events);
+				double time = GetExecutionTime(events);
+				if (i > 0) times[path] += time / repeats;
+			}
+			queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, image_bytes, path ? &result[0] : &reference[0]);
+			for (size_t i = 0; path && i < image.size(); i++)
+				max_diff[path] = std::max(max_diff[path], std::fabs((double)reference[i] - (double)result[i]));
+		}
+
+		size_t tile_width = g + 2 * (mask_size / 2);
+		sstream << "   " << mask_size << "x" << mask_size << "   " << times[0] << "   " << times[1] << "   " << times[2] << "   "
+			<< mask_size * mask_size << ", " << (convolution.tiled(mask_size) ? (double)(tile_width * tile_width) / (g * g) : (double)(mask_size * mask_size))
+			<< "   " << max_diff[1] << ", " << max_diff[2] << endl;
+	}
+
+	return sstream.str();
+}
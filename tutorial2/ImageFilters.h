@@ -0,0 +1,181 @@
+#pragma once
+
+// image2d_t storage for the identityND, avg_filterND and convolutionND filters (kernels/image_kernels.cl).
+//
+// Every colour channel of a planar image becomes its own CL_R / CL_UNORM_INT8 image, and the kernels read it
+// through a sampler so that edges are handled by the texture hardware (or the driver on CPU devices) instead of
+// index checks. Border modes map onto addressing modes: clamp -> CLAMP_TO_EDGE, zero -> CLAMP (border colour
+// 0), mirror -> MIRRORED_REPEAT. The hardware mirror repeats the edge pixel (ba|abcd|dc), unlike the buffer
+// kernels in convolution.cl (cb|abcd|cb).
+//
+// CL_R / CL_UNORM_INT8 is not among the formats every OpenCL 1.2 device must support, so supported() is
+// checked before use and the constructor throws CL_IMAGE_FORMAT_NOT_SUPPORTED without it.
+//
+//   ImageFilters filters(context);
+//   vector<cl::Image2D> input = filters.upload(image), output = filters.create(width, height, channels);
+//   filters.run(queue, "avg_filter_image", input, output, BORDER_CLAMP);
+//   filters.download(queue, output, image);
+
+#include <map>
+
+#include "Convolution.h"
+
+enum StorageMode {
+	STORAGE_BUFFER,
+	STORAGE_IMAGE
+};
+
+bool ParseStorageMode(const string& name, StorageMode& mode) {
+	if (name == "buffer") mode = STORAGE_BUFFER;
+	else if (name == "image") mode = STORAGE_IMAGE;
+	else return false;
+	return true;
+}
+
+class ImageFilters {
+public:
+	ImageFilters(const cl::Context& context, const string& kernel_file = "kernels/image_kernels.cl") : context_(context) {
+		cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+		if (!device.getInfo<CL_DEVICE_IMAGE_SUPPORT>())
+			throw cl::Error(CL_INVALID_OPERATION, "ImageFilters: the device does not support images");
+		if (!supported(context))
+			throw cl::Error(CL_IMAGE_FORMAT_NOT_SUPPORTED, "ImageFilters: the device does not support CL_R / CL_UNORM_INT8 2D images");
+		program_ = BuildProgram(context, kernel_file);
+	}
+
+	// True when the device has images and can both read and write single-channel 8-bit normalised 2D images
+	static bool supported(const cl::Context& context) {
+		cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+		if (!device.getInfo<CL_DEVICE_IMAGE_SUPPORT>())
+			return false;
+		cl_mem_flags flags[] = { CL_MEM_READ_ONLY, CL_MEM_WRITE_ONLY };
+		for (int f = 0; f < 2; f++) {
+			vector<cl::ImageFormat> formats;
+			context.getSupportedImageFormats(flags[f], CL_MEM_OBJECT_IMAGE2D, &formats);
+			bool found = false;
+			for (size_t i = 0; i < formats.size(); i++)
+				found |= (formats[i].image_channel_order == CL_R) && (formats[i].image_channel_data_type == CL_UNORM_INT8);
+			if (!found)
+				return false;
+		}
+		return true;
+	}
+
+	// One single-channel image per channel of a planar 8-bit image, initialised from it
+	vector<cl::Image2D> upload(const CImg<unsigned char>& image, cl_mem_flags flags = CL_MEM_READ_ONLY) {
+		vector<cl::Image2D> images;
+		for (int c = 0; c < image.spectrum(); c++)
+			images.push_back(cl::Image2D(context_, flags | CL_MEM_COPY_HOST_PTR, cl::ImageFormat(CL_R, CL_UNORM_INT8),
+				image.width(), image.height(), 0, (void*)image.data(0, 0, 0, c)));
+		return images;
+	}
+
+	vector<cl::Image2D> create(int width, int height, int channels, cl_mem_flags flags = CL_MEM_WRITE_ONLY) {
+		vector<cl::Image2D> images;
+		for (int c = 0; c < channels; c++)
+			images.push_back(cl::Image2D(context_, flags, cl::ImageFormat(CL_R, CL_UNORM_INT8), width, height));
+		return images;
+	}
+
+	// Read the channel images back into a planar 8-bit image of matching size
+	void download(const cl::CommandQueue& queue, const vector<cl::Image2D>& images, CImg<unsigned char>& image) {
+		cl::array<cl::size_type, 3> origin = { 0, 0, 0 };
+		cl::array<cl::size_type, 3> region = { (cl::size_type)image.width(), (cl::size_type)image.height(), 1 };
+		for (size_t c = 0; c < images.size(); c++)
+			queue.enqueueReadImage(images[c], CL_TRUE, origin, region, 0, 0, image.data(0, 0, 0, (int)c));
+	}
+
+	// Run identity_image, avg_filter_image or convolution_image (which takes a 3x3 mask) over every channel
+	void run(const cl::CommandQueue& queue, const string& kernel_name, const vector<cl::Image2D>& input, const vector<cl::Image2D>& output,
+		BorderMode border, const cl::Buffer* mask = NULL, vector<cl::Event>* events = NULL) {
+		cl::Kernel& kernel = get_kernel(kernel_name);
+		for (size_t c = 0; c < input.size(); c++) {
+			kernel.setArg(0, input[c]);
+			kernel.setArg(1, output[c]);
+			kernel.setArg(2, get_sampler(border));
+			if (mask) kernel.setArg(3, *mask);
+
+			cl::Event event;
+			queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(input[c].getImageInfo<CL_IMAGE_WIDTH>(),
+				input[c].getImageInfo<CL_IMAGE_HEIGHT>()), cl::NullRange, NULL, &event);
+			if (events) events->push_back(event);
+		}
+	}
+
+private:
+	cl::Context context_;
+	cl::Program program_;
+	std::map<string, cl::Kernel> kernels_;
+	std::map<int, cl::Sampler> samplers_;
+
+	cl::Kernel& get_kernel(const string& name) {
+		if (kernels_.find(name) == kernels_.end())
+			kernels_[name] = cl::Kernel(program_, name.c_str());
+		return kernels_[name];
+	}
+
+	const cl::Sampler& get_sampler(BorderMode border) {
+		if (samplers_.find(border) == samplers_.end()) {
+			cl_addressing_mode addressing = (border == BORDER_ZERO) ? CL_ADDRESS_CLAMP :
+				(border == BORDER_MIRROR) ? CL_ADDRESS_MIRRORED_REPEAT : CL_ADDRESS_CLAMP_TO_EDGE;
+			samplers_[border] = cl::Sampler(context_, CL_TRUE, addressing, CL_FILTER_NEAREST);
+		}
+		return samplers_[border];
+	}
+};
+
+// Buffer against image storage for each filter; buffer_program is the build of my_kernels.cl and the queue must
+// have profiling enabled. Only kernel time is counted, one launch over all channels against one per channel.
+// The buffer kernels copy the edge pixels unfiltered whatever the border mode, so the image kernels always use the
+// clamp sampler (neither reads outside the image) and the two outputs are compared over the interior, where both
+// do the same work; a difference of 1 is the image path rounding where the buffer kernels truncate.
+string BenchmarkStorage(const cl::Context& context, const cl::CommandQueue& queue, const cl::Program& buffer_program,
+	const CImg<unsigned char>& image, const vector<float>& mask, int repeats = 10) {
+	const char* buffer_kernels[] = { "identityND", "avg_filterND", "convolutionND" };
+	const char* image_kernels[] = { "identity_image", "avg_filter_image", "convolution_image" };
+	stringstream sstream;
+
+	ImageFilters filters(context);
+	vector<cl::Image2D> image_input = filters.upload(image), image_output = filters.create(image.width(), image.height(), image.spectrum());
+	cl::Buffer dev_input(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, image.size(), (void*)image.data());
+	cl::Buffer dev_output(context, CL_MEM_READ_WRITE, image.size());
+	cl::Buffer dev_mask(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, mask.size() * sizeof(float), (void*)&mask[0]);
+	CImg<unsigned char> buffer_result(image.width(), image.height(), 1, image.spectrum());
+	CImg<unsigned char> image_result(image.width(), image.height(), 1, image.spectrum());
+
+	sstream << "Storage benchmark, " << image.width() << "x" << image.height() << "x" << image.spectrum()
+		<< ", clamp sampler, " << repeats << " repeats:" << endl;
+	for (int k = 0; k < 3; k++) {
+		cl::Kernel kernel(buffer_program, buffer_kernels[k]);
+		kernel.setArg(0, dev_input);
+		kernel.setArg(1, dev_output);
+		if (k == 2) kernel.setArg(2, dev_mask);
+
+		double buffer_time = 0, image_time = 0;
+		for (int i = 0; i <= repeats; i++) { // the first run is a warm up
+			vector<cl::Event> events(1);
+			queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(image.width(), image.height(), image.spectrum()),
+				cl::NullRange, NULL, &events[0]);
+			double time = GetExecutionTime(events);
+			if (i > 0) buffer_time += time / repeats;
+
+			events.clear();
+			filters.run(queue, image_kernels[k], image_input, image_output, BORDER_CLAMP, (k == 2) ? &dev_mask : NULL, &events);
+			time = GetExecutionTime(events);
+			if (i > 0) image_time += time / repeats;
+		}
+
+		queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, buffer_result.size(), buffer_result.data());
+		filters.download(queue, image_output, image_result);
+		int max_diff = 0;
+		cimg_forC(image, c) for (int y = 1; y < image.height() - 1; y++) for (int x = 1; x < image.width() - 1; x++)
+			max_diff = std::max(max_diff, std::abs((int)buffer_result(x, y, 0, c) - (int)image_result(x, y, 0, c)));
+
+		sstream << "   " << buffer_kernels[k] << ": buffer " << buffer_time << " [ms], image " << image_time << " [ms] ("
+			<< buffer_time / image_time << "x), max interior difference " << max_diff;
+		if (max_diff > 1) sstream << " (MISMATCH)";
+		sstream << endl;
+	}
+
+	return sstream.str();
+}
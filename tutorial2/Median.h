@@ -0,0 +1,175 @@
+#pragma once
+
+// K x K median filter for planar uchar or ushort images (kernels/median.cl), edges clamped.
+//
+// Three device methods: fixed selection networks for 3x3 and 5x5 (values kept in registers), a bitwise median
+// search for any K (8 or 16 passes over the neighbourhood, no sorting), and for 8-bit data Huang's sliding
+// histogram, which costs about 2K histogram updates per pixel instead of K*K comparisons. The first two read
+// their neighbourhoods from a local-memory tile. MEDIAN_AUTO picks the network for K <= 5, then the histogram
+// for uchar and the search for ushort. MedianHost() is the single-threaded reference.
+//
+//   MedianFilter<unsigned char> median(context);
+//   median.apply(queue, dev_input, dev_output, width, height, channels, 7);
+
+#include <algorithm>
+
+#include "Pixel.h"
+
+enum MedianMethod {
+	MEDIAN_AUTO,
+	MEDIAN_NETWORK,
+	MEDIAN_SELECT,
+	MEDIAN_HISTOGRAM
+};
+
+const char* GetMedianMethodName(MedianMethod method) {
+	switch (method) {
+	case MEDIAN_NETWORK: return "network";
+	case MEDIAN_SELECT: return "select";
+	case MEDIAN_HISTOGRAM: return "histogram";
+	default: return "auto";
+	}
+}
+
+template <typename T>
+class MedianFilter {
+public:
+	MedianFilter(const cl::Context& context, const string& kernel_file = "kernels/median.cl") {
+		cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+		stringstream options;
+		options << PixelBuildOptions<T>() << " -DPIXEL_BITS=" << sizeof(T) * 8;
+		program_ = BuildProgram(context, kernel_file, options.str());
+		median3x3_ = cl::Kernel(program_, "median3x3");
+		median5x5_ = cl::Kernel(program_, "median5x5");
+		select_ = cl::Kernel(program_, "median_select");
+		if (sizeof(T) == 1) histogram_ = cl::Kernel(program_, "median_histogram");
+
+		size_t max_work_group_size = device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+		group_size_ = 16;
+		while (group_size_ > 1 && group_size_ * group_size_ > max_work_group_size) group_size_ /= 2;
+		local_mem_size_ = device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+
+		// one 256-bin ushort histogram per work item in local memory
+		histogram_group_size_ = std::min((size_t)32, std::min(max_work_group_size, local_mem_size_ / (256 * sizeof(cl_ushort))));
+	}
+
+	bool supports(MedianMethod method, int mask_size) const {
+		switch (method) {
+		case MEDIAN_NETWORK: return (mask_size == 3) || (mask_size == 5);
+		case MEDIAN_SELECT: return tile_bytes(mask_size) <= local_mem_size_;
+		case MEDIAN_HISTOGRAM: return (sizeof(T) == 1) && (mask_size * mask_size < 65536) && (histogram_group_size_ > 0);
+		default: return true;
+		}
+	}
+
+	// Median over a mask_size x mask_size neighbourhood; input and output must be different buffers
+	void apply(const cl::CommandQueue& queue, const cl::Buffer& input, const cl::Buffer& output, int width, int height, int channels,
+		int mask_size, MedianMethod method = MEDIAN_AUTO, vector<cl::Event>* events = NULL) {
+		if (method == MEDIAN_AUTO)
+			method = supports(MEDIAN_NETWORK, mask_size) ? MEDIAN_NETWORK : supports(MEDIAN_HISTOGRAM, mask_size) ? MEDIAN_HISTOGRAM : MEDIAN_SELECT;
+		if ((mask_size % 2 == 0) || !supports(method, mask_size))
+			throw cl::Error(CL_INVALID_VALUE, "MedianFilter: mask size not supported by this method");
+
+		int radius = mask_size / 2;
+		cl::Event event;
+		if (method == MEDIAN_HISTOGRAM) {
+			int strip = std::max(32, 2 * mask_size); // the first window of each strip costs K*K updates
+			size_t work_items = (size_t)((width + strip - 1) / strip) * height;
+			work_items = (work_items + histogram_group_size_ - 1) / histogram_group_size_ * histogram_group_size_;
+			histogram_.setArg(0, input);
+			histogram_.setArg(1, output);
+			histogram_.setArg(2, width);
+			histogram_.setArg(3, height);
+			histogram_.setArg(4, radius);
+			histogram_.setArg(5, strip);
+			histogram_.setArg(6, cl::Local(histogram_group_size_ * 256 * sizeof(cl_ushort)));
+			queue.enqueueNDRangeKernel(histogram_, cl::NullRange, cl::NDRange(work_items, channels),
+				cl::NDRange(histogram_group_size_, 1), NULL, &event);
+		}
+		else {
+			cl::Kernel& kernel = (method == MEDIAN_SELECT) ? select_ : (mask_size == 3) ? median3x3_ : median5x5_;
+			int arg = 0;
+			kernel.setArg(arg++, input);
+			kernel.setArg(arg++, output);
+			kernel.setArg(arg++, width);
+			kernel.setArg(arg++, height);
+			if (method == MEDIAN_SELECT) kernel.setArg(arg++, radius);
+			kernel.setArg(arg++, cl::Local(tile_bytes(mask_size)));
+			queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(round_up(width), round_up(height), channels),
+				cl::NDRange(group_size_, group_size_, 1), NULL, &event);
+		}
+		if (events) events->push_back(event);
+	}
+
+private:
+	cl::Program program_;
+	cl::Kernel median3x3_, median5x5_, select_, histogram_;
+	size_t group_size_, histogram_group_size_, local_mem_size_;
+
+	size_t round_up(size_t n) const { return (n + group_size_ - 1) / group_size_ * group_size_; }
+
+	size_t tile_bytes(int mask_size) const {
+		size_t tile_width = group_size_ + 2 * (mask_size / 2);
+		return tile_width * tile_width * sizeof(T);
+	}
+};
+
+// Single-threaded reference with std::nth_element, edges clamped
+template <typename T>
+void MedianHost(const CImg<T>& input, CImg<T>& output, int mask_size) {
+	int width = input.width(), height = input.height(), radius = mask_size / 2;
+	vector<T> window(mask_size * mask_size);
+	output.assign(width, height, 1, input.spectrum());
+
+	for (int c = 0; c < input.spectrum(); c++)
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++) {
+				size_t n = 0;
+				for (int j = -radius; j <= radius; j++)
+					for (int i = -radius; i <= radius; i++)
+						window[n++] = input(std::min(std::max(x + i, 0), width - 1), std::min(std::max(y + j, 0), height - 1), 0, c);
+				std::nth_element(window.begin(), window.begin() + window.size() / 2, window.end());
+				output(x, y, 0, c) = window[window.size() / 2];
+			}
+}
+
+// Host reference against every applicable device method for K = 3 to 31; the queue must have profiling enabled
+template <typename T>
+string BenchmarkMedian(const cl::Context& context, const cl::CommandQueue& queue, const CImg<T>& image, int repeats = 3) {
+	const MedianMethod methods[] = { MEDIAN_NETWORK, MEDIAN_SELECT, MEDIAN_HISTOGRAM };
+	const int mask_sizes[] = { 3, 5, 7, 9, 15, 21, 31 };
+	stringstream sstream;
+	MedianFilter<T> median(context);
+	size_t image_bytes = image.size() * sizeof(T);
+	int width = image.width(), height = image.height(), channels = image.spectrum();
+	cl::Buffer dev_input(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, image_bytes, (void*)image.data());
+	cl::Buffer dev_output(context, CL_MEM_READ_WRITE, image_bytes);
+	CImg<T> reference, result(width, height, 1, channels);
+
+	sstream << "Median benchmark, " << width << "x" << height << "x" << channels << " " << PixelTraits<T>::name() << ", "
+		<< repeats << " repeats:" << endl;
+	for (int k = 0; k < 7; k++) {
+		int mask_size = mask_sizes[k];
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		MedianHost(image, reference, mask_size);
+		double host_time = chrono::duration<double, std::milli>(chrono::high_resolution_clock::now() - start).count();
+		sstream << "   " << mask_size << "x" << mask_size << ": host " << host_time << " [ms]";
+
+		for (int m = 0; m < 3; m++) {
+			if (!median.supports(methods[m], mask_size)) continue;
+			double time = 0;
+			for (int i = 0; i <= repeats; i++) { // the first run is a warm up
+				vector<cl::Event> events;
+				median.apply(queue, dev_input, dev_output, width, height, channels, mask_size, methods[m], &events);
+				double t = GetExecutionTime(events);
+				if (i > 0) time += t / repeats;
+			}
+			queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, image_bytes, result.data());
+			sstream << ", " << GetMedianMethodName(methods[m]) << " " << time << " [ms] (" << host_time / time << "x"
+				<< ((result == reference) ? "" : ", MISMATCH") << ")";
+		}
+		sstream << endl;
+	}
+
+	return sstream.str();
+}
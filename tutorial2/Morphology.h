@@ -0,0 +1,171 @@
+#pragma once
+
+// Erosion, dilation, opening and closing of planar uchar or ushort images with rectangular structuring elements
+// (kernels/morphology.cl). Each operation is a row pass and a column pass with the van Herk/Gil-Werman algorithm
+// on local-memory tiles, about three min/max operations per pixel and pass for any element size: each work group
+// covers a segment of at least 8K pixels per line, so the 2*radius halo adds at most a quarter to its loads and
+// scans. Pixels outside the image are ignored.
+//
+//   Morphology<unsigned char> morphology(context);
+//   morphology.apply(queue, MORPH_OPEN, dev_input, dev_output, width, height, channels, 15, 15);
+
+#include "Pixel.h"
+
+enum MorphologyOp {
+	MORPH_ERODE,
+	MORPH_DILATE,
+	MORPH_OPEN,  // erode then dilate
+	MORPH_CLOSE  // dilate then erode
+};
+
+bool ParseMorphologyOp(const string& name, MorphologyOp& op) {
+	if (name == "erode") op = MORPH_ERODE;
+	else if (name == "dilate") op = MORPH_DILATE;
+	else if (name == "open") op = MORPH_OPEN;
+	else if (name == "close") op = MORPH_CLOSE;
+	else return false;
+	return true;
+}
+
+template <typename T>
+class Morphology {
+public:
+	Morphology(const cl::Context& context, const string& kernel_file = "kernels/morphology.cl") : context_(context), temp_size_(0) {
+		cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+		program_ = BuildProgram(context, kernel_file, PixelBuildOptions<T>());
+		rows_ = cl::Kernel(program_, "morph_rows");
+		columns_ = cl::Kernel(program_, "morph_columns");
+		naive_ = cl::Kernel(program_, "morph_naive");
+		max_work_group_size_ = device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+		local_mem_size_ = device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+	}
+
+	// Apply op with a size_x x size_y element (odd sizes); input and output may be the same buffer
+	void apply(const cl::CommandQueue& queue, MorphologyOp op, const cl::Buffer& input, const cl::Buffer& output, int width, int height,
+		int channels, int size_x, int size_y, vector<cl::Event>* events = NULL) {
+		if ((size_x % 2 == 0) || (size_y % 2 == 0))
+			throw cl::Error(CL_INVALID_VALUE, "Morphology: structuring element sizes must be odd");
+
+		size_t temp_size = (size_t)width * height * channels * sizeof(T);
+		if (temp_size > temp_size_) {
+			temp_ = cl::Buffer(context_, CL_MEM_READ_WRITE, temp_size);
+			temp_size_ = temp_size;
+		}
+
+		bool first_dilate = (op == MORPH_DILATE) || (op == MORPH_CLOSE);
+		pass(queue, rows_, input, temp_, width, height, channels, size_x / 2, first_dilate, events);
+		pass(queue, columns_, temp_, output, width, height, channels, size_y / 2, first_dilate, events);
+		if ((op == MORPH_OPEN) || (op == MORPH_CLOSE)) {
+			pass(queue, rows_, output, temp_, width, height, channels, size_x / 2, !first_dilate, events);
+			pass(queue, columns_, temp_, output, width, height, channels, size_y / 2, !first_dilate, events);
+		}
+	}
+
+	// Reference erosion or dilation reading the whole window, K^2 operations per pixel
+	void apply_naive(const cl::CommandQueue& queue, bool dilate, const cl::Buffer& input, const cl::Buffer& output, int width, int height,
+		int channels, int size_x, int size_y, vector<cl::Event>* events = NULL) {
+		naive_.setArg(0, input);
+		naive_.setArg(1, output);
+		naive_.setArg(2, width);
+		naive_.setArg(3, height);
+		naive_.setArg(4, size_x / 2);
+		naive_.setArg(5, size_y / 2);
+		naive_.setArg(6, dilate ? 1 : 0);
+		cl::Event event;
+		queue.enqueueNDRangeKernel(naive_, cl::NullRange, cl::NDRange(width, height, channels), cl::NullRange, NULL, &event);
+		if (events) events->push_back(event);
+	}
+
+private:
+	cl::Context context_;
+	cl::Program program_;
+	cl::Kernel rows_, columns_, naive_;
+	size_t max_work_group_size_, local_mem_size_;
+	cl::Buffer temp_;
+	size_t temp_size_;
+
+	// one row or column pass; each group writes a segment of outputs_per_item*group_along pixels per line, at least
+	// 8K so that the halo is amortised, and the tile along the pass is the segment and its halo padded to whole
+	// K-pixel blocks. When the two local arrays do not fit, the segment shrinks down to 2K, then the number of lines
+	// per group is halved from 16, then the segment shrinks further
+	void pass(const cl::CommandQueue& queue, cl::Kernel& kernel, const cl::Buffer& input, const cl::Buffer& output, int width, int height,
+		int channels, int radius, bool dilate, vector<cl::Event>* events) {
+		bool rows = (&kernel == &rows_);
+		size_t K = 2 * radius + 1;
+		size_t group_along = 16, group_across = 16;
+		while (group_along * group_across > max_work_group_size_) {
+			if (group_across > 1) group_across /= 2;
+			else group_along /= 2;
+		}
+		size_t outputs_per_item = (8 * K + group_along - 1) / group_along;
+		size_t segment = outputs_per_item * group_along;
+		size_t tile_length = (segment + 2 * radius + K - 1) / K * K;
+		while (2 * tile_length * group_across * sizeof(T) > local_mem_size_) {
+			if ((outputs_per_item > 1) && (segment > 2 * K)) outputs_per_item--;
+			else if (group_across > 1) group_across /= 2;
+			else if (outputs_per_item > 1) outputs_per_item--;
+			else throw cl::Error(CL_OUT_OF_RESOURCES, "Morphology: structuring element too large for local memory");
+			segment = outputs_per_item * group_along;
+			tile_length = (segment + 2 * radius + K - 1) / K * K;
+		}
+
+		size_t local_x = rows ? group_along : group_across, local_y = rows ? group_across : group_along;
+		kernel.setArg(0, input);
+		kernel.setArg(1, output);
+		kernel.setArg(2, width);
+		kernel.setArg(3, height);
+		kernel.setArg(4, radius);
+		kernel.setArg(5, dilate ? 1 : 0);
+		kernel.setArg(6, (int)segment);
+		kernel.setArg(7, (int)tile_length);
+		kernel.setArg(8, cl::Local(tile_length * group_across * sizeof(T)));
+		kernel.setArg(9, cl::Local(tile_length * group_across * sizeof(T)));
+
+		size_t global_x = rows ? (width + segment - 1) / segment * local_x : (width + local_x - 1) / local_x * local_x;
+		size_t global_y = rows ? (height + local_y - 1) / local_y * local_y : (height + segment - 1) / segment * local_y;
+		cl::Event event;
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(global_x, global_y, channels), cl::NDRange(local_x, local_y, 1), NULL, &event);
+		if (events) events->push_back(event);
+	}
+};
+
+// van Herk/Gil-Werman erosion against the naive window kernel for square elements of 3 to 63, with the time per
+// pixel of the former, which should stay about flat as K grows; the queue must have profiling enabled
+template <typename T>
+string BenchmarkMorphology(const cl::Context& context, const cl::CommandQueue& queue, const CImg<T>& image, int repeats = 5) {
+	stringstream sstream;
+	Morphology<T> morphology(context);
+	size_t image_bytes = image.size() * sizeof(T);
+	int width = image.width(), height = image.height(), channels = image.spectrum();
+	cl::Buffer dev_input(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, image_bytes, (void*)image.data());
+	cl::Buffer dev_output(context, CL_MEM_READ_WRITE, image_bytes);
+	CImg<T> reference(width, height, 1, channels), result(width, height, 1, channels);
+
+	sstream << "Morphology (erosion) benchmark, " << width << "x" << height << "x" << channels << " " << PixelTraits<T>::name() << ", "
+		<< repeats << " repeats:" << endl;
+	const int sizes[] = { 3, 5, 7, 11, 15, 21, 31, 45, 63 };
+	for (int s = 0; s < 9; s++) {
+		int size = sizes[s];
+		double vhgw_time = 0, naive_time = 0;
+		for (int i = 0; i <= repeats; i++) { // the first run is a warm up
+			vector<cl::Event> events;
+			morphology.apply_naive(queue, false, dev_input, dev_output, width, height, channels, size, size, &events);
+			double time = GetExecutionTime(events);
+			if (i > 0) naive_time += time / repeats;
+		}
+		queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, image_bytes, reference.data());
+
+		for (int i = 0; i <= repeats; i++) {
+			vector<cl::Event> events;
+			morphology.apply(queue, MORPH_ERODE, dev_input, dev_output, width, height, channels, size, size, &events);
+			double time = GetExecutionTime(events);
+			if (i > 0) vhgw_time += time / repeats;
+		}
+		queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, image_bytes, result.data());
+
+		sstream << "   " << size << "x" << size << ": naive " << naive_time << " [ms], van Herk/Gil-Werman " << vhgw_time << " [ms] ("
+			<< naive_time / vhgw_time << "x, " << vhgw_time * 1e6 / image.size() << " [ns/pixel]" << ((result == reference) ? "" : ", MISMATCH") << ")" << endl;
+	}
+
+	return sstream.str();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+// Pixel types for the typed tutorial2 kernels. Images are loaded as 8-bit and converted on the host:
+// ushort samples are scaled to the full 16-bit range (x257), float samples keep the 0-255 range so that
+// thresholds and other constants mean the same for every type.
+
+#include <cmath>
+
+#include "Utils.h"
+#include "CImg.h"
+
+using namespace cimg_library;
+
+template <typename T> struct PixelTraits;
+
+template <> struct PixelTraits<unsigned char> {
+	static const char* name() { return "uchar"; }
+	static const char* convert() { return "convert_uchar_sat_rte"; }
+	static float scale() { return 1.f; }
+	static float max_value() { return 255.f; }
+};
+
+template <> struct PixelTraits<unsigned short> {
+	static const char* name() { return "ushort"; }
+	static const char* convert() { return "convert_ushort_sat_rte"; }
+	static float scale() { return 257.f; }
+	static float max_value() { return 65535.f; }
+};
+
+template <> struct PixelTraits<float> {
+	static const char* name() { return "float"; }
+	static const char* convert() { return "convert_float"; }
+	static float scale() { return 1.f; }
+	static float max_value() { return 255.f; }
+};
+
+//build options defining PIXEL_T and CONVERT_PIXEL for the kernel files
+template <typename T>
+string PixelBuildOptions() {
+	return string("-DPIXEL_T=") + PixelTraits<T>::name() + " -DCONVERT_PIXEL=" + PixelTraits<T>::convert();
+}
+
+//8-bit image -> pixel type T
+template <typename T>
+CImg<T> FromImage8(const CImg<unsigned char>& image) {
+	CImg<T> result(image.width(), image.height(), image.depth(), image.spectrum());
+	for (size_t i = 0; i < image.size(); i++)
+		result[i] = (T)(image[i] * PixelTraits<T>::scale());
+	return result;
+}
+
+//pixel type T -> 8-bit image for display, rounding and saturating
+template <typename T>
+CImg<unsigned char> ToImage8(const CImg<T>& image) {
+	CImg<unsigned char> result(image.width(), image.height(), image.depth(), image.spectrum());
+	for (size_t i = 0; i < image.size(); i++) {
+		float value = std::floor(image[i] / PixelTraits<T>::scale() + 0.5f);
+		result[i] = (unsigned char)std::min(std::max(value, 0.f), 255.f);
+	}
+	return result;
+}
@@ -0,0 +1,229 @@
+#pragma once
+
+// Fused per-pixel operations on planar 8-bit images.
+//
+// A chain such as "grey,gain:1.5:-40,gamma:2.2,invert,threshold:100" is turned into the source of a single
+// kernel that loads each pixel once, applies every operation in registers and stores it once, so a chain of
+// five operations costs one pass over memory instead of five. Programs are built on first use and cached by
+// the chain signature (operations, parameters and channel count), so later calls with the same chain only
+// set arguments and launch.
+//
+// Operations, parameters separated by ':':
+//   invert             255 - v
+//   mask:<channels>    keep the listed channels (any of r, g, b), zero the others
+//   grey               BT.709 luma written to every channel
+//   gain:<g>[:<b>]     v*g + b, saturated to [0, 255]
+//   gamma:<g>          255*(v/255)^(1/g)
+//   threshold:<t>      255 if v >= t, 0 otherwise
+// Results are kept as float between operations and rounded once at the end, so they can differ by one grey
+// level from running the operations as separate uchar kernels.
+
+#include <map>
+#include <iomanip>
+
+#include "Utils.h"
+
+struct PointOp {
+	enum Type { INVERT, MASK, GREY, GAIN, GAMMA, THRESHOLD } type;
+	float a, b;       // parameters: gain and bias, gamma, threshold
+	int channel_mask; // MASK: bit c set keeps channel c
+};
+
+// Parse a comma-separated chain; returns false and sets error on unknown operations or bad parameters
+bool ParsePointOps(const string& chain, vector<PointOp>& ops, string& error) {
+	ops.clear();
+	stringstream chain_stream(chain);
+	string item;
+	while (getline(chain_stream, item, ',')) {
+		vector<string> fields;
+		stringstream item_stream(item);
+		string field;
+		while (getline(item_stream, field, ':')) fields.push_back(field);
+		if (fields.empty()) continue;
+
+		PointOp op = { PointOp::INVERT, 0.f, 0.f, 0 };
+		const string& name = fields[0];
+		size_t params = fields.size() - 1;
+		bool valid = true;
+		if (name == "invert") { op.type = PointOp::INVERT; valid = (params == 0); }
+		else if (name == "grey") { op.type = PointOp::GREY; valid = (params == 0); }
+		else if (name == "gain") { op.type = PointOp::GAIN; valid = (params == 1 || params == 2); }
+		else if (name == "gamma") { op.type = PointOp::GAMMA; valid = (params == 1); }
+		else if (name == "threshold") { op.type = PointOp::THRESHOLD; valid = (params == 1); }
+		else if (name == "mask") {
+			op.type = PointOp::MASK;
+			valid = (params == 1);
+			for (size_t i = 0; valid && i < fields[1].size(); i++) {
+				const char* channel = strchr("rgb", fields[1][i]);
+				if (channel && *channel) op.channel_mask |= 1 << (channel - "rgb");
+				else valid = false;
+			}
+		}
+		else { error = "unknown operation '" + name + "'"; return false; }
+
+		if (valid && op.type != PointOp::MASK && params > 0) {
+			op.a = (float)atof(fields[1].c_str());
+			op.b = (params > 1) ? (float)atof(fields[2].c_str()) : 0.f;
+			if (op.type == PointOp::GAMMA && op.a <= 0.f) valid = false;
+		}
+		if (!valid) { error = "bad parameters for '" + item + "'"; return false; }
+		ops.push_back(op);
+	}
+	if (ops.empty()) { error = "empty chain"; return false; }
+	return true;
+}
+
+// float constant as an OpenCL C literal that round-trips exactly
+string PointOpLiteral(float value) {
+	stringstream sstream;
+	sstream << std::scientific << std::setprecision(9) << value << "f";
+	return sstream.str();
+}
+
+// Canonical description of a chain for the given channel count, used as the cache key
+string PointOpSignature(const vector<PointOp>& ops, int channels) {
+	stringstream sstream;
+	sstream << channels;
+	for (size_t i = 0; i < ops.size(); i++)
+		sstream << "|" << ops[i].type << ":" << PointOpLiteral(ops[i].a) << ":" << PointOpLiteral(ops[i].b) << ":" << ops[i].channel_mask;
+	return sstream.str();
+}
+
+// Source of the fused kernel point_ops(global const uchar* A, global uchar* B, const int image_size), one work item per pixel
+string GeneratePointOpKernel(const vector<PointOp>& ops, int channels) {
+	stringstream src;
+	src << "kernel void point_ops(global const uchar* A, global uchar* B, const int image_size) {\n";
+	src << "\tint id = get_global_id(0);\n";
+	src << "\tif (id >= image_size) return;\n";
+	for (int c = 0; c < channels; c++)
+		src << "\tfloat v" << c << " = A[id + " << c << "*image_size];\n";
+
+	for (size_t i = 0; i < ops.size(); i++) {
+		const PointOp& op = ops[i];
+		if (op.type == PointOp::GREY) {
+			if (channels == 3) {
+				src << "\t{ float luma = v0*0.2126f + v1*0.7152f + v2*0.0722f; v0 = luma; v1 = luma; v2 = luma; }\n";
+			}
+			continue;
+		}
+		for (int c = 0; c < channels; c++) {
+			string v = "v" + std::to_string(c);
+			switch (op.type) {
+			case PointOp::INVERT: src << "\t" << v << " = 255.0f - " << v << ";\n"; break;
+			case PointOp::MASK: if (!(op.channel_mask & (1 << c))) src << "\t" << v << " = 0.0f;\n"; break;
+			case PointOp::GAIN: src << "\t" << v << " = clamp(" << v << "*" << PointOpLiteral(op.a) << " + " << PointOpLiteral(op.b) << ", 0.0f, 255.0f);\n"; break;
+			case PointOp::GAMMA: src << "\t" << v << " = 255.0f*powr(" << v << "/255.0f, " << PointOpLiteral(1.f / op.a) << ");\n"; break;
+			case PointOp::THRESHOLD: src << "\t" << v << " = (" << v << " >= " << PointOpLiteral(op.a) << ") ? 255.0f : 0.0f;\n"; break;
+			default: break;
+			}
+		}
+	}
+
+	for (int c = 0; c < channels; c++)
+		src << "\tB[id + " << c << "*image_size] = convert_uchar_sat_rte(v" << c << ");\n";
+	src << "}\n";
+	return src.str();
+}
+
+class PointOpEngine {
+public:
+	PointOpEngine(const cl::Context& context) : context_(context), builds_(0), build_time_(0) {}
+
+	// Apply the chain to a planar image of image_size pixels per channel; input and output may be the same buffer
+	void apply(const cl::CommandQueue& queue, const cl::Buffer& input, const cl::Buffer& output, int image_size, int channels,
+		const vector<PointOp>& ops, vector<cl::Event>* events = NULL) {
+		cl::Kernel& kernel = get_kernel(ops, channels);
+		kernel.setArg(0, input);
+		kernel.setArg(1, output);
+		kernel.setArg(2, image_size);
+
+		cl::Event event;
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(image_size), cl::NullRange, NULL, &event);
+		if (events) events->push_back(event);
+	}
+
+	size_t cache_size() const { return cache_.size(); }
+	int builds() const { return builds_; }
+	double build_time() const { return build_time_; } // total JIT time [ms]
+
+private:
+	struct Entry {
+		cl::Program program;
+		cl::Kernel kernel;
+	};
+
+	cl::Context context_;
+	std::map<string, Entry> cache_;
+	int builds_;
+	double build_time_;
+
+	cl::Kernel& get_kernel(const vector<PointOp>& ops, int channels) {
+		string signature = PointOpSignature(ops, channels);
+		std::map<string, Entry>::iterator it = cache_.find(signature);
+		if (it != cache_.end())
+			return it->second.kernel;
+
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		Entry entry;
+		entry.program = cl::Program(context_, GeneratePointOpKernel(ops, channels));
+		try {
+			entry.program.build();
+		}
+		catch (const cl::Error& err) {
+			cl::Device device = context_.getInfo<CL_CONTEXT_DEVICES>()[0];
+			std::cout << "Build Status: " << entry.program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(device) << std::endl;
+			std::cout << "Build Log:\t " << entry.program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device) << std::endl;
+			throw err;
+		}
+		entry.kernel = cl::Kernel(entry.program, "point_ops");
+		build_time_ += chrono::duration<double, std::milli>(chrono::high_resolution_clock::now() - start).count();
+		builds_++;
+
+		return (cache_[signature] = entry).kernel;
+	}
+};
+
+// The chain fused into one kernel against one kernel (one memory pass) per operation; the queue must have profiling enabled
+string BenchmarkPointOps(const cl::Context& context, const cl::CommandQueue& queue, const vector<unsigned char>& image, int image_size,
+	int channels, const vector<PointOp>& ops, int repeats = 10) {
+	stringstream sstream;
+	PointOpEngine engine(context);
+	cl::Buffer dev_input(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, image.size(), (void*)&image[0]);
+	cl::Buffer dev_output(context, CL_MEM_READ_WRITE, image.size());
+	vector<unsigned char> fused_result(image.size()), separate_result(image.size());
+
+	// build everything first so that the timings only cover the kernels
+	engine.apply(queue, dev_input, dev_output, image_size, channels, ops);
+	for (size_t i = 0; i < ops.size(); i++)
+		engine.apply(queue, dev_input, dev_output, image_size, channels, vector<PointOp>(1, ops[i]));
+	queue.finish();
+
+	double fused_time = 0, separate_time = 0;
+	for (int r = 0; r < repeats; r++) {
+		vector<cl::Event> events;
+		engine.apply(queue, dev_input, dev_output, image_size, channels, ops, &events);
+		fused_time += GetExecutionTime(events) / repeats;
+	}
+	queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, image.size(), &fused_result[0]);
+
+	for (int r = 0; r < repeats; r++) {
+		vector<cl::Event> events;
+		for (size_t i = 0; i < ops.size(); i++)
+			engine.apply(queue, (i == 0) ? dev_input : dev_output, dev_output, image_size, channels, vector<PointOp>(1, ops[i]), &events);
+		separate_time += GetExecutionTime(events) / repeats;
+	}
+	queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, image.size(), &separate_result[0]);
+
+	size_t differences = 0;
+	for (size_t i = 0; i < image.size(); i++)
+		if (fused_result[i] != separate_result[i]) differences++;
+
+	sstream << "Point operation benchmark, " << ops.size() << " operations, " << image_size << " pixels x " << channels << " channels, "
+		<< repeats << " repeats:" << endl;
+	sstream << "   fused: " << fused_time << " [ms], 1 pass" << endl;
+	sstream << "   separate: " << separate_time << " [ms], " << ops.size() << " passes (" << separate_time / fused_time << "x)" << endl;
+	sstream << "   " << engine.builds() << " programs built in " << engine.build_time() << " [ms], " << differences
+		<< " samples differ by rounding" << endl;
+
+	return sstream.str();
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+// Resampling of planar uchar, ushort or float images to any size on the device (kernels/resize.cl):
+// nearest, bilinear, bicubic (Catmull-Rom) and area averaging, the last being the one for downscaling.
+//
+//   Resizer<unsigned char> resizer(context);
+//   resizer.apply(queue, dev_input, dev_output, width, height, width / 4, height / 4, channels, RESIZE_AREA);
+
+#include "Pixel.h"
+
+enum ResizeMethod {
+	RESIZE_NEAREST,
+	RESIZE_BILINEAR,
+	RESIZE_BICUBIC,
+	RESIZE_AREA
+};
+
+bool ParseResizeMethod(const string& name, ResizeMethod& method) {
+	if (name == "nearest") method = RESIZE_NEAREST;
+	else if (name == "bilinear") method = RESIZE_BILINEAR;
+	else if (name == "bicubic") method = RESIZE_BICUBIC;
+	else if (name == "area") method = RESIZE_AREA;
+	else return false;
+	return true;
+}
+
+const char* GetResizeMethodName(ResizeMethod method) {
+	switch (method) {
+	case RESIZE_NEAREST: return "nearest";
+	case RESIZE_BILINEAR: return "bilinear";
+	case RESIZE_BICUBIC: return "bicubic";
+	default: return "area";
+	}
+}
+
+template <typename T>
+class Resizer {
+public:
+	Resizer(const cl::Context& context, const string& kernel_file = "kernels/resize.cl") {
+		program_ = BuildProgram(context, kernel_file, PixelBuildOptions<T>());
+		kernels_[RESIZE_NEAREST] = cl::Kernel(program_, "resize_nearest");
+		kernels_[RESIZE_BILINEAR] = cl::Kernel(program_, "resize_bilinear");
+		kernels_[RESIZE_BICUBIC] = cl::Kernel(program_, "resize_bicubic");
+		kernels_[RESIZE_AREA] = cl::Kernel(program_, "resize_area");
+	}
+
+	// Resample in_width x in_height x channels into out_width x out_height x channels
+	void apply(const cl::CommandQueue& queue, const cl::Buffer& input, const cl::Buffer& output, int in_width, int in_height,
+		int out_width, int out_height, int channels, ResizeMethod method, vector<cl::Event>* events = NULL) {
+		if ((out_width < 1) || (out_height < 1))
+			throw cl::Error(CL_INVALID_VALUE, "Resizer: the output must be at least 1x1");
+
+		cl::Kernel& kernel = kernels_[method];
+		kernel.setArg(0, input);
+		kernel.setArg(1, output);
+		kernel.setArg(2, in_width);
+		kernel.setArg(3, in_height);
+		kernel.setArg(4, out_width);
+		kernel.setArg(5, out_height);
+
+		cl::Event event;
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(out_width, out_height, channels), cl::NullRange, NULL, &event);
+		if (events) events->push_back(event);
+	}
+
+private:
+	cl::Program program_;
+	cl::Kernel kernels_[4];
+};
+
+// Every device method against CImg's resize on the host (same interpolation) for a few scale factors, with the
+// largest absolute difference between the two; the queue must have profiling enabled
+template <typename T>
+string BenchmarkResize(const cl::Context& context, const cl::CommandQueue& queue, const CImg<T>& image, int repeats = 5) {
+	const float factors[] = { 0.125f, 0.25f, 0.5f, 2.f };
+	const int cimg_interpolation[] = { 1, 3, 5, 2 }; // nearest, linear, cubic, moving average
+	stringstream sstream;
+	Resizer<T> resizer(context);
+	int width = image.width(), height = image.height(), channels = image.spectrum();
+	cl::Buffer dev_input(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, image.size() * sizeof(T), (void*)image.data());
+
+	sstream << "Resize benchmark, " << width << "x" << height << "x" << channels << " " << PixelTraits<T>::name() << ", "
+		<< repeats << " repeats:" << endl;
+	for (int f = 0; f < 4; f++) {
+		int out_width = std::max(1, (int)(width * factors[f] + 0.5f)), out_height = std::max(1, (int)(height * factors[f] + 0.5f));
+		cl::Buffer dev_output(context, CL_MEM_READ_WRITE, (size_t)out_width * out_height * channels * sizeof(T));
+		CImg<T> result(out_width, out_height, 1, channels);
+		sstream << "   x" << factors[f] << " (" << out_width << "x" << out_height << "):";
+
+		for (int m = RESIZE_NEAREST; m <= RESIZE_AREA; m++) {
+			double time = 0;
+			for (int i = 0; i <= repeats; i++) { // the first run is a warm up
+				vector<cl::Event> events;
+				resizer.apply(queue, dev_input, dev_output, width, height, out_width, out_height, channels, (ResizeMethod)m, &events);
+				double t = GetExecutionTime(events);
+				if (i > 0) time += t / repeats;
+			}
+
+			chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+			CImg<T> reference = image.get_resize(out_width, out_height, -100, -100, cimg_interpolation[m]);
+			double host_time = chrono::duration<double, std::milli>(chrono::high_resolution_clock::now() - start).count();
+
+			queue.enqueueReadBuffer(dev_output, CL_TRUE, 0, result.size() * sizeof(T), result.data());
+			double max_diff = 0;
+			for (size_t i = 0; i < result.size(); i++)
+				max_diff = std::max(max_diff, std::fabs((double)reference[i] - (double)result[i]));
+
+			sstream << " " << GetResizeMethodName((ResizeMethod)m) << " " << time << " [ms] (host " << host_time << " [ms], max diff "
+				<< max_diff << ")"
+				<< ((m < RESIZE_AREA) ? "," : "");
+		}
+		sstream << endl;
+	}
+
+	return sstream.str();
+}
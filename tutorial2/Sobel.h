@@ -0,0 +1,144 @@
+#pragma once
+
+// Fused Sobel edge detector for planar uchar, ushort or float images (kernels/sobel.cl).
+//
+// apply() is one pass: the input tile is read once and Gx, Gy, magnitude and quantised direction are computed in
+// registers; the magnitude (and, on request, the direction) is written out. suppress() is the optional second pass
+// that thins edges to one pixel with non-maximum suppression. The unfused alternative, two convolutions and a
+// combine on the host, is timed by BenchmarkSobel().
+//
+//   SobelFilter<unsigned char> sobel(context);
+//   sobel.apply(queue, dev_input, dev_magnitude, &dev_direction, width, height, channels);
+//   sobel.suppress(queue, dev_magnitude, dev_direction, dev_output, width, height, channels);
+
+#include "Convolution.h"
+
+template <typename T>
+class SobelFilter {
+public:
+	SobelFilter(const cl::Context& context, const string& kernel_file = "kernels/sobel.cl") {
+		cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+		program_ = BuildProgram(context, kernel_file, PixelBuildOptions<T>());
+		sobel_ = cl::Kernel(program_, "sobel");
+		nms_ = cl::Kernel(program_, "sobel_nms");
+
+		size_t max_work_group_size = std::min((size_t)device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>(),
+			sobel_.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device));
+		group_size_ = 16;
+		while (group_size_ > 1 && group_size_ * group_size_ > max_work_group_size) group_size_ /= 2;
+	}
+
+	// Gradient magnitude times scale into magnitude; direction (one uchar per pixel, 0-3 for 0/45/90/135 degrees) is
+	// written when a buffer is given. The default scale keeps the largest possible magnitude (4*sqrt(2)*max) in range.
+	void apply(const cl::CommandQueue& queue, const cl::Buffer& input, const cl::Buffer& magnitude, const cl::Buffer* direction,
+		int width, int height, int channels, float scale = 0.1767767f, vector<cl::Event>* events = NULL) {
+		size_t tile_width = group_size_ + 2;
+		sobel_.setArg(0, input);
+		sobel_.setArg(1, magnitude);
+		sobel_.setArg(2, direction ? *direction : magnitude); // unused without a direction buffer
+		sobel_.setArg(3, width);
+		sobel_.setArg(4, height);
+		sobel_.setArg(5, scale);
+		sobel_.setArg(6, direction ? 1 : 0);
+		sobel_.setArg(7, cl::Local(tile_width * tile_width * sizeof(float)));
+
+		cl::Event event;
+		queue.enqueueNDRangeKernel(sobel_, cl::NullRange, cl::NDRange(round_up(width), round_up(height), channels),
+			cl::NDRange(group_size_, group_size_, 1), NULL, &event);
+		if (events) events->push_back(event);
+	}
+
+	// Non-maximum suppression of a magnitude image along the directions written by apply()
+	void suppress(const cl::CommandQueue& queue, const cl::Buffer& magnitude, const cl::Buffer& direction, const cl::Buffer& output,
+		int width, int height, int channels, vector<cl::Event>* events = NULL) {
+		nms_.setArg(0, magnitude);
+		nms_.setArg(1, direction);
+		nms_.setArg(2, output);
+		nms_.setArg(3, width);
+		nms_.setArg(4, height);
+
+		cl::Event event;
+		queue.enqueueNDRangeKernel(nms_, cl::NullRange, cl::NDRange(width, height, channels), cl::NullRange, NULL, &event);
+		if (events) events->push_back(event);
+	}
+
+private:
+	cl::Program program_;
+	cl::Kernel sobel_, nms_;
+	size_t group_size_;
+
+	size_t round_up(size_t n) const { return (n + group_size_ - 1) / group_size_ * group_size_; }
+};
+
+// Fused Sobel (with and without NMS) against two float convolutions for Gx and Gy combined on the host; the fused
+// magnitude is checked against the scaled host combination (both clamp the edges, so every pixel is compared)
+template <typename T>
+string BenchmarkSobel(const cl::Context& context, const cl::CommandQueue& queue, const CImg<T>& image, int repeats = 10) {
+	stringstream sstream;
+	SobelFilter<T> sobel(context);
+	Convolution<float> convolution(context);
+	int width = image.width(), height = image.height(), channels = image.spectrum();
+	size_t pixels = image.size();
+	CImg<float> image_float(image);
+
+	cl::Buffer dev_input(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, pixels * sizeof(T), (void*)image.data());
+	cl::Buffer dev_magnitude(context, CL_MEM_READ_WRITE, pixels * sizeof(T));
+	cl::Buffer dev_direction(context, CL_MEM_READ_WRITE, pixels);
+	cl::Buffer dev_output(context, CL_MEM_READ_WRITE, pixels * sizeof(T));
+	cl::Buffer dev_input_float(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, pixels * sizeof(float), (void*)image_float.data());
+	cl::Buffer dev_gx(context, CL_MEM_READ_WRITE, pixels * sizeof(float));
+	cl::Buffer dev_gy(context, CL_MEM_READ_WRITE, pixels * sizeof(float));
+	vector<float> gx(pixels), gy(pixels), combined(pixels);
+
+	const float sobel_x[] = { -1, 0, 1, -2, 0, 2, -1, 0, 1 };
+	const float sobel_y[] = { -1, -2, -1, 0, 0, 0, 1, 2, 1 };
+	vector<float> mask_x(sobel_x, sobel_x + 9), mask_y(sobel_y, sobel_y + 9);
+
+	double fused_time = 0, nms_time = 0, unfused_time = 0, host_time = 0;
+	for (int i = 0; i <= repeats; i++) { // the first run is a warm up
+		vector<cl::Event> events;
+		sobel.apply(queue, dev_input, dev_magnitude, NULL, width, height, channels, 0.1767767f, &events);
+		double fused = GetExecutionTime(events);
+
+		events.clear();
+		sobel.apply(queue, dev_input, dev_magnitude, &dev_direction, width, height, channels, 0.1767767f, &events);
+		sobel.suppress(queue, dev_magnitude, dev_direction, dev_output, width, height, channels, &events);
+		double nms = GetExecutionTime(events);
+
+		// unfused: both gradients to device memory, then back to the host to combine
+		events.clear();
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		convolution.apply_2d(queue, dev_input_float, dev_gx, width, height, channels, mask_x, BORDER_CLAMP, &events);
+		convolution.apply_2d(queue, dev_input_float, dev_gy, width, height, channels, mask_y, BORDER_CLAMP, &events);
+		queue.enqueueReadBuffer(dev_gx, CL_TRUE, 0, pixels * sizeof(float), &gx[0]);
+		queue.enqueueReadBuffer(dev_gy, CL_TRUE, 0, pixels * sizeof(float), &gy[0]);
+		for (size_t p = 0; p < pixels; p++)
+			combined[p] = std::sqrt(gx[p] * gx[p] + gy[p] * gy[p]);
+		double host = chrono::duration<double, std::milli>(chrono::high_resolution_clock::now() - start).count();
+		double unfused = GetExecutionTime(events);
+
+		if (i > 0) {
+			fused_time += fused / repeats;
+			nms_time += nms / repeats;
+			unfused_time += unfused / repeats;
+			host_time += host / repeats;
+		}
+	}
+
+	vector<T> magnitude(pixels);
+	queue.enqueueReadBuffer(dev_magnitude, CL_TRUE, 0, pixels * sizeof(T), &magnitude[0]);
+	double max_diff = 0;
+	for (size_t p = 0; p < pixels; p++) {
+		double reference = std::min(0.1767767 * combined[p], (double)PixelTraits<T>::max_value());
+		max_diff = std::max(max_diff, std::fabs((double)magnitude[p] - reference));
+	}
+
+	sstream << "Sobel benchmark, " << width << "x" << height << "x" << channels << " " << PixelTraits<T>::name() << ", " << repeats << " repeats:" << endl;
+	sstream << "   fused magnitude: " << fused_time << " [ms] kernel, 1 pass" << endl;
+	sstream << "   fused magnitude + direction, NMS: " << nms_time << " [ms] kernels, 2 passes" << endl;
+	sstream << "   Gx, Gy convolutions + host combine: " << unfused_time << " [ms] kernels, " << host_time
+		<< " [ms] wall clock with transfers and combine, 4 passes" << endl;
+	sstream << "   max difference fused against unfused magnitude: " << max_diff << endl;
+
+	return sstream.str();
+}
@@ -0,0 +1,137 @@
+// Bilateral (edge-preserving) smoothing of planar images, edges clamped. Every neighbour is weighted by its
+// distance (spatial weights, constant memory) and by its difference from the centre pixel (range weights, a
+// lookup table in constant memory indexed by the difference >> RANGE_SHIFT), so there is no exp() per tap.
+// For large spatial sigmas the bilateral grid kernels downsample the image into a coarse (x, y, intensity)
+// grid, blur the grid and read the result back with trilinear interpolation.
+// Build options:
+//   -DPIXEL_T=uchar|ushort
+//   -DCONVERT_PIXEL=convert_uchar_sat_rte|convert_ushort_sat_rte
+//   -DRANGE_SHIFT=0|6  range LUT quantisation: 256 entries for 8-bit data, 1024 for 16-bit data
+
+#ifndef PIXEL_T
+#define PIXEL_T uchar
+#define CONVERT_PIXEL convert_uchar_sat_rte
+#endif
+#ifndef RANGE_SHIFT
+#define RANGE_SHIFT 0
+#endif
+
+//direct filter over a (2*radius + 1)^2 window; spatial holds (2*radius + 1)^2 weights, row by row
+//global size: width x height x channels rounded up to the local size, tile: (local size + 2*radius)^2 pixels
+kernel void bilateral(global const PIXEL_T* A, global PIXEL_T* B, constant float* spatial, constant float* range,
+	const int width, const int height, const int radius, local PIXEL_T* tile) {
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int c = get_global_id(2);
+	int lx = get_local_id(0);
+	int ly = get_local_id(1);
+	int group_width = get_local_size(0);
+	int group_height = get_local_size(1);
+	int K = 2*radius + 1;
+	int tile_width = group_width + 2*radius;
+	int origin_x = get_group_id(0)*group_width - radius;
+	int origin_y = get_group_id(1)*group_height - radius;
+	global const PIXEL_T* plane = A + c*width*height;
+
+	for (int i = lx + ly*group_width; i < tile_width*(group_height + 2*radius); i += group_width*group_height) {
+		int tx = clamp(origin_x + i % tile_width, 0, width - 1);
+		int ty = clamp(origin_y + i / tile_width, 0, height - 1);
+		tile[i] = plane[tx + ty*width];
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if ((x >= width) || (y >= height))
+		return;
+
+	PIXEL_T centre = tile[(ly + radius)*tile_width + lx + radius];
+	float sum = 0.0f, weight = 0.0f;
+	for (int j = 0; j < K; j++) {
+		local const PIXEL_T* t = tile + (ly + j)*tile_width + lx;
+		for (int i = 0; i < K; i++) {
+			PIXEL_T value = t[i];
+			float w = spatial[i + j*K]*range[abs_diff(value, centre) >> RANGE_SHIFT];
+			sum += w*(float)value;
+			weight += w;
+		}
+	}
+
+	B[x + y*width + c*width*height] = CONVERT_PIXEL(sum/weight); //the centre weight is 1, so weight > 0
+}
+
+//bilateral grid: cell (gx, gy, gz) of channel c stores a (value sum, count) pair of floats at
+//2*(gx + gy*grid_width + (gz + c*grid_depth)*grid_width*grid_height); it covers the pixels nearest to
+//(gx*spacing, gy*spacing) whose intensity rounds to gz*range_spacing
+
+//splat: each work item owns one (gx, gy) column of cells and accumulates the pixels nearest to it, so no
+//atomics are needed; the grid must be zeroed first
+//global size: grid_width x grid_height x channels
+kernel void grid_splat(global const PIXEL_T* A, global float* grid, const int width, const int height, const int spacing,
+	const float range_spacing, const int grid_width, const int grid_height, const int grid_depth) {
+	int gx = get_global_id(0);
+	int gy = get_global_id(1);
+	int c = get_global_id(2);
+	global const PIXEL_T* plane = A + c*width*height;
+	int cells = grid_width*grid_height;
+	global float* column = grid + 2*(gx + gy*grid_width + c*grid_depth*cells);
+
+	//pixel x belongs to cell (x + spacing/2)/spacing
+	int x0 = max(gx*spacing - spacing/2, 0), x1 = min(gx*spacing - spacing/2 + spacing, width);
+	int y0 = max(gy*spacing - spacing/2, 0), y1 = min(gy*spacing - spacing/2 + spacing, height);
+	for (int y = y0; y < y1; y++)
+		for (int x = x0; x < x1; x++) {
+			float value = (float)plane[x + y*width];
+			int gz = (int)(value/range_spacing + 0.5f);
+			column[2*gz*cells] += value;
+			column[2*gz*cells + 1] += 1.0f;
+		}
+}
+
+//one [1 2 1]/4 pass along axis 0 (x), 1 (y) or 2 (intensity), cells outside the grid count as empty
+//global size: grid_width x grid_height x grid_depth*channels
+kernel void grid_blur(global const float* G, global float* H, const int grid_width, const int grid_height, const int grid_depth,
+	const int axis) {
+	int gx = get_global_id(0);
+	int gy = get_global_id(1);
+	int gz = get_global_id(2) % grid_depth;
+	int id = gx + gy*grid_width + get_global_id(2)*grid_width*grid_height;
+
+	int position = (axis == 0) ? gx : (axis == 1) ? gy : gz;
+	int size = (axis == 0) ? grid_width : (axis == 1) ? grid_height : grid_depth;
+	int stride = (axis == 0) ? 1 : (axis == 1) ? grid_width : grid_width*grid_height;
+
+	float sum = 2.0f*G[2*id], count = 2.0f*G[2*id + 1];
+	if (position > 0) { sum += G[2*(id - stride)]; count += G[2*(id - stride) + 1]; }
+	if (position < size - 1) { sum += G[2*(id + stride)]; count += G[2*(id + stride) + 1]; }
+	H[2*id] = 0.25f*sum;
+	H[2*id + 1] = 0.25f*count;
+}
+
+//slice: trilinear interpolation of the blurred grid at (x/spacing, y/spacing, value/range_spacing)
+//global size: width x height x channels
+kernel void grid_slice(global const PIXEL_T* A, global const float* grid, global PIXEL_T* B, const int width, const int height,
+	const int spacing, const float range_spacing, const int grid_width, const int grid_height, const int grid_depth) {
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int c = get_global_id(2);
+	int id = x + y*width + c*width*height;
+	float value = (float)A[id];
+
+	float fx = (float)x/spacing, fy = (float)y/spacing, fz = value/range_spacing;
+	int x0 = min((int)fx, grid_width - 2), y0 = min((int)fy, grid_height - 2), z0 = min((int)fz, grid_depth - 2);
+	float dx = fx - x0, dy = fy - y0, dz = fz - z0;
+	int cells = grid_width*grid_height;
+	global const float* g = grid + 2*(x0 + y0*grid_width + (z0 + c*grid_depth)*cells);
+
+	float sum = 0.0f, count = 0.0f;
+	for (int k = 0; k < 2; k++)
+		for (int j = 0; j < 2; j++)
+			for (int i = 0; i < 2; i++) {
+				float w = (i ? dx : 1.0f - dx)*(j ? dy : 1.0f - dy)*(k ? dz : 1.0f - dz);
+				int offset = 2*(i + j*grid_width + k*cells);
+				sum += w*g[offset];
+				count += w*g[offset + 1];
+			}
+
+	B[id] = (count > 0.0f) ? CONVERT_PIXEL(sum/count) : A[id];
+}
@@ -0,0 +1,173 @@
+// K x K convolution of planar images (channel after channel, as stored by CImg) with any odd mask size.
+// The mask lives in constant memory and is indexed mask[i + j*mask_size] (row-major, i along x).
+// Separable masks can instead be applied as a horizontal and a vertical pass of K taps each.
+// Build options select the pixel type:
+//   -DPIXEL_T=uchar|ushort|float
+//   -DCONVERT_PIXEL=convert_uchar_sat_rte|convert_ushort_sat_rte|convert_float  result conversion
+
+#ifndef PIXEL_T
+#define PIXEL_T uchar
+#define CONVERT_PIXEL convert_uchar_sat_rte
+#endif
+
+//border modes: how pixels outside the image are read
+#define BORDER_CLAMP 0  //repeat the edge pixel: aaa|abcd|ddd
+#define BORDER_MIRROR 1 //reflect without repeating the edge: cb|abcd|cb
+#define BORDER_ZERO 2   //pixels outside read as 0
+
+//map a coordinate into [0, n); -1 means the pixel reads as zero
+int border_index(int i, int n, int border) {
+	if ((i >= 0) && (i < n))
+		return i;
+	if (border == BORDER_ZERO)
+		return -1;
+	if ((border == BORDER_CLAMP) || (n == 1))
+		return clamp(i, 0, n - 1);
+	int period = 2 * (n - 1);
+	i = (int)abs(i) % period;
+	return (i < n) ? i : period - i;
+}
+
+//read one pixel of a channel plane as float, applying the border mode
+float read_pixel(global const PIXEL_T* plane, int x, int y, int width, int height, int border) {
+	x = border_index(x, width, border);
+	y = border_index(y, height, border);
+	if ((x < 0) || (y < 0))
+		return 0.0f;
+	return (float)plane[x + y*width];
+}
+
+//same for the float planes passed between the two separable passes
+float read_float(global const float* plane, int x, int y, int width, int height, int border) {
+	x = border_index(x, width, border);
+	y = border_index(y, height, border);
+	if ((x < 0) || (y < 0))
+		return 0.0f;
+	return plane[x + y*width];
+}
+
+//naive version: every work item reads all K*K neighbours from global memory
+//global size: width x height x channels
+kernel void convolution2D_naive(global const PIXEL_T* A, global PIXEL_T* B, constant float* mask,
+	const int width, const int height, const int radius, const int border) {
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int c = get_global_id(2);
+	if ((x >= width) || (y >= height))
+		return;
+
+	global const PIXEL_T* plane = A + c*width*height;
+	int mask_size = 2*radius + 1;
+	float result = 0.0f;
+
+	for (int j = 0; j < mask_size; j++)
+		for (int i = 0; i < mask_size; i++)
+			result += read_pixel(plane, x + i - radius, y + j - radius, width, height, border) * mask[i + j*mask_size];
+
+	B[x + y*width + c*width*height] = CONVERT_PIXEL(result);
+}
+
+//tiled version: each work group stages its (local_size + 2*radius)^2 input tile, halo included, in local
+//memory with one global read per tile pixel, then convolves from local memory
+//global size: width x height x channels rounded up to the local size (local size in z must be 1)
+//tile: (get_local_size(0) + 2*radius) * (get_local_size(1) + 2*radius) floats
+kernel void convolution2D(global const PIXEL_T* A, global PIXEL_T* B, constant float* mask,
+	const int width, const int height, const int radius, const int border, local float* tile) {
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int c = get_global_id(2);
+	int lx = get_local_id(0);
+	int ly = get_local_id(1);
+	int group_width = get_local_size(0);
+	int group_height = get_local_size(1);
+	int tile_width = group_width + 2*radius;
+	int tile_height = group_height + 2*radius;
+	int origin_x = get_group_id(0)*group_width - radius;
+	int origin_y = get_group_id(1)*group_height - radius;
+
+	global const PIXEL_T* plane = A + c*width*height;
+
+	//cooperative load: consecutive work items read consecutive pixels of each tile row
+	for (int i = lx + ly*group_width; i < tile_width*tile_height; i += group_width*group_height)
+		tile[i] = read_pixel(plane, origin_x + i % tile_width, origin_y + i / tile_width, width, height, border);
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	//work items past the image edge only help with the load
+	if ((x >= width) || (y >= height))
+		return;
+
+	int mask_size = 2*radius + 1;
+	float result = 0.0f;
+
+	for (int j = 0; j < mask_size; j++) {
+		local const float* row = tile + (ly + j)*tile_width + lx;
+		for (int i = 0; i < mask_size; i++)
+			result += row[i] * mask[i + j*mask_size];
+	}
+
+	B[x + y*width + c*width*height] = CONVERT_PIXEL(result);
+}
+
+//separable convolution, horizontal pass: the group's rows plus radius pixels either side are staged in local
+//memory; the result is kept as float for the vertical pass so that no rounding happens in between
+//global size as for convolution2D, tile: (get_local_size(0) + 2*radius) * get_local_size(1) floats
+kernel void convolution_rows(global const PIXEL_T* A, global float* B, constant float* mask,
+	const int width, const int height, const int radius, const int border, local float* tile) {
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int c = get_global_id(2);
+	int lx = get_local_id(0);
+	int ly = get_local_id(1);
+	int group_width = get_local_size(0);
+	int tile_width = group_width + 2*radius;
+	int origin_x = get_group_id(0)*group_width - radius;
+
+	global const PIXEL_T* plane = A + c*width*height;
+	local float* tile_row = tile + ly*tile_width;
+
+	for (int i = lx; i < tile_width; i += group_width)
+		tile_row[i] = read_pixel(plane, origin_x + i, y, width, height, border);
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if ((x >= width) || (y >= height))
+		return;
+
+	float result = 0.0f;
+	for (int i = 0; i <= 2*radius; i++)
+		result += tile_row[lx + i] * mask[i];
+
+	B[x + y*width + c*width*height] = result;
+}
+
+//separable convolution, vertical pass over the output of convolution_rows
+//global size as for convolution2D, tile: get_local_size(0) * (get_local_size(1) + 2*radius) floats
+kernel void convolution_columns(global const float* A, global PIXEL_T* B, constant float* mask,
+	const int width, const int height, const int radius, const int border, local float* tile) {
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int c = get_global_id(2);
+	int lx = get_local_id(0);
+	int ly = get_local_id(1);
+	int group_width = get_local_size(0);
+	int group_height = get_local_size(1);
+	int tile_height = group_height + 2*radius;
+	int origin_y = get_group_id(1)*group_height - radius;
+
+	global const float* plane = A + c*width*height;
+
+	for (int j = ly; j < tile_height; j += group_height)
+		tile[j*group_width + lx] = read_float(plane, x, origin_y + j, width, height, border);
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if ((x >= width) || (y >= height))
+		return;
+
+	float result = 0.0f;
+	for (int j = 0; j <= 2*radius; j++)
+		result += tile[(ly + j)*group_width + lx] * mask[j];
+
+	B[x + y*width + c*width*height] = CONVERT_PIXEL(result);
+}
@@ -0,0 +1,47 @@
+//image2d_t versions of identityND, avg_filterND and convolutionND from my_kernels.cl
+//each colour channel is a separate single-channel image (CL_R, CL_UNORM_INT8), so the kernels run over a
+//width x height range once per channel; read_imagef returns pixel values scaled to [0, 1] and write_imagef
+//converts back with rounding and saturation
+//border handling is done by the sampler passed from the host, which uses normalised coordinates so that the
+//mirrored addressing mode is available: pixel (x, y) is read at ((x + 0.5)/width, (y + 0.5)/height)
+
+float read_pixel(read_only image2d_t A, sampler_t sampler, int x, int y, float2 scale) {
+	return read_imagef(A, sampler, (float2)(x + 0.5f, y + 0.5f) * scale).x;
+}
+
+//simple 2D identity kernel
+kernel void identity_image(read_only image2d_t A, write_only image2d_t B, sampler_t sampler) {
+	int x = get_global_id(0); //current x coord.
+	int y = get_global_id(1); //current y coord.
+	float2 scale = (float2)(1.0f / get_image_width(A), 1.0f / get_image_height(A));
+
+	write_imagef(B, (int2)(x, y), (float4)(read_pixel(A, sampler, x, y, scale), 0.0f, 0.0f, 1.0f));
+}
+
+//3x3 averaging filter, the sampler takes care of the image edges
+kernel void avg_filter_image(read_only image2d_t A, write_only image2d_t B, sampler_t sampler) {
+	int x = get_global_id(0); //current x coord.
+	int y = get_global_id(1); //current y coord.
+	float2 scale = (float2)(1.0f / get_image_width(A), 1.0f / get_image_height(A));
+
+	float result = 0.0f;
+	for (int j = -1; j <= 1; j++)
+		for (int i = -1; i <= 1; i++)
+			result += read_pixel(A, sampler, x + i, y + j, scale);
+
+	write_imagef(B, (int2)(x, y), (float4)(result / 9.0f, 0.0f, 0.0f, 1.0f));
+}
+
+//3x3 convolution kernel, mask indexed as in convolutionND
+kernel void convolution_image(read_only image2d_t A, write_only image2d_t B, sampler_t sampler, constant float* mask) {
+	int x = get_global_id(0); //current x coord.
+	int y = get_global_id(1); //current y coord.
+	float2 scale = (float2)(1.0f / get_image_width(A), 1.0f / get_image_height(A));
+
+	float result = 0.0f;
+	for (int j = -1; j <= 1; j++)
+		for (int i = -1; i <= 1; i++)
+			result += read_pixel(A, sampler, x + i, y + j, scale) * mask[(i + 1) + (j + 1)*3];
+
+	write_imagef(B, (int2)(x, y), (float4)(result, 0.0f, 0.0f, 1.0f));
+}
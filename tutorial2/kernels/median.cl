@@ -0,0 +1,195 @@
+// Median filters for planar images, edges handled by clamping (the edge pixel is repeated).
+// Build options:
+//   -DPIXEL_T=uchar|ushort  pixel type
+//   -DPIXEL_BITS=8|16       bits per pixel; the histogram kernel is only built for 8
+// median3x3/median5x5 sort in registers with fixed selection networks, median_select handles any odd K with a
+// bitwise search for the median value, and median_histogram slides a 256-bin histogram along each row (Huang).
+
+#ifndef PIXEL_T
+#define PIXEL_T uchar
+#endif
+#ifndef PIXEL_BITS
+#define PIXEL_BITS 8
+#endif
+
+//compare-exchange: afterwards a <= b
+#define SORT2(a, b) { PIXEL_T t = min(a, b); b = max(a, b); a = t; }
+
+//stage the group's (local size + 2*radius)^2 tile in local memory, clamping at the image edges
+void load_tile(global const PIXEL_T* plane, local PIXEL_T* tile, int radius, int width, int height) {
+	int group_width = get_local_size(0);
+	int group_height = get_local_size(1);
+	int tile_width = group_width + 2*radius;
+	int tile_height = group_height + 2*radius;
+	int origin_x = get_group_id(0)*group_width - radius;
+	int origin_y = get_group_id(1)*group_height - radius;
+
+	for (int i = get_local_id(0) + get_local_id(1)*group_width; i < tile_width*tile_height; i += group_width*group_height) {
+		int x = clamp(origin_x + i % tile_width, 0, width - 1);
+		int y = clamp(origin_y + i / tile_width, 0, height - 1);
+		tile[i] = plane[x + y*width];
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+}
+
+//3x3 median with a 19 compare-exchange network
+//global size: width x height x channels rounded up to the local size, tile: (local size + 2)^2 pixels
+kernel void median3x3(global const PIXEL_T* A, global PIXEL_T* B, const int width, const int height, local PIXEL_T* tile) {
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int c = get_global_id(2);
+	int tile_width = get_local_size(0) + 2;
+
+	load_tile(A + c*width*height, tile, 1, width, height);
+	if ((x >= width) || (y >= height))
+		return;
+
+	PIXEL_T p[9];
+	for (int j = 0; j < 3; j++)
+		for (int i = 0; i < 3; i++)
+			p[i + j*3] = tile[(get_local_id(1) + j)*tile_width + get_local_id(0) + i];
+
+	SORT2(p[1], p[2]); SORT2(p[4], p[5]); SORT2(p[7], p[8]);
+	SORT2(p[0], p[1]); SORT2(p[3], p[4]); SORT2(p[6], p[7]);
+	SORT2(p[1], p[2]); SORT2(p[4], p[5]); SORT2(p[7], p[8]);
+	SORT2(p[0], p[3]); SORT2(p[5], p[8]); SORT2(p[4], p[7]);
+	SORT2(p[3], p[6]); SORT2(p[1], p[4]); SORT2(p[2], p[5]);
+	SORT2(p[4], p[7]); SORT2(p[4], p[2]); SORT2(p[6], p[4]);
+	SORT2(p[4], p[2]);
+
+	B[x + y*width + c*width*height] = p[4];
+}
+
+//5x5 median with a 99 compare-exchange network
+//global size: width x height x channels rounded up to the local size, tile: (local size + 4)^2 pixels
+kernel void median5x5(global const PIXEL_T* A, global PIXEL_T* B, const int width, const int height, local PIXEL_T* tile) {
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int c = get_global_id(2);
+	int tile_width = get_local_size(0) + 4;
+
+	load_tile(A + c*width*height, tile, 2, width, height);
+	if ((x >= width) || (y >= height))
+		return;
+
+	PIXEL_T p[25];
+	for (int j = 0; j < 5; j++)
+		for (int i = 0; i < 5; i++)
+			p[i + j*5] = tile[(get_local_id(1) + j)*tile_width + get_local_id(0) + i];
+
+	SORT2(p[0], p[1]);   SORT2(p[3], p[4]);   SORT2(p[2], p[4]);   SORT2(p[2], p[3]);   SORT2(p[6], p[7]);
+	SORT2(p[5], p[7]);   SORT2(p[5], p[6]);   SORT2(p[9], p[10]);  SORT2(p[8], p[10]);  SORT2(p[8], p[9]);
+	SORT2(p[12], p[13]); SORT2(p[11], p[13]); SORT2(p[11], p[12]); SORT2(p[15], p[16]); SORT2(p[14], p[16]);
+	SORT2(p[14], p[15]); SORT2(p[18], p[19]); SORT2(p[17], p[19]); SORT2(p[17], p[18]); SORT2(p[21], p[22]);
+	SORT2(p[20], p[22]); SORT2(p[20], p[21]); SORT2(p[23], p[24]); SORT2(p[2], p[5]);   SORT2(p[3], p[6]);
+	SORT2(p[0], p[6]);   SORT2(p[0], p[3]);   SORT2(p[4], p[7]);   SORT2(p[1], p[7]);   SORT2(p[1], p[4]);
+	SORT2(p[11], p[14]); SORT2(p[8], p[14]);  SORT2(p[8], p[11]);  SORT2(p[12], p[15]); SORT2(p[9], p[15]);
+	SORT2(p[9], p[12]);  SORT2(p[13], p[16]); SORT2(p[10], p[16]); SORT2(p[10], p[13]); SORT2(p[20], p[23]);
+	SORT2(p[17], p[23]); SORT2(p[17], p[20]); SORT2(p[21], p[24]); SORT2(p[18], p[24]); SORT2(p[18], p[21]);
+	SORT2(p[19], p[22]); SORT2(p[8], p[17]);  SORT2(p[9], p[18]);  SORT2(p[0], p[18]);  SORT2(p[0], p[9]);
+	SORT2(p[10], p[19]); SORT2(p[1], p[19]);  SORT2(p[1], p[10]);  SORT2(p[11], p[20]); SORT2(p[2], p[20]);
+	SORT2(p[2], p[11]);  SORT2(p[12], p[21]); SORT2(p[3], p[21]);  SORT2(p[3], p[12]);  SORT2(p[13], p[22]);
+	SORT2(p[4], p[22]);  SORT2(p[4], p[13]);  SORT2(p[14], p[23]); SORT2(p[5], p[23]);  SORT2(p[5], p[14]);
+	SORT2(p[15], p[24]); SORT2(p[6], p[24]);  SORT2(p[6], p[15]);  SORT2(p[7], p[16]);  SORT2(p[7], p[19]);
+	SORT2(p[13], p[21]); SORT2(p[15], p[23]); SORT2(p[7], p[13]);  SORT2(p[7], p[15]);  SORT2(p[1], p[9]);
+	SORT2(p[3], p[11]);  SORT2(p[5], p[17]);  SORT2(p[11], p[17]); SORT2(p[9], p[17]);  SORT2(p[4], p[10]);
+	SORT2(p[6], p[12]);  SORT2(p[7], p[14]);  SORT2(p[4], p[6]);   SORT2(p[4], p[7]);   SORT2(p[12], p[14]);
+	SORT2(p[10], p[14]); SORT2(p[6], p[7]);   SORT2(p[10], p[12]); SORT2(p[6], p[10]);  SORT2(p[6], p[17]);
+	SORT2(p[12], p[17]); SORT2(p[7], p[17]);  SORT2(p[7], p[10]);  SORT2(p[12], p[18]); SORT2(p[7], p[12]);
+	SORT2(p[10], p[18]); SORT2(p[12], p[20]); SORT2(p[10], p[20]); SORT2(p[10], p[12]);
+
+	B[x + y*width + c*width*height] = p[12];
+}
+
+//K x K median for any odd K: the median is built one bit at a time from the most significant bit down, keeping
+//a bit set while at most K*K/2 neighbours are smaller than the candidate; PIXEL_BITS passes over the tile
+//global size: width x height x channels rounded up to the local size, tile: (local size + 2*radius)^2 pixels
+kernel void median_select(global const PIXEL_T* A, global PIXEL_T* B, const int width, const int height, const int radius,
+	local PIXEL_T* tile) {
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int c = get_global_id(2);
+	int tile_width = get_local_size(0) + 2*radius;
+	int mask_size = 2*radius + 1;
+	int half_count = mask_size*mask_size/2;
+
+	load_tile(A + c*width*height, tile, radius, width, height);
+	if ((x >= width) || (y >= height))
+		return;
+
+	uint median = 0;
+	for (int bit = PIXEL_BITS - 1; bit >= 0; bit--) {
+		uint candidate = median | (1u << bit);
+		int smaller = 0;
+		for (int j = 0; j < mask_size; j++) {
+			local const PIXEL_T* row = tile + (get_local_id(1) + j)*tile_width + get_local_id(0);
+			for (int i = 0; i < mask_size; i++)
+				smaller += (row[i] < candidate);
+		}
+		if (smaller <= half_count)
+			median = candidate;
+	}
+
+	B[x + y*width + c*width*height] = (PIXEL_T)median;
+}
+
+#if PIXEL_BITS == 8
+//K x K median for 8-bit data with Huang's sliding histogram: each work item filters a strip of pixels of one row,
+//building the histogram of the first window and then moving right one column at a time (2*K updates per pixel),
+//tracking the median and the number of window pixels below it
+//global size: (strips per row * height) rounded up to the local size x channels, local size: (G, 1)
+//histograms: G*256 ushorts (one histogram per work item, K*K must be below 65536)
+kernel void median_histogram(global const uchar* A, global uchar* B, const int width, const int height, const int radius,
+	const int strip, local ushort* histograms) {
+	int strips = (width + strip - 1)/strip;
+	int id = get_global_id(0);
+	int c = get_global_id(1);
+	if (id >= strips*height)
+		return;
+
+	int y = id / strips;
+	int x_begin = (id % strips)*strip;
+	int x_end = min(x_begin + strip, width);
+	global const uchar* plane = A + c*width*height;
+	local ushort* histogram = histograms + get_local_id(0)*256;
+	int half_count = (2*radius + 1)*(2*radius + 1)/2;
+
+	for (int v = 0; v < 256; v++)
+		histogram[v] = 0;
+
+	//window of the first pixel
+	for (int j = -radius; j <= radius; j++) {
+		global const uchar* row = plane + clamp(y + j, 0, height - 1)*width;
+		for (int i = -radius; i <= radius; i++)
+			histogram[row[clamp(x_begin + i, 0, width - 1)]]++;
+	}
+
+	//median = smallest value with more than half_count pixels at or below it
+	int median = 0, below = 0;
+	while (below + histogram[median] <= half_count)
+		below += histogram[median++];
+	B[x_begin + y*width + c*width*height] = median;
+
+	for (int x = x_begin + 1; x < x_end; x++) {
+		int x_out = clamp(x - radius - 1, 0, width - 1);
+		int x_in = clamp(x + radius, 0, width - 1);
+		for (int j = -radius; j <= radius; j++) {
+			global const uchar* row = plane + clamp(y + j, 0, height - 1)*width;
+			uchar v_out = row[x_out], v_in = row[x_in];
+			histogram[v_out]--;
+			if (v_out < median) below--;
+			histogram[v_in]++;
+			if (v_in < median) below++;
+		}
+
+		//move the median down or up until half_count pixels are below it and more are at or below it
+		while (below > half_count)
+			below -= histogram[--median];
+		while (below + histogram[median] <= half_count)
+			below += histogram[median++];
+
+		B[x + y*width + c*width*height] = median;
+	}
+}
+#endif
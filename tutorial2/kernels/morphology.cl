@@ -0,0 +1,123 @@
+// Grey-level erosion (min) and dilation (max) of planar images with rectangular structuring elements, as
+// separable row and column passes using the van Herk/Gil-Werman algorithm: the line is cut into blocks of
+// K pixels, a running min/max is taken forwards (g) and backwards (h) inside each block, and the result for
+// the window [x - r, x + r] is op(h[x - r], g[x + r]). That is three operations per pixel whatever K is. Each work
+// group covers a segment of many pixels per line (a multiple of K, several per work item), so that the 2*radius halo
+// it loads and scans as well stays a small fraction of the segment.
+// Pixels outside the image are ignored (padded with the identity of the operation).
+// Build options:
+//   -DPIXEL_T=uchar|ushort
+
+#ifndef PIXEL_T
+#define PIXEL_T uchar
+#endif
+
+#define PIXEL_MAX ((PIXEL_T)~(PIXEL_T)0)
+
+PIXEL_T morph_op(PIXEL_T a, PIXEL_T b, int dilate) {
+	return dilate ? max(a, b) : min(a, b);
+}
+
+//in-place forward (g) and backward (h) scans of every K-pixel block of the lines held in local memory:
+//line l starts at l*line_stride, consecutive pixels are element_stride apart, each line is blocks*K long
+void vhgw_blocks(local PIXEL_T* g, local PIXEL_T* h, int lines, int blocks, int K, int line_stride, int element_stride, int dilate) {
+	int group_size = get_local_size(0)*get_local_size(1);
+	for (int task = get_local_id(0) + get_local_id(1)*get_local_size(0); task < lines*blocks*2; task += group_size) {
+		int line = task / (blocks*2);
+		int block = (task / 2) % blocks;
+		int first = line*line_stride + block*K*element_stride;
+		if (task & 1) {
+			for (int i = K - 2; i >= 0; i--)
+				h[first + i*element_stride] = morph_op(h[first + i*element_stride], h[first + (i + 1)*element_stride], dilate);
+		} else {
+			for (int i = 1; i < K; i++)
+				g[first + i*element_stride] = morph_op(g[first + i*element_stride], g[first + (i - 1)*element_stride], dilate);
+		}
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+}
+
+//horizontal pass, window 2*radius + 1 = K: each group writes segment pixels of each of its rows, staged with radius
+//pixels either side and padded to a whole number of blocks (tile_width = K*ceil((segment + 2*radius)/K))
+//global size: ceil(width/segment)*local size 0 x height x channels (height rounded up to the local size),
+//g and h: tile_width*get_local_size(1) pixels each
+kernel void morph_rows(global const PIXEL_T* A, global PIXEL_T* B, const int width, const int height, const int radius,
+	const int dilate, const int segment, const int tile_width, local PIXEL_T* g, local PIXEL_T* h) {
+	int y = get_global_id(1);
+	int c = get_global_id(2);
+	int lx = get_local_id(0);
+	int ly = get_local_id(1);
+	int K = 2*radius + 1;
+	int start_x = get_group_id(0)*segment;
+	int origin_x = start_x - radius;
+	int row = min(y, height - 1);
+	global const PIXEL_T* line = A + c*width*height + row*width;
+	PIXEL_T identity = dilate ? 0 : PIXEL_MAX;
+
+	for (int i = lx; i < tile_width; i += get_local_size(0)) {
+		int tx = origin_x + i;
+		PIXEL_T value = ((tx >= 0) && (tx < width)) ? line[tx] : identity;
+		g[ly*tile_width + i] = value;
+		h[ly*tile_width + i] = value;
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	vhgw_blocks(g, h, get_local_size(1), tile_width / K, K, tile_width, 1, dilate);
+
+	if (y < height) {
+		for (int i = lx; (i < segment) && (start_x + i < width); i += get_local_size(0))
+			B[start_x + i + y*width + c*width*height] = morph_op(h[ly*tile_width + i], g[ly*tile_width + i + K - 1], dilate);
+	}
+}
+
+//vertical pass: each group writes segment pixels of each of its columns, staged with radius pixels above and below
+//and padded to whole blocks (tile_height = K*ceil((segment + 2*radius)/K)), stored row by row so that loads stay
+//coalesced
+//global size: width (rounded up to the local size) x ceil(height/segment)*local size 1 x channels,
+//g and h: get_local_size(0)*tile_height pixels each
+kernel void morph_columns(global const PIXEL_T* A, global PIXEL_T* B, const int width, const int height, const int radius,
+	const int dilate, const int segment, const int tile_height, local PIXEL_T* g, local PIXEL_T* h) {
+	int x = get_global_id(0);
+	int c = get_global_id(2);
+	int lx = get_local_id(0);
+	int ly = get_local_id(1);
+	int group_width = get_local_size(0);
+	int K = 2*radius + 1;
+	int start_y = get_group_id(1)*segment;
+	int origin_y = start_y - radius;
+	int column = min(x, width - 1);
+	global const PIXEL_T* plane = A + c*width*height;
+	PIXEL_T identity = dilate ? 0 : PIXEL_MAX;
+
+	for (int j = ly; j < tile_height; j += get_local_size(1)) {
+		int ty = origin_y + j;
+		PIXEL_T value = ((ty >= 0) && (ty < height)) ? plane[column + ty*width] : identity;
+		g[j*group_width + lx] = value;
+		h[j*group_width + lx] = value;
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	vhgw_blocks(g, h, group_width, tile_height / K, K, 1, group_width, dilate);
+
+	if (x < width) {
+		for (int j = ly; (j < segment) && (start_y + j < height); j += get_local_size(1))
+			B[x + (start_y + j)*width + c*width*height] = morph_op(h[j*group_width + lx], g[(j + K - 1)*group_width + lx], dilate);
+	}
+}
+
+//reference: min/max over the whole (2*radius_x + 1) x (2*radius_y + 1) window, K^2 reads per pixel
+//global size: width x height x channels
+kernel void morph_naive(global const PIXEL_T* A, global PIXEL_T* B, const int width, const int height,
+	const int radius_x, const int radius_y, const int dilate) {
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int c = get_global_id(2);
+	global const PIXEL_T* plane = A + c*width*height;
+
+	PIXEL_T result = dilate ? 0 : PIXEL_MAX;
+	for (int j = max(y - radius_y, 0); j <= min(y + radius_y, height - 1); j++)
+		for (int i = max(x - radius_x, 0); i <= min(x + radius_x, width - 1); i++)
+			result = morph_op(result, plane[i + j*width], dilate);
+
+	B[x + y*width + c*width*height] = result;
+}
@@ -56,6 +56,44 @@ kernel void rgb2grey(global const uchar* A, global uchar* B) {
 	}
 }
 
+//rgb -> grey (BT.709 luma) with one work item per 4 pixels and a single-channel output
+//planar input (as stored by CImg): the r, g and b planes are image_size bytes each
+//global size: (image_size + 3)/4
+kernel void rgb2grey_planar(global const uchar* A, global uchar* B, const int image_size) {
+	int id = get_global_id(0);
+	int pixel = id*4;
+
+	if (pixel + 4 <= image_size) {
+		float4 r = convert_float4(vload4(id, A));
+		float4 g = convert_float4(vload4(id, A + image_size));
+		float4 b = convert_float4(vload4(id, A + image_size*2));
+		vstore4(convert_uchar4_sat_rte(r*0.2126f + g*0.7152f + b*0.0722f), id, B);
+	} else {
+		//last few pixels when image_size is not a multiple of 4
+		for (; pixel < image_size; pixel++)
+			B[pixel] = convert_uchar_sat_rte(A[pixel]*0.2126f + A[pixel + image_size]*0.7152f + A[pixel + image_size*2]*0.0722f);
+	}
+}
+
+//same for interleaved input (rgbrgb...): 4 pixels are 12 bytes, loaded as three uchar4 and shuffled
+kernel void rgb2grey_interleaved(global const uchar* A, global uchar* B, const int image_size) {
+	int id = get_global_id(0);
+	int pixel = id*4;
+
+	if (pixel + 4 <= image_size) {
+		uchar4 p0 = vload4(id*3, A); //r0 g0 b0 r1
+		uchar4 p1 = vload4(id*3 + 1, A); //g1 b1 r2 g2
+		uchar4 p2 = vload4(id*3 + 2, A); //b2 r3 g3 b3
+		float4 r = convert_float4((uchar4)(p0.s0, p0.s3, p1.s2, p2.s1));
+		float4 g = convert_float4((uchar4)(p0.s1, p1.s0, p1.s3, p2.s2));
+		float4 b = convert_float4((uchar4)(p0.s2, p1.s1, p2.s0, p2.s3));
+		vstore4(convert_uchar4_sat_rte(r*0.2126f + g*0.7152f + b*0.0722f), id, B);
+	} else {
+		for (; pixel < image_size; pixel++)
+			B[pixel] = convert_uchar_sat_rte(A[pixel*3]*0.2126f + A[pixel*3 + 1]*0.7152f + A[pixel*3 + 2]*0.0722f);
+	}
+}
+
 //simple ND identity kernel
 kernel void identityND(global const uchar* A, global uchar* B) {
 	int width = get_global_size(0); //image width in pixels
@@ -122,7 +160,7 @@ kernel void convolutionND(global const uchar* A, global uchar* B, constant float
 	} else {
 		for (int i = (x-1); i <= (x+1); i++)
 		for (int j = (y-1); j <= (y+1); j++) 
-			result += A[i + j*width + c*image_size]*mask[i-(x-1) + j-(y-1)];
+			result += A[i + j*width + c*image_size]*mask[(i-(x-1)) + (j-(y-1))*3];
 	}
 
 	B[id] = (uchar)result;
@@ -0,0 +1,110 @@
+// Resampling of planar images to a new width and height. Pixel centres are aligned, so that output pixel x
+// samples the input at (x + 0.5)*in_width/out_width - 0.5, and edges are clamped.
+// resize_area averages every input pixel under the output pixel's footprint, weighted by how much of it is
+// covered, which is the one to use for downscaling; the interpolating kernels skip pixels when shrinking.
+// Build options:
+//   -DPIXEL_T=uchar|ushort|float
+//   -DCONVERT_PIXEL=convert_uchar_sat_rte|convert_ushort_sat_rte|convert_float
+// global size: out_width x out_height x channels
+
+#ifndef PIXEL_T
+#define PIXEL_T uchar
+#define CONVERT_PIXEL convert_uchar_sat_rte
+#endif
+
+kernel void resize_nearest(global const PIXEL_T* A, global PIXEL_T* B, const int in_width, const int in_height,
+	const int out_width, const int out_height) {
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int c = get_global_id(2);
+	int sx = min((int)((x + 0.5f)*in_width/out_width), in_width - 1);
+	int sy = min((int)((y + 0.5f)*in_height/out_height), in_height - 1);
+
+	B[x + y*out_width + c*out_width*out_height] = A[sx + sy*in_width + c*in_width*in_height];
+}
+
+kernel void resize_bilinear(global const PIXEL_T* A, global PIXEL_T* B, const int in_width, const int in_height,
+	const int out_width, const int out_height) {
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int c = get_global_id(2);
+	global const PIXEL_T* plane = A + c*in_width*in_height;
+
+	float sx = clamp((x + 0.5f)*in_width/out_width - 0.5f, 0.0f, (float)(in_width - 1));
+	float sy = clamp((y + 0.5f)*in_height/out_height - 0.5f, 0.0f, (float)(in_height - 1));
+	int x0 = (int)sx, y0 = (int)sy;
+	int x1 = min(x0 + 1, in_width - 1), y1 = min(y0 + 1, in_height - 1);
+	float fx = sx - x0, fy = sy - y0;
+
+	float top = (1.0f - fx)*plane[x0 + y0*in_width] + fx*plane[x1 + y0*in_width];
+	float bottom = (1.0f - fx)*plane[x0 + y1*in_width] + fx*plane[x1 + y1*in_width];
+
+	B[x + y*out_width + c*out_width*out_height] = CONVERT_PIXEL((1.0f - fy)*top + fy*bottom);
+}
+
+//Keys cubic convolution weight (a = -0.5, Catmull-Rom) for distance t
+float cubic_weight(float t) {
+	t = fabs(t);
+	if (t <= 1.0f)
+		return (1.5f*t - 2.5f)*t*t + 1.0f;
+	if (t < 2.0f)
+		return ((-0.5f*t + 2.5f)*t - 4.0f)*t + 2.0f;
+	return 0.0f;
+}
+
+//4x4 taps; the result may overshoot the input range near edges and is saturated by CONVERT_PIXEL
+kernel void resize_bicubic(global const PIXEL_T* A, global PIXEL_T* B, const int in_width, const int in_height,
+	const int out_width, const int out_height) {
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int c = get_global_id(2);
+	global const PIXEL_T* plane = A + c*in_width*in_height;
+
+	float sx = (x + 0.5f)*in_width/out_width - 0.5f;
+	float sy = (y + 0.5f)*in_height/out_height - 0.5f;
+	int x0 = (int)floor(sx), y0 = (int)floor(sy);
+	float wx[4], wy[4];
+	for (int i = 0; i < 4; i++) {
+		wx[i] = cubic_weight(sx - (x0 - 1 + i));
+		wy[i] = cubic_weight(sy - (y0 - 1 + i));
+	}
+
+	float sum = 0.0f;
+	for (int j = 0; j < 4; j++) {
+		global const PIXEL_T* row = plane + clamp(y0 - 1 + j, 0, in_height - 1)*in_width;
+		float row_sum = 0.0f;
+		for (int i = 0; i < 4; i++)
+			row_sum += wx[i]*row[clamp(x0 - 1 + i, 0, in_width - 1)];
+		sum += wy[j]*row_sum;
+	}
+
+	B[x + y*out_width + c*out_width*out_height] = CONVERT_PIXEL(sum);
+}
+
+//output pixel (x, y) covers [x, x + 1)*in_width/out_width by [y, y + 1)*in_height/out_height of the input
+kernel void resize_area(global const PIXEL_T* A, global PIXEL_T* B, const int in_width, const int in_height,
+	const int out_width, const int out_height) {
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int c = get_global_id(2);
+	global const PIXEL_T* plane = A + c*in_width*in_height;
+
+	float scale_x = (float)in_width/out_width, scale_y = (float)in_height/out_height;
+	float left = x*scale_x, right = min((x + 1)*scale_x, (float)in_width);
+	float top = y*scale_y, bottom = min((y + 1)*scale_y, (float)in_height);
+
+	float sum = 0.0f, area = 0.0f;
+	for (int j = (int)top; j < (int)ceil(bottom); j++) {
+		float wy = min(j + 1.0f, bottom) - max((float)j, top);
+		float row_sum = 0.0f, row_weight = 0.0f;
+		for (int i = (int)left; i < (int)ceil(right); i++) {
+			float wx = min(i + 1.0f, right) - max((float)i, left);
+			row_sum += wx*plane[i + j*in_width];
+			row_weight += wx;
+		}
+		sum += wy*row_sum;
+		area += wy*row_weight;
+	}
+
+	B[x + y*out_width + c*out_width*out_height] = CONVERT_PIXEL(sum/area);
+}
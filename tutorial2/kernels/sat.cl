@@ -0,0 +1,87 @@
+// Box filter of any radius through a summed-area table (SAT) of a planar image:
+// S(x, y) = sum of all pixels (i, j) with i <= x and j <= y, per channel. Any box sum is then
+// S(x1, y1) - S(x0-1, y1) - S(x1, y0-1) + S(x0-1, y0-1), four reads whatever the radius.
+// Build options:
+//   -DPIXEL_T=uchar|ushort  pixel type
+//   -DSUM_T=uint|ulong      accumulator, wide enough for the sum of a whole channel
+
+#ifndef PIXEL_T
+#define PIXEL_T uchar
+#endif
+#ifndef SUM_T
+#define SUM_T uint
+#endif
+
+//stage 1: inclusive scan of every row, one work group per row and channel, the row is scanned in chunks of
+//the work-group size with a running carry (Hillis-Steele in local memory)
+//global size: local size x height x channels, scratch: local size elements
+kernel void sat_rows(global const PIXEL_T* A, global SUM_T* S, const int width, const int height, local SUM_T* scratch) {
+	int lid = get_local_id(0);
+	int group_size = get_local_size(0);
+	int y = get_global_id(1);
+	int c = get_global_id(2);
+	size_t row = ((size_t)c*height + y)*width;
+	SUM_T carry = 0;
+
+	for (int base = 0; base < width; base += group_size) {
+		int x = base + lid;
+		scratch[lid] = (x < width) ? (SUM_T)A[row + x] : 0;
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		for (int stride = 1; stride < group_size; stride *= 2) {
+			SUM_T value = (lid >= stride) ? scratch[lid - stride] : 0;
+			barrier(CLK_LOCAL_MEM_FENCE);
+			scratch[lid] += value;
+			barrier(CLK_LOCAL_MEM_FENCE);
+		}
+
+		if (x < width)
+			S[row + x] = carry + scratch[lid];
+		carry += scratch[group_size - 1];
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+}
+
+//stage 2: inclusive scan of every column in place, one work item per column walking down the image; at each
+//step neighbouring work items touch neighbouring addresses, so the accesses stay coalesced without a transpose
+//global size: width x channels
+kernel void sat_columns(global SUM_T* S, const int width, const int height) {
+	int x = get_global_id(0);
+	int c = get_global_id(1);
+	if (x >= width)
+		return;
+
+	global SUM_T* column = S + (size_t)c*width*height + x;
+	SUM_T sum = 0;
+	for (int y = 0; y < height; y++) {
+		sum += column[(size_t)y*width];
+		column[(size_t)y*width] = sum;
+	}
+}
+
+//SAT entry with S(-1, y) = S(x, -1) = 0
+SUM_T sat_at(global const SUM_T* plane, int x, int y, int width) {
+	return ((x < 0) || (y < 0)) ? 0 : plane[(size_t)y*width + x];
+}
+
+//stage 3: mean over a (2*radius_x + 1) x (2*radius_y + 1) box from four SAT reads per pixel; near the edges the
+//box is cut to the image and the mean taken over the pixels inside it
+//global size: width x height x channels
+kernel void box_filter(global const SUM_T* S, global PIXEL_T* B, const int width, const int height,
+	const int radius_x, const int radius_y) {
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int c = get_global_id(2);
+	if ((x >= width) || (y >= height))
+		return;
+
+	global const SUM_T* plane = S + (size_t)c*width*height;
+	int x0 = max(x - radius_x, 0) - 1, x1 = min(x + radius_x, width - 1);
+	int y0 = max(y - radius_y, 0) - 1, y1 = min(y + radius_y, height - 1);
+
+	SUM_T sum = sat_at(plane, x1, y1, width) - sat_at(plane, x0, y1, width) - sat_at(plane, x1, y0, width) + sat_at(plane, x0, y0, width);
+	SUM_T area = (SUM_T)(x1 - x0)*(y1 - y0);
+
+	//integer division with rounding, exact for both accumulator types
+	B[(size_t)c*width*height + (size_t)y*width + x] = (PIXEL_T)((sum + area/2)/area);
+}
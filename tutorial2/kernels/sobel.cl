@@ -0,0 +1,97 @@
+// Sobel edge detection for planar images in one pass: each work group loads its tile once and every work
+// item computes Gx, Gy, the gradient magnitude and its direction in registers. An optional second pass
+// thins the edges with non-maximum suppression. Edges are clamped.
+// Build options:
+//   -DPIXEL_T=uchar|ushort|float
+//   -DCONVERT_PIXEL=convert_uchar_sat_rte|convert_ushort_sat_rte|convert_float  magnitude conversion
+
+#ifndef PIXEL_T
+#define PIXEL_T uchar
+#define CONVERT_PIXEL convert_uchar_sat_rte
+#endif
+
+//gradient direction quantised to 4 sectors, named after the direction of the gradient (normal to the edge)
+#define DIRECTION_0 0   //horizontal
+#define DIRECTION_45 1  //down-right / up-left (y grows downwards)
+#define DIRECTION_90 2  //vertical
+#define DIRECTION_135 3 //down-left / up-right
+
+#define TAN_22_5 0.41421356f
+#define TAN_67_5 2.41421356f
+
+//magnitude = scale*sqrt(Gx^2 + Gy^2), direction written only if write_direction is set
+//global size: width x height x channels rounded up to the local size, tile: (local size + 2)^2 floats
+kernel void sobel(global const PIXEL_T* A, global PIXEL_T* magnitude, global uchar* direction, const int width, const int height,
+	const float scale, const int write_direction, local float* tile) {
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int c = get_global_id(2);
+	int lx = get_local_id(0);
+	int ly = get_local_id(1);
+	int group_width = get_local_size(0);
+	int group_height = get_local_size(1);
+	int tile_width = group_width + 2;
+	int origin_x = get_group_id(0)*group_width - 1;
+	int origin_y = get_group_id(1)*group_height - 1;
+	global const PIXEL_T* plane = A + c*width*height;
+
+	for (int i = lx + ly*group_width; i < tile_width*(group_height + 2); i += group_width*group_height) {
+		int tx = clamp(origin_x + i % tile_width, 0, width - 1);
+		int ty = clamp(origin_y + i / tile_width, 0, height - 1);
+		tile[i] = (float)plane[tx + ty*width];
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if ((x >= width) || (y >= height))
+		return;
+
+	//3x3 neighbourhood, p[row][column]
+	local const float* t = tile + ly*tile_width + lx;
+	float p00 = t[0], p01 = t[1], p02 = t[2];
+	float p10 = t[tile_width], p12 = t[tile_width + 2];
+	float p20 = t[2*tile_width], p21 = t[2*tile_width + 1], p22 = t[2*tile_width + 2];
+
+	float gx = (p02 + 2.0f*p12 + p22) - (p00 + 2.0f*p10 + p20);
+	float gy = (p20 + 2.0f*p21 + p22) - (p00 + 2.0f*p01 + p02);
+
+	int id = x + y*width + c*width*height;
+	magnitude[id] = CONVERT_PIXEL(scale*sqrt(gx*gx + gy*gy));
+
+	if (write_direction) {
+		float ax = fabs(gx), ay = fabs(gy);
+		uchar sector;
+		if (ay <= TAN_22_5*ax)
+			sector = DIRECTION_0;
+		else if (ay >= TAN_67_5*ax)
+			sector = DIRECTION_90;
+		else
+			sector = ((gx > 0.0f) == (gy > 0.0f)) ? DIRECTION_45 : DIRECTION_135;
+		direction[id] = sector;
+	}
+}
+
+//non-maximum suppression: keep a pixel only if its magnitude is a maximum along its gradient direction
+//(>= the neighbour behind, > the neighbour ahead, so that plateaus keep one pixel)
+//global size: width x height x channels
+kernel void sobel_nms(global const PIXEL_T* magnitude, global const uchar* direction, global PIXEL_T* B, const int width, const int height) {
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int c = get_global_id(2);
+	int id = x + y*width + c*width*height;
+	global const PIXEL_T* plane = magnitude + c*width*height;
+
+	int dx, dy;
+	switch (direction[id]) {
+	case DIRECTION_0: dx = 1; dy = 0; break;
+	case DIRECTION_45: dx = 1; dy = 1; break;
+	case DIRECTION_90: dx = 0; dy = 1; break;
+	default: dx = -1; dy = 1; break;
+	}
+
+	PIXEL_T m = magnitude[id];
+	PIXEL_T ahead = plane[clamp(x + dx, 0, width - 1) + clamp(y + dy, 0, height - 1)*width];
+	PIXEL_T behind = plane[clamp(x - dx, 0, width - 1) + clamp(y - dy, 0, height - 1)*width];
+
+	B[id] = ((m >= behind) && (m > ahead)) ? m : (PIXEL_T)0;
+}
@@ -3,6 +3,15 @@
 
 #include "Utils.h"
 #include "CImg.h"
+#include "Convolution.h"
+#include "ImageFilters.h"
+#include "PointOps.h"
+#include "BoxFilter.h"
+#include "Median.h"
+#include "Sobel.h"
+#include "Morphology.h"
+#include "Bilateral.h"
+#include "Resize.h"
 
 using namespace cimg_library;
 
@@ -10,26 +19,362 @@ void print_help() {
 	std::cerr << "Application usage:" << std::endl;
 
 	std::cerr << "  -p : select platform " << std::endl;
-	std::cerr << "  -d : select device" << std::endl;
+	std::cerr << "  -d : select device (index on the platform, cpu, gpu, accelerator, fastest or part of a device name)" << std::endl;
 	std::cerr << "  -l : list all platforms and devices" << std::endl;
 	std::cerr << "  -f : input image file (default: test.pgm)" << std::endl;
+	std::cerr << "  -x : transfer mode (copy, pinned, mapped, zerocopy, auto; default: copy)" << std::endl;
+	std::cerr << "  -X : benchmark all transfer modes at the image size and exit" << std::endl;
+	std::cerr << "  -k : operation (rgb2grey, conv, identityND, avg_filterND, convolutionND, pointops, box, median, sobel, erode, dilate, open, close, bilateral, resize; default: rgb2grey)" << std::endl;
+	std::cerr << "  -N : thin sobel edges with non-maximum suppression" << std::endl;
+	std::cerr << "  -t : pixel type for conv, sobel and resize (uchar, ushort, float), box, median, morphology and bilateral (uchar, ushort); default: uchar" << std::endl;
+	std::cerr << "  -m : mask size for conv, box, median and morphology, odd (default: 3)" << std::endl;
+	std::cerr << "  -M : mask type for conv (avg, gauss, sharpen; default: avg)" << std::endl;
+	std::cerr << "  -e : border mode for conv (clamp, mirror, zero; default: clamp)" << std::endl;
+	std::cerr << "  -s : spatial sigma for bilateral, pixels (default: 3)" << std::endl;
+	std::cerr << "  -r : range sigma for bilateral, 8-bit intensity levels (default: 25)" << std::endl;
+	std::cerr << "  -G : bilateral grid instead of the direct bilateral filter" << std::endl;
+	std::cerr << "  -z : scale factor for resize (default: 0.5)" << std::endl;
+	std::cerr << "  -R : resize method (nearest, bilinear, bicubic, area; default: area)" << std::endl;
+	std::cerr << "  -c : chain for pointops, e.g. grey,gain:1.5:-40,gamma:2.2,invert,threshold:100 (see PointOps.h)" << std::endl;
+	std::cerr << "  -i : interleaved (rgbrgb...) input for rgb2grey instead of planar" << std::endl;
+	std::cerr << "  -S : storage for identityND, avg_filterND, convolutionND (buffer, image; default: buffer)" << std::endl;
+	std::cerr << "  -b : benchmark the selected operation and exit" << std::endl;
 	std::cerr << "  -h : print this message" << std::endl;
 }
 
+//run the convolution engine on the image converted to pixel type T, returning an 8-bit image for display
+template <typename T>
+CImg<unsigned char> RunConvolution(const cl::Context& context, const cl::CommandQueue& queue, const CImg<unsigned char>& image_input,
+	const std::vector<float>& mask, BorderMode border, TransferMode transfer_mode) {
+	CImg<T> image = FromImage8<T>(image_input);
+	size_t image_bytes = image.size()*sizeof(T);
+
+	Convolution<T> convolution(context);
+	TransferBuffer dev_image_input(context, CL_MEM_READ_ONLY, image_bytes, transfer_mode);
+	TransferBuffer dev_image_output(context, CL_MEM_READ_WRITE, image_bytes, transfer_mode);
+	dev_image_input.write(queue, image.data(), image_bytes);
+
+	std::vector<cl::Event> events;
+	convolution.apply(queue, dev_image_input.buffer(), dev_image_output.buffer(), image.width(), image.height(), image.spectrum(),
+		mask, border, &events);
+	dev_image_output.read(queue, image.data(), image_bytes);
+
+	//rank-1 masks run as two 1D passes; time the 2D kernel as well for comparison
+	std::vector<float> column, row;
+	if (SeparateMask(mask, column, row) && convolution.tiled_separable((int)row.size())) {
+		std::vector<cl::Event> events_2d;
+		convolution.apply_2d(queue, dev_image_input.buffer(), dev_image_output.buffer(), image.width(), image.height(), image.spectrum(),
+			mask, border, &events_2d);
+		std::cout << "Convolution (" << PixelTraits<T>::name() << ", separable) kernel execution time [ns]: "
+			<< GetExecutionTime(events, PROF_NS) << std::endl;
+		std::cout << "Convolution (" << PixelTraits<T>::name() << ", 2D) kernel execution time [ns]: "
+			<< GetExecutionTime(events_2d, PROF_NS) << std::endl;
+	}
+	else {
+		std::cout << "Convolution (" << PixelTraits<T>::name() << ", 2D, mask not separable) kernel execution time [ns]: "
+			<< GetExecutionTime(events, PROF_NS) << std::endl;
+	}
+
+	return ToImage8(image);
+}
+
+//run identityND, avg_filterND or convolutionND (3x3 mask) on buffers, or their image2d_t versions
+CImg<unsigned char> RunFilter(const cl::Context& context, const cl::CommandQueue& queue, const cl::Program& program, const CImg<unsigned char>& image_input,
+	const string& operation, StorageMode storage, const std::vector<float>& mask, BorderMode border, TransferMode transfer_mode) {
+	CImg<unsigned char> output_image(image_input.width(), image_input.height(), image_input.depth(), image_input.spectrum());
+	cl::Buffer dev_mask(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, mask.size()*sizeof(float), (void*)&mask[0]);
+	std::vector<cl::Event> events;
+
+	if ((storage == STORAGE_IMAGE) && !ImageFilters::supported(context)) {
+		std::cout << "CL_R / CL_UNORM_INT8 images are not supported by this device, using buffer storage" << std::endl;
+		storage = STORAGE_BUFFER;
+	}
+
+	if (storage == STORAGE_IMAGE) {
+		ImageFilters filters(context);
+		std::vector<cl::Image2D> dev_image_input = filters.upload(image_input);
+		std::vector<cl::Image2D> dev_image_output = filters.create(image_input.width(), image_input.height(), image_input.spectrum());
+		string kernel_name = (operation == "identityND") ? "identity_image" : (operation == "avg_filterND") ? "avg_filter_image" : "convolution_image";
+		filters.run(queue, kernel_name, dev_image_input, dev_image_output, border, (operation == "convolutionND") ? &dev_mask : NULL, &events);
+		filters.download(queue, dev_image_output, output_image);
+	}
+	else {
+		TransferBuffer dev_image_input(context, CL_MEM_READ_ONLY, image_input.size(), transfer_mode);
+		TransferBuffer dev_image_output(context, CL_MEM_READ_WRITE, image_input.size(), transfer_mode);
+		dev_image_input.write(queue, image_input.data(), image_input.size());
+
+		cl::Kernel kernel(program, operation.c_str());
+		kernel.setArg(0, dev_image_input.buffer());
+		kernel.setArg(1, dev_image_output.buffer());
+		if (operation == "convolutionND") kernel.setArg(2, dev_mask);
+		events.resize(1);
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(image_input.width(), image_input.height(), image_input.spectrum()),
+			cl::NullRange, NULL, &events[0]);
+
+		dev_image_output.read(queue, output_image.data(), output_image.size());
+	}
+
+	std::cout << operation << " (" << ((storage == STORAGE_IMAGE) ? "image" : "buffer") << ") kernel execution time [ns]: "
+		<< GetExecutionTime(events, PROF_NS) << std::endl;
+
+	return output_image;
+}
+
+//per-byte rgb2grey (3-channel output) against the per-pixel planar and interleaved kernels (1-channel output)
+string BenchmarkGrey(const cl::Context& context, const cl::CommandQueue& queue, const cl::Program& program, const CImg<unsigned char>& image_input,
+	int repeats = 10) {
+	const char* kernel_names[] = { "rgb2grey", "rgb2grey_planar", "rgb2grey_interleaved" };
+	int image_size = image_input.width()*image_input.height();
+	std::stringstream sstream;
+
+	cl::Buffer dev_image_input(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, image_input.size(), (void*)image_input.data());
+	cl::Buffer dev_image_output(context, CL_MEM_READ_WRITE, image_input.size());
+
+	sstream << "rgb2grey benchmark, " << image_input.width() << "x" << image_input.height() << ", " << repeats << " repeats:" << std::endl;
+	for (int k = 0; k < 3; k++) {
+		cl::Kernel kernel(program, kernel_names[k]);
+		kernel.setArg(0, dev_image_input);
+		kernel.setArg(1, dev_image_output);
+		if (k > 0) kernel.setArg(2, image_size);
+		size_t work_items = (k == 0) ? image_input.size() : (image_size + 3)/4;
+		size_t bytes_written = (k == 0) ? image_input.size() : image_size;
+
+		double time = 0;
+		for (int i = 0; i <= repeats; i++) { //the first run is a warm up
+			std::vector<cl::Event> events(1);
+			queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(work_items), cl::NullRange, NULL, &events[0]);
+			double t = GetExecutionTime(events);
+			if (i > 0) time += t/repeats;
+		}
+
+		sstream << "   " << kernel_names[k] << ": " << time << " [ms], " << work_items << " work items, " << bytes_written
+			<< " bytes written" << std::endl;
+	}
+
+	return sstream.str();
+}
+
+//summed-area-table box filter of mask_size x mask_size on the image converted to pixel type T
+template <typename T>
+CImg<unsigned char> RunBoxFilter(const cl::Context& context, const cl::CommandQueue& queue, const CImg<unsigned char>& image_input,
+	int mask_size, TransferMode transfer_mode) {
+	CImg<T> image = FromImage8<T>(image_input);
+	size_t image_bytes = image.size()*sizeof(T);
+
+	BoxFilter<T> box(context);
+	TransferBuffer dev_image_input(context, CL_MEM_READ_ONLY, image_bytes, transfer_mode);
+	TransferBuffer dev_image_output(context, CL_MEM_READ_WRITE, image_bytes, transfer_mode);
+	dev_image_input.write(queue, image.data(), image_bytes);
+
+	std::vector<cl::Event> events;
+	box.apply(queue, dev_image_input.buffer(), dev_image_output.buffer(), image.width(), image.height(), image.spectrum(),
+		mask_size/2, mask_size/2, &events);
+	dev_image_output.read(queue, image.data(), image_bytes);
+
+	std::cout << "Box filter (" << PixelTraits<T>::name() << ", SAT) kernel execution time [ns]: row scan " << GetExecutionTime(events[0], PROF_NS)
+		<< ", column scan " << GetExecutionTime(events[1], PROF_NS) << ", box " << GetExecutionTime(events[2], PROF_NS) << std::endl;
+
+	return ToImage8(image);
+}
+
+//mask_size x mask_size median filter on the image converted to pixel type T
+template <typename T>
+CImg<unsigned char> RunMedian(const cl::Context& context, const cl::CommandQueue& queue, const CImg<unsigned char>& image_input,
+	int mask_size, TransferMode transfer_mode) {
+	CImg<T> image = FromImage8<T>(image_input);
+	size_t image_bytes = image.size()*sizeof(T);
+
+	MedianFilter<T> median(context);
+	TransferBuffer dev_image_input(context, CL_MEM_READ_ONLY, image_bytes, transfer_mode);
+	TransferBuffer dev_image_output(context, CL_MEM_READ_WRITE, image_bytes, transfer_mode);
+	dev_image_input.write(queue, image.data(), image_bytes);
+
+	std::vector<cl::Event> events;
+	median.apply(queue, dev_image_input.buffer(), dev_image_output.buffer(), image.width(), image.height(), image.spectrum(),
+		mask_size, MEDIAN_AUTO, &events);
+	dev_image_output.read(queue, image.data(), image_bytes);
+
+	std::cout << "Median (" << PixelTraits<T>::name() << ") kernel execution time [ns]: " << GetExecutionTime(events, PROF_NS) << std::endl;
+
+	return ToImage8(image);
+}
+
+//Sobel gradient magnitude, optionally thinned by non-maximum suppression, on the image converted to pixel type T
+template <typename T>
+CImg<unsigned char> RunSobel(const cl::Context& context, const cl::CommandQueue& queue, const CImg<unsigned char>& image_input,
+	bool nms, TransferMode transfer_mode) {
+	CImg<T> image = FromImage8<T>(image_input);
+	size_t image_bytes = image.size()*sizeof(T);
+
+	SobelFilter<T> sobel(context);
+	TransferBuffer dev_image_input(context, CL_MEM_READ_ONLY, image_bytes, transfer_mode);
+	TransferBuffer dev_image_output(context, CL_MEM_READ_WRITE, image_bytes, transfer_mode);
+	dev_image_input.write(queue, image.data(), image_bytes);
+
+	std::vector<cl::Event> events;
+	if (nms) {
+		cl::Buffer dev_magnitude(context, CL_MEM_READ_WRITE, image_bytes);
+		cl::Buffer dev_direction(context, CL_MEM_READ_WRITE, image.size());
+		sobel.apply(queue, dev_image_input.buffer(), dev_magnitude, &dev_direction, image.width(), image.height(), image.spectrum(), 0.1767767f, &events);
+		sobel.suppress(queue, dev_magnitude, dev_direction, dev_image_output.buffer(), image.width(), image.height(), image.spectrum(), &events);
+	}
+	else {
+		sobel.apply(queue, dev_image_input.buffer(), dev_image_output.buffer(), NULL, image.width(), image.height(), image.spectrum(), 0.1767767f, &events);
+	}
+	dev_image_output.read(queue, image.data(), image_bytes);
+
+	std::cout << "Sobel (" << PixelTraits<T>::name() << (nms ? ", NMS" : "") << ") kernel execution time [ns]: "
+		<< GetExecutionTime(events, PROF_NS) << std::endl;
+
+	return ToImage8(image);
+}
+
+//erosion, dilation, opening or closing with a mask_size x mask_size element on the image converted to pixel type T
+template <typename T>
+CImg<unsigned char> RunMorphology(const cl::Context& context, const cl::CommandQueue& queue, const CImg<unsigned char>& image_input,
+	MorphologyOp op, int mask_size, TransferMode transfer_mode) {
+	CImg<T> image = FromImage8<T>(image_input);
+	size_t image_bytes = image.size()*sizeof(T);
+
+	Morphology<T> morphology(context);
+	TransferBuffer dev_image_input(context, CL_MEM_READ_ONLY, image_bytes, transfer_mode);
+	TransferBuffer dev_image_output(context, CL_MEM_READ_WRITE, image_bytes, transfer_mode);
+	dev_image_input.write(queue, image.data(), image_bytes);
+
+	std::vector<cl::Event> events;
+	morphology.apply(queue, op, dev_image_input.buffer(), dev_image_output.buffer(), image.width(), image.height(), image.spectrum(),
+		mask_size, mask_size, &events);
+	dev_image_output.read(queue, image.data(), image_bytes);
+
+	std::cout << "Morphology (" << PixelTraits<T>::name() << ", " << events.size() << " passes) kernel execution time [ns]: "
+		<< GetExecutionTime(events, PROF_NS) << std::endl;
+
+	return ToImage8(image);
+}
+
+//edge-preserving smoothing, direct or with the bilateral grid, on the image converted to pixel type T
+template <typename T>
+CImg<unsigned char> RunBilateral(const cl::Context& context, const cl::CommandQueue& queue, const CImg<unsigned char>& image_input,
+	float sigma_spatial, float sigma_range, bool grid, TransferMode transfer_mode) {
+	CImg<T> image = FromImage8<T>(image_input);
+	size_t image_bytes = image.size()*sizeof(T);
+
+	BilateralFilter<T> bilateral(context);
+	TransferBuffer dev_image_input(context, CL_MEM_READ_ONLY, image_bytes, transfer_mode);
+	TransferBuffer dev_image_output(context, CL_MEM_READ_WRITE, image_bytes, transfer_mode);
+	dev_image_input.write(queue, image.data(), image_bytes);
+
+	std::vector<cl::Event> events;
+	if (grid || !bilateral.supports_direct(sigma_spatial))
+		bilateral.apply_grid(queue, dev_image_input.buffer(), dev_image_output.buffer(), image.width(), image.height(), image.spectrum(),
+			sigma_spatial, sigma_range, &events);
+	else
+		bilateral.apply(queue, dev_image_input.buffer(), dev_image_output.buffer(), image.width(), image.height(), image.spectrum(),
+			sigma_spatial, sigma_range, &events);
+	dev_image_output.read(queue, image.data(), image_bytes);
+
+	std::cout << "Bilateral (" << PixelTraits<T>::name() << ", " << ((events.size() > 1) ? "grid" : "direct") << ") kernel execution time [ns]: "
+		<< GetExecutionTime(events, PROF_NS) << std::endl;
+
+	return ToImage8(image);
+}
+
+//resample the image converted to pixel type T by scale in both directions
+template <typename T>
+CImg<unsigned char> RunResize(const cl::Context& context, const cl::CommandQueue& queue, const CImg<unsigned char>& image_input,
+	float scale, ResizeMethod method, TransferMode transfer_mode) {
+	CImg<T> image = FromImage8<T>(image_input);
+	int out_width = std::max(1, (int)(image.width()*scale + 0.5f)), out_height = std::max(1, (int)(image.height()*scale + 0.5f));
+	CImg<T> resized(out_width, out_height, 1, image.spectrum());
+
+	Resizer<T> resizer(context);
+	TransferBuffer dev_image_input(context, CL_MEM_READ_ONLY, image.size()*sizeof(T), transfer_mode);
+	TransferBuffer dev_image_output(context, CL_MEM_READ_WRITE, resized.size()*sizeof(T), transfer_mode);
+	dev_image_input.write(queue, image.data(), image.size()*sizeof(T));
+
+	std::vector<cl::Event> events;
+	resizer.apply(queue, dev_image_input.buffer(), dev_image_output.buffer(), image.width(), image.height(), out_width, out_height,
+		image.spectrum(), method, &events);
+	dev_image_output.read(queue, resized.data(), resized.size()*sizeof(T));
+
+	std::cout << "Resize (" << PixelTraits<T>::name() << ", " << GetResizeMethodName(method) << ", " << out_width << "x" << out_height
+		<< ") kernel execution time [ns]: " << GetExecutionTime(events, PROF_NS) << std::endl;
+
+	return ToImage8(resized);
+}
+
 int main(int argc, char **argv) {
 	//Part 1 - handle command line options such as device selection, verbosity, etc.
 	int platform_id = 0;
 	int device_id = 0;
+	string device_selector = "0";
 	string image_filename = "test.pgm";
+	TransferMode transfer_mode = TRANSFER_COPY;
+	bool benchmark_transfers = false;
+	string operation = "rgb2grey";
+	string pixel_type = "uchar";
+	int mask_size = 3;
+	MaskType mask_type = MASK_AVERAGE;
+	BorderMode border = BORDER_CLAMP;
+	StorageMode storage = STORAGE_BUFFER;
+	bool interleaved = false;
+	bool nms = false;
+	float sigma_spatial = 3.f;
+	float sigma_range = 25.f;
+	bool bilateral_grid = false;
+	float resize_scale = 0.5f;
+	ResizeMethod resize_method = RESIZE_AREA;
+	string chain = "grey,gain:1.5:-40,gamma:2.2,invert,threshold:100";
+	bool benchmark = false;
 
 	for (int i = 1; i < argc; i++) {
 		if ((strcmp(argv[i], "-p") == 0) && (i < (argc - 1))) { platform_id = atoi(argv[++i]); }
-		else if ((strcmp(argv[i], "-d") == 0) && (i < (argc - 1))) { device_id = atoi(argv[++i]); }
+		else if ((strcmp(argv[i], "-d") == 0) && (i < (argc - 1))) { device_selector = argv[++i]; }
 		else if (strcmp(argv[i], "-l") == 0) { std::cout << ListPlatformsDevices() << std::endl; }
 		else if ((strcmp(argv[i], "-f") == 0) && (i < (argc - 1))) { image_filename = argv[++i]; }
+		else if ((strcmp(argv[i], "-x") == 0) && (i < (argc - 1))) {
+			if (!ParseTransferMode(argv[++i], transfer_mode)) { std::cerr << "Unknown transfer mode: " << argv[i] << std::endl; return 1; }
+		}
+		else if (strcmp(argv[i], "-X") == 0) { benchmark_transfers = true; }
+		else if ((strcmp(argv[i], "-k") == 0) && (i < (argc - 1))) { operation = argv[++i]; }
+		else if ((strcmp(argv[i], "-t") == 0) && (i < (argc - 1))) { pixel_type = argv[++i]; }
+		else if ((strcmp(argv[i], "-m") == 0) && (i < (argc - 1))) { mask_size = atoi(argv[++i]); }
+		else if ((strcmp(argv[i], "-M") == 0) && (i < (argc - 1))) {
+			if (!ParseMaskType(argv[++i], mask_type)) { std::cerr << "Unknown mask type: " << argv[i] << std::endl; return 1; }
+		}
+		else if ((strcmp(argv[i], "-e") == 0) && (i < (argc - 1))) {
+			if (!ParseBorderMode(argv[++i], border)) { std::cerr << "Unknown border mode: " << argv[i] << std::endl; return 1; }
+		}
+		else if ((strcmp(argv[i], "-S") == 0) && (i < (argc - 1))) {
+			if (!ParseStorageMode(argv[++i], storage)) { std::cerr << "Unknown storage mode: " << argv[i] << std::endl; return 1; }
+		}
+		else if ((strcmp(argv[i], "-c") == 0) && (i < (argc - 1))) { chain = argv[++i]; }
+		else if (strcmp(argv[i], "-i") == 0) { interleaved = true; }
+		else if (strcmp(argv[i], "-N") == 0) { nms = true; }
+		else if ((strcmp(argv[i], "-s") == 0) && (i < (argc - 1))) { sigma_spatial = (float)atof(argv[++i]); }
+		else if ((strcmp(argv[i], "-r") == 0) && (i < (argc - 1))) { sigma_range = (float)atof(argv[++i]); }
+		else if (strcmp(argv[i], "-G") == 0) { bilateral_grid = true; }
+		else if ((strcmp(argv[i], "-z") == 0) && (i < (argc - 1))) { resize_scale = (float)atof(argv[++i]); }
+		else if ((strcmp(argv[i], "-R") == 0) && (i < (argc - 1))) {
+			if (!ParseResizeMethod(argv[++i], resize_method)) { std::cerr << "Unknown resize method: " << argv[i] << std::endl; return 1; }
+		}
+		else if (strcmp(argv[i], "-b") == 0) { benchmark = true; }
 		else if (strcmp(argv[i], "-h") == 0) { print_help(); return 0; }
 	}
 
+	bool filter_operation = (operation == "identityND") || (operation == "avg_filterND") || (operation == "convolutionND");
+	MorphologyOp morphology_op = MORPH_ERODE;
+	bool morphology_operation = ParseMorphologyOp(operation, morphology_op);
+	if ((operation != "rgb2grey") && (operation != "conv") && (operation != "pointops") && (operation != "box") && (operation != "median") && (operation != "sobel") && (operation != "bilateral") && (operation != "resize") && !filter_operation && !morphology_operation) { std::cerr << "Unknown operation: " << operation << std::endl; return 1; }
+	if ((pixel_type != "uchar") && (pixel_type != "ushort") && (pixel_type != "float")) { std::cerr << "Unknown pixel type: " << pixel_type << std::endl; return 1; }
+	std::vector<PointOp> point_ops;
+	string chain_error;
+	if ((operation == "pointops") && !ParsePointOps(chain, point_ops, chain_error)) { std::cerr << "Bad chain: " << chain_error << std::endl; return 1; }
+	if (((operation == "box") || (operation == "median") || (operation == "bilateral") || morphology_operation) && (pixel_type == "float")) { std::cerr << operation << " supports uchar and ushort pixels" << std::endl; return 1; }
+	if ((mask_size < 1) || (mask_size % 2 == 0)) { std::cerr << "Mask size must be odd" << std::endl; return 1; }
+	if ((sigma_spatial <= 0.f) || (sigma_range <= 0.f)) { std::cerr << "Sigmas must be positive" << std::endl; return 1; }
+	if (resize_scale <= 0.f) { std::cerr << "Scale factor must be positive" << std::endl; return 1; }
+
 	cimg::exception_mode(0);
 
 	//detect any potential exceptions
@@ -37,57 +382,165 @@ int main(int argc, char **argv) {
 		CImg<unsigned char> image_input(image_filename.c_str());
 		CImgDisplay disp_input(image_input,"input");
 
-		//a 3x3 convolution mask implementing an averaging filter
-		std::vector<float> convolution_mask = { 1.f / 9, 1.f / 9, 1.f / 9,
-												1.f / 9, 1.f / 9, 1.f / 9,
-												1.f / 9, 1.f / 9, 1.f / 9 };
+		if ((operation == "rgb2grey") && (image_input.spectrum() != 3)) {
+			std::cerr << "rgb2grey needs an RGB image" << std::endl;
+			return 1;
+		}
+
+		//a mask_size x mask_size convolution mask, by default an averaging filter
+		std::vector<float> convolution_mask = MakeMask(mask_type, mask_size);
 
 		//Part 3 - host operations
 		//3.1 Select computing devices
+		if (!SelectDevice(device_selector, platform_id, device_id)) {
+			std::cerr << "Error: no device matches " << device_selector << std::endl;
+			return 1;
+		}
 		cl::Context context = GetContext(platform_id, device_id);
 
 		//display the selected device
 		std::cout << "Running on " << GetPlatformName(platform_id) << ", " << GetDeviceName(platform_id, device_id) << std::endl;
 
-		//create a queue to which we will push commands for the device
-		cl::CommandQueue queue(context);
+		//create a queue to which we will push commands for the device, with profiling for the kernel timings
+		cl::CommandQueue queue(context, CL_QUEUE_PROFILING_ENABLE);
 
 		//3.2 Load & build the device code
-		cl::Program::Sources sources;
+		cl::Program program = BuildProgram(context, "kernels/my_kernels.cl");
+
+		if (benchmark_transfers) {
+			std::cout << BenchmarkTransfers(context, queue, image_input.size());
+			return 0;
+		}
+
+		if (benchmark) {
+			if (operation == "conv") {
+				if (pixel_type == "ushort") std::cout << BenchmarkConvolution(context, queue, FromImage8<unsigned short>(image_input), border);
+				else if (pixel_type == "float") std::cout << BenchmarkConvolution(context, queue, FromImage8<float>(image_input), border);
+				else std::cout << BenchmarkConvolution(context, queue, image_input, border);
+			}
+			else if (operation == "box") {
+				if (pixel_type == "ushort") std::cout << BenchmarkBoxFilter(context, queue, FromImage8<unsigned short>(image_input));
+				else std::cout << BenchmarkBoxFilter(context, queue, image_input);
+			}
+			else if (operation == "sobel") {
+				if (pixel_type == "ushort") std::cout << BenchmarkSobel(context, queue, FromImage8<unsigned short>(image_input));
+				else if (pixel_type == "float") std::cout << BenchmarkSobel(context, queue, FromImage8<float>(image_input));
+				else std::cout << BenchmarkSobel(context, queue, image_input);
+			}
+			else if (operation == "median") {
+				if (pixel_type == "ushort") std::cout << BenchmarkMedian(context, queue, FromImage8<unsigned short>(image_input));
+				else std::cout << BenchmarkMedian(context, queue, image_input);
+			}
+			else if (operation == "resize") {
+				if (pixel_type == "ushort") std::cout << BenchmarkResize(context, queue, FromImage8<unsigned short>(image_input));
+				else if (pixel_type == "float") std::cout << BenchmarkResize(context, queue, FromImage8<float>(image_input));
+				else std::cout << BenchmarkResize(context, queue, image_input);
+			}
+			else if (operation == "bilateral") {
+				if (pixel_type == "ushort") std::cout << BenchmarkBilateral(context, queue, FromImage8<unsigned short>(image_input));
+				else std::cout << BenchmarkBilateral(context, queue, image_input);
+			}
+			else if (morphology_operation) {
+				if (pixel_type == "ushort") std::cout << BenchmarkMorphology(context, queue, FromImage8<unsigned short>(image_input));
+				else std::cout << BenchmarkMorphology(context, queue, image_input);
+			}
+			else if (operation == "pointops") {
+				std::vector<unsigned char> pixels(image_input.data(), image_input.data() + image_input.size());
+				std::cout << BenchmarkPointOps(context, queue, pixels, image_input.width()*image_input.height(), image_input.spectrum(), point_ops);
+			}
+			else if (operation == "rgb2grey") {
+				std::cout << BenchmarkGrey(context, queue, program, image_input);
+			}
+			else if (filter_operation) {
+				std::cout << BenchmarkStorage(context, queue, program, image_input, MakeMask(mask_type, 3));
+			}
+			else {
+				std::cerr << "No benchmark for " << operation << std::endl;
+			}
+			return 0;
+		}
 
-		AddSources(sources, "kernels/my_kernels.cl");
+		//Part 4 - device operations
+		CImg<unsigned char> output_image;
+
+		if (operation == "conv") {
+			if (pixel_type == "ushort") output_image = RunConvolution<unsigned short>(context, queue, image_input, convolution_mask, border, transfer_mode);
+			else if (pixel_type == "float") output_image = RunConvolution<float>(context, queue, image_input, convolution_mask, border, transfer_mode);
+			else output_image = RunConvolution<unsigned char>(context, queue, image_input, convolution_mask, border, transfer_mode);
+		}
+		else if (operation == "box") {
+			if (pixel_type == "ushort") output_image = RunBoxFilter<unsigned short>(context, queue, image_input, mask_size, transfer_mode);
+			else output_image = RunBoxFilter<unsigned char>(context, queue, image_input, mask_size, transfer_mode);
+		}
+		else if (operation == "sobel") {
+			if (pixel_type == "ushort") output_image = RunSobel<unsigned short>(context, queue, image_input, nms, transfer_mode);
+			else if (pixel_type == "float") output_image = RunSobel<float>(context, queue, image_input, nms, transfer_mode);
+			else output_image = RunSobel<unsigned char>(context, queue, image_input, nms, transfer_mode);
+		}
+		else if (operation == "median") {
+			if (pixel_type == "ushort") output_image = RunMedian<unsigned short>(context, queue, image_input, mask_size, transfer_mode);
+			else output_image = RunMedian<unsigned char>(context, queue, image_input, mask_size, transfer_mode);
+		}
+		else if (operation == "resize") {
+			if (pixel_type == "ushort") output_image = RunResize<unsigned short>(context, queue, image_input, resize_scale, resize_method, transfer_mode);
+			else if (pixel_type == "float") output_image = RunResize<float>(context, queue, image_input, resize_scale, resize_method, transfer_mode);
+			else output_image = RunResize<unsigned char>(context, queue, image_input, resize_scale, resize_method, transfer_mode);
+		}
+		else if (operation == "bilateral") {
+			if (pixel_type == "ushort") output_image = RunBilateral<unsigned short>(context, queue, image_input, sigma_spatial, sigma_range, bilateral_grid, transfer_mode);
+			else output_image = RunBilateral<unsigned char>(context, queue, image_input, sigma_spatial, sigma_range, bilateral_grid, transfer_mode);
+		}
+		else if (morphology_operation) {
+			if (pixel_type == "ushort") output_image = RunMorphology<unsigned short>(context, queue, image_input, morphology_op, mask_size, transfer_mode);
+			else output_image = RunMorphology<unsigned char>(context, queue, image_input, morphology_op, mask_size, transfer_mode);
+		}
+		else if (operation == "pointops") {
+			PointOpEngine engine(context);
+			TransferBuffer dev_image(context, CL_MEM_READ_WRITE, image_input.size(), transfer_mode);
+			dev_image.write(queue, image_input.data(), image_input.size());
 
-		cl::Program program(context, sources);
+			//the whole chain runs in place as one kernel
+			std::vector<cl::Event> events;
+			engine.apply(queue, dev_image.buffer(), dev_image.buffer(), image_input.width()*image_input.height(), image_input.spectrum(), point_ops, &events);
 
-		//build and debug the kernel code
-		try { 
-			program.build();
+			output_image.assign(image_input.width(), image_input.height(), image_input.depth(), image_input.spectrum());
+			dev_image.read(queue, output_image.data(), output_image.size());
+			std::cout << "pointops (" << point_ops.size() << " operations fused) kernel execution time [ns]: "
+				<< GetExecutionTime(events, PROF_NS) << ", JIT build time [ms]: " << engine.build_time() << std::endl;
+		}
+		else if (filter_operation) {
+			output_image = RunFilter(context, queue, program, image_input, operation, storage, MakeMask(mask_type, 3), border, transfer_mode);
 		}
-		catch (const cl::Error& err) {
-			std::cout << "Build Status: " << program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(context.getInfo<CL_CONTEXT_DEVICES>()[0]) << std::endl;
-			std::cout << "Build Options:\t" << program.getBuildInfo<CL_PROGRAM_BUILD_OPTIONS>(context.getInfo<CL_CONTEXT_DEVICES>()[0]) << std::endl;
-			std::cout << "Build Log:\t " << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(context.getInfo<CL_CONTEXT_DEVICES>()[0]) << std::endl;
-			throw err;
-		}oext, CL_MEM_READ_WRITE, image_input.size()); //should be the same as input image
-//		cl::Buffer dev_convolution_mask(context, CL_MEM_READ_ONLY, convolution_mask.size()*sizeof(float));
+		else {
+			int image_size = image_input.width()*image_input.height();
 
-		//4.1 Copy images to device memory
-		queue.enqueueWriteBuffer(dev_image_input, CL_TRUE, 0, image_input.size(), &image_input.data()[0]);
-//		queue.enqueueWriteBuffer(dev_convolution_mask, CL_TRUE, 0, convolution_mask.size()*sizeof(float), &convolution_mask[0]);
+			//CImg stores the channels as planes; the interleaved kernel takes rgbrgb... instead
+			CImg<unsigned char> image_rgb = interleaved ? image_input.get_permute_axes("cxyz") : image_input;
 
-		//4.2 Setup and execute the kernel (i.e. device code)
-		cl::Kernel kernel = cl::Kernel(program, "rgb2grey");
-		kernel.setArg(0, dev_image_input);
-		kernel.setArg(1, dev_image_output);
-//		kernel.setArg(2, dev_convolution_mask);
+			//device - buffers, the output has a single channel
+			TransferBuffer dev_image_input(context, CL_MEM_READ_ONLY, image_rgb.size(), transfer_mode);
+			TransferBuffer dev_image_output(context, CL_MEM_READ_WRITE, image_size, transfer_mode);
+
+			//4.1 Copy images to device memory
+			dev_image_input.write(queue, image_rgb.data(), image_rgb.size());
 
-		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(image_input.size()), cl::NullRange);
+			//4.2 Setup and execute the kernel (i.e. device code), one work item per 4 pixels
+			cl::Kernel kernel = cl::Kernel(program, interleaved ? "rgb2grey_interleaved" : "rgb2grey_planar");
+			kernel.setArg(0, dev_image_input.buffer());
+			kernel.setArg(1, dev_image_output.buffer());
+			kernel.setArg(2, image_size);
 
-		vector<unsigned char> output_buffer(image_input.size());
-		//4.3 Copy the result from device to host
-		queue.enqueueReadBuffer(dev_image_output, CL_TRUE, 0, output_buffer.size(), &output_buffer.data()[0]);
+			cl::Event kernel_event;
+			queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange((image_size + 3)/4), cl::NullRange, NULL, &kernel_event);
+
+			//4.3 Copy the result from device to host
+			output_image.assign(image_input.width(), image_input.height(), 1, 1);
+			dev_image_output.read(queue, output_image.data(), output_image.size());
+
+			std::cout << "rgb2grey (" << (interleaved ? "interleaved" : "planar") << ") kernel execution time [ns]: "
+				<< GetExecutionTime(kernel_event, PROF_NS) << std::endl;
+		}
 
-		CImg<unsigned char> output_image(output_buffer.data(), image_input.width(), image_input.height(), image_input.depth(), image_input.spectrum());
 		CImgDisplay disp_output(output_image, "output");
 
  		while (!disp_input.is_closed() && !disp_output.is_closed()
@@ -0,0 +1,61 @@
+#pragma once
+
+// Hand-written bitonic sort of int buffers (kernels/bitonic.cl), in place and ascending. Stages whose pairs are
+// further apart than a work group's block run from global memory, one launch each; the remaining stages of every
+// merge run together in local memory in a single launch. The length must be a power of two.
+//
+//   BitonicSort sorter(context);
+//   sorter.sort(queue, dev_keys, n);
+
+#include <algorithm>
+
+#include "Utils.h"
+
+class BitonicSort {
+public:
+	BitonicSort(const cl::Context& context, const string& kernel_file = "kernels/bitonic.cl") {
+		cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+		program_ = BuildProgram(context, kernel_file);
+		global_kernel_ = cl::Kernel(program_, "bitonic_global");
+		local_kernel_ = cl::Kernel(program_, "bitonic_local");
+
+		size_t max_group_size = std::min((size_t)256, local_kernel_.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device));
+		group_size_ = 1;
+		while (group_size_ * 2 <= max_group_size) group_size_ *= 2;
+	}
+
+	void sort(const cl::CommandQueue& queue, const cl::Buffer& keys, int n, vector<cl::Event>* events = NULL) {
+		if ((n < 1) || (n & (n - 1)))
+			throw cl::Error(CL_INVALID_VALUE, "BitonicSort: the length must be a power of two");
+		if (n == 1) return;
+
+		// blocks of 2*group_size elements, no larger than the array
+		size_t group_size = std::min(group_size_, (size_t)n / 2);
+		global_kernel_.setArg(0, keys);
+		local_kernel_.setArg(0, keys);
+		local_kernel_.setArg(3, cl::Local(2 * group_size * sizeof(int)));
+
+		for (int k = 2; k <= n; k *= 2) {
+			int j = k / 2;
+			for (; j > (int)group_size; j /= 2) {
+				global_kernel_.setArg(1, j);
+				global_kernel_.setArg(2, k);
+				launch(queue, global_kernel_, n / 2, group_size, events);
+			}
+			local_kernel_.setArg(1, j);
+			local_kernel_.setArg(2, k);
+			launch(queue, local_kernel_, n / 2, group_size, events);
+		}
+	}
+
+private:
+	cl::Program program_;
+	cl::Kernel global_kernel_, local_kernel_;
+	size_t group_size_;
+
+	static void launch(const cl::CommandQueue& queue, cl::Kernel& kernel, size_t global_size, size_t local_size, vector<cl::Event>* events) {
+		cl::Event event;
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(global_size), cl::NDRange(local_size), NULL, &event);
+		if (events) events->push_back(event);
+	}
+};
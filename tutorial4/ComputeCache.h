@@ -0,0 +1,62 @@
+#pragma once
+
+// Persistent program cache for Boost.Compute. With BOOST_COMPUTE_USE_OFFLINE_CACHE every program Boost.Compute builds
+// (algorithm kernels, closures, programs built through program_cache) is saved as a device binary, keyed by a hash of
+// platform, device, build options and source, and later runs load the binary instead of compiling the source again.
+// The cache lives in $HOME/.boost_compute; Boost.Compute reads HOME once, when the first program is built, so
+// SetComputeCacheDir has to run before that. Include this header before any other Boost.Compute header and link
+// with -lboost_filesystem -lboost_system.
+//
+//   SetComputeCacheDir("/tmp/bc"); // cache in /tmp/bc/.boost_compute
+//   bool cold = (CountCachedPrograms() == 0);
+//   double first = ComputeSeconds(queue, [&]() { compute::transform(...); });
+
+#if defined(BOOST_COMPUTE_PROGRAM_HPP) && !defined(BOOST_COMPUTE_USE_OFFLINE_CACHE)
+#error "ComputeCache.h must be included before any Boost.Compute header"
+#endif
+
+#ifndef BOOST_COMPUTE_USE_OFFLINE_CACHE
+#define BOOST_COMPUTE_USE_OFFLINE_CACHE
+#endif
+
+#include <chrono>
+#include <cstdlib>
+#include <string>
+
+#include <boost/compute.hpp>
+#include <boost/filesystem.hpp>
+
+// Moves the cache to dir/.boost_compute; the directory is created on the first save
+inline void SetComputeCacheDir(const std::string& dir) {
+	setenv("HOME", dir.c_str(), 1);
+}
+
+// Fixes the cache directory if no program has been built yet
+inline std::string GetComputeCacheDir() {
+	return boost::compute::detail::appdata_path();
+}
+
+// Number of program binaries in the cache, 0 for a cold cache
+inline size_t CountCachedPrograms() {
+	boost::system::error_code error;
+	boost::filesystem::recursive_directory_iterator it(GetComputeCacheDir(), error), end;
+	size_t count = 0;
+	for (; !error && it != end; it.increment(error)) {
+		if (it->path().filename() == "kernel") count++;
+	}
+	return count;
+}
+
+// Drops the programs held in memory for context, so that the next builds go back to the persistent cache
+inline void ClearComputeMemoryCache(const boost::compute::context& context) {
+	boost::compute::program_cache::get_global_cache(context)->clear();
+}
+
+// Wall-clock seconds of f, including all the work it left on queue
+template <typename F>
+double ComputeSeconds(boost::compute::command_queue& queue, F f) {
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	f();
+	queue.finish();
+	return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
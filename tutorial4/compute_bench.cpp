@@ -0,0 +1,420 @@
+//g++ -std=c++0x -I/usr/include/compute/ compute_bench.cpp -o compute_bench -lOpenCL
+//Runs the same operations through Boost.Compute and through the hand-written kernels of tutorial1, Assignment1 and
+//kernels/bitonic.cl on one device: vector add, sum, inclusive and exclusive scan, a 256-bin histogram of 16-bit
+//values and an int sort. Reports the startup cost of each (program builds, Boost.Compute's program cache) and the
+//wall-clock time and throughput of warm calls for sizes from 2^10 up, checking both against the host.
+#include "Utils.h"
+#include "../tutorial1/Reduce.h"
+#include "../Assignment1/Scan.h"
+#include "Bitonic.h"
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <boost/compute.hpp>
+
+namespace compute = boost::compute;
+using namespace std;
+
+void print_help() {
+	cerr << "Application usage:" << endl;
+	cerr << "  -p : select platform " << endl;
+	cerr << "  -d : select device (index on the platform, cpu, gpu, accelerator, fastest or part of a device name)" << endl;
+	cerr << "  -l : list all platforms and devices" << endl;
+	cerr << "  -n : largest size as a power of two (default: 24)" << endl;
+	cerr << "  -r : repeats per size (default: 10)" << endl;
+	cerr << "  -h : print this message" << endl;
+}
+
+//wall-clock time of f in ms; f must wait for its work to finish
+double Milliseconds(const function<void()>& f) {
+	auto start = chrono::high_resolution_clock::now();
+	f();
+	return chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+}
+
+//the bin of a 16-bit value in hist_local (Assignment1/kernels/my_kernels.cl) with 256 bins
+BOOST_COMPUTE_FUNCTION(int, bin_of, (compute::ushort_ value), {
+	return (int)(((float)value / 65535.0f) * 255);
+});
+
+const int histogram_bins = 256;
+
+//what the comparisons share: the device through both APIs and the input data
+struct Setup {
+	cl::Context context;
+	cl::CommandQueue queue;
+	compute::context bc_context;
+	compute::command_queue bc_queue;
+	int max_n;
+	vector<int> a, b;           //small values, so sums and scans fit in an int
+	vector<compute::ushort_> pixels;
+	vector<int> keys;           //random ints to sort
+};
+
+//one operation through both layers; run_* time one call on the first n elements in ms, preparing any input the
+//operation overwrites outside the timing
+class Comparison {
+public:
+	Comparison(Setup& setup) : s(setup) {}
+	virtual ~Comparison() {}
+
+	virtual const char* name() const = 0;
+	virtual const char* unit() const { return "GB/s"; }
+	virtual double work(int n) const = 0;      //in the unit's numerator: GB of memory traffic or millions of keys
+	virtual void build() = 0;                  //builds the hand-written kernels
+	virtual double run_boost(int n) = 0;
+	virtual double run_hand_written(int n) = 0;
+	virtual bool check(int n) = 0;             //the results of the last runs of both against the host
+
+protected:
+	Setup& s;
+};
+
+//C = A + B: transform with plus against the add kernel of tutorial1
+class AddComparison : public Comparison {
+public:
+	AddComparison(Setup& setup) : Comparison(setup),
+		bc_a(setup.a.begin(), setup.a.end(), setup.bc_queue), bc_b(setup.b.begin(), setup.b.end(), setup.bc_queue), bc_c(setup.max_n, setup.bc_context) {
+		size_t bytes = setup.max_n * sizeof(int);
+		A = cl::Buffer(setup.context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, bytes, &setup.a[0]);
+		B = cl::Buffer(setup.context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, bytes, &setup.b[0]);
+		C = cl::Buffer(setup.context, CL_MEM_READ_WRITE, bytes);
+	}
+
+	const char* name() const { return "add"; }
+	double work(int n) const { return 3.0 * n * sizeof(int) / 1e9; }
+
+	void build() {
+		program = BuildProgram(s.context, "../tutorial1/kernels/my_kernels.cl");
+		kernel = cl::Kernel(program, "add");
+		kernel.setArg(0, A);
+		kernel.setArg(1, B);
+		kernel.setArg(2, C);
+	}
+
+	double run_boost(int n) {
+		return Milliseconds([&]() {
+			compute::transform(bc_a.begin(), bc_a.begin() + n, bc_b.begin(), bc_c.begin(), compute::plus<int>(), s.bc_queue);
+			s.bc_queue.finish();
+		});
+	}
+
+	double run_hand_written(int n) {
+		return Milliseconds([&]() {
+			s.queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(n), cl::NullRange);
+			s.queue.finish();
+		});
+	}
+
+	bool check(int n) {
+		vector<int> bc_result(n), result(n);
+		compute::copy(bc_c.begin(), bc_c.begin() + n, bc_result.begin(), s.bc_queue);
+		s.queue.enqueueReadBuffer(C, CL_TRUE, 0, n * sizeof(int), &result[0]);
+		for (int i = 0; i < n; i++)
+			if ((bc_result[i] != s.a[i] + s.b[i]) || (result[i] != s.a[i] + s.b[i])) return false;
+		return true;
+	}
+
+private:
+	compute::vector<int> bc_a, bc_b, bc_c;
+	cl::Buffer A, B, C;
+	cl::Program program;
+	cl::Kernel kernel;
+};
+
+//sum of A: reduce against tutorial1's Reducer, both reading the result back to the host
+class ReduceComparison : public Comparison {
+public:
+	ReduceComparison(Setup& setup) : Comparison(setup), bc_a(setup.a.begin(), setup.a.end(), setup.bc_queue), bc_sum(0), sum(0) {
+		A = cl::Buffer(setup.context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, setup.max_n * sizeof(int), &setup.a[0]);
+	}
+
+	const char* name() const { return "sum"; }
+	double work(int n) const { return 1.0 * n * sizeof(int) / 1e9; }
+
+	void build() { reducer.reset(new Reducer<cl_int>(s.context, "../tutorial1/kernels/reduce.cl")); }
+
+	double run_boost(int n) {
+		return Milliseconds([&]() { compute::reduce(bc_a.begin(), bc_a.begin() + n, &bc_sum, s.bc_queue); });
+	}
+
+	double run_hand_written(int n) {
+		return Milliseconds([&]() { sum = reducer->sum(s.queue, A, n); });
+	}
+
+	bool check(int n) {
+		cl_long host_sum = 0;
+		for (int i = 0; i < n; i++) host_sum += s.a[i];
+		return (bc_sum == host_sum) && (sum == host_sum);
+	}
+
+private:
+	compute::vector<int> bc_a;
+	cl::Buffer A;
+	unique_ptr<Reducer<cl_int> > reducer;
+	int bc_sum;
+	cl_long sum;
+};
+
+//inclusive or exclusive scan of A: inclusive_scan/exclusive_scan against Assignment1's PrefixScan
+class ScanComparison : public Comparison {
+public:
+	ScanComparison(Setup& setup, bool exclusive) : Comparison(setup), exclusive(exclusive),
+		bc_a(setup.a.begin(), setup.a.end(), setup.bc_queue), bc_c(setup.max_n, setup.bc_context) {
+		size_t bytes = setup.max_n * sizeof(int);
+		A = cl::Buffer(setup.context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, bytes, &setup.a[0]);
+		C = cl::Buffer(setup.context, CL_MEM_READ_WRITE, bytes);
+	}
+
+	const char* name() const { return exclusive ? "exclusive scan" : "inclusive scan"; }
+	double work(int n) const { return 2.0 * n * sizeof(int) / 1e9; }
+
+	void build() { scan.reset(new PrefixScan<int>(s.context, "../Assignment1/kernels/scan.cl")); }
+
+	double run_boost(int n) {
+		return Milliseconds([&]() {
+			if (exclusive) compute::exclusive_scan(bc_a.begin(), bc_a.begin() + n, bc_c.begin(), s.bc_queue);
+			else compute::inclusive_scan(bc_a.begin(), bc_a.begin() + n, bc_c.begin(), s.bc_queue);
+			s.bc_queue.finish();
+		});
+	}
+
+	double run_hand_written(int n) {
+		return Milliseconds([&]() {
+			if (exclusive) scan->exclusive(s.queue, A, C, n);
+			else scan->inclusive(s.queue, A, C, n);
+			s.queue.finish();
+		});
+	}
+
+	bool check(int n) {
+		vector<int> bc_result(n), result(n);
+		compute::copy(bc_c.begin(), bc_c.begin() + n, bc_result.begin(), s.bc_queue);
+		s.queue.enqueueReadBuffer(C, CL_TRUE, 0, n * sizeof(int), &result[0]);
+		int sum = 0;
+		for (int i = 0; i < n; i++) {
+			if (!exclusive) sum += s.a[i];
+			if ((bc_result[i] != sum) || (result[i] != sum)) return false;
+			if (exclusive) sum += s.a[i];
+		}
+		return true;
+	}
+
+private:
+	bool exclusive;
+	compute::vector<int> bc_a, bc_c;
+	cl::Buffer A, C;
+	unique_ptr<PrefixScan<int> > scan;
+};
+
+//256-bin histogram of 16-bit values. Boost.Compute has no histogram algorithm, so its side is built from
+//algorithms: bin indices, sort, reduce_by_key to count each bin, scatter into the histogram. The hand-written
+//side is hist_local from Assignment1.
+class HistogramComparison : public Comparison {
+public:
+	HistogramComparison(Setup& setup) : Comparison(setup), bins(histogram_bins), bc_pixels(setup.pixels.begin(), setup.pixels.end(), setup.bc_queue),
+		bc_bins(setup.max_n, setup.bc_context), bc_keys(bins, setup.bc_context), bc_counts(bins, setup.bc_context), bc_histogram(bins, setup.bc_context) {
+		pixels = cl::Buffer(setup.context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, setup.max_n * sizeof(cl_ushort), &setup.pixels[0]);
+		histogram = cl::Buffer(setup.context, CL_MEM_READ_WRITE, bins * sizeof(int));
+	}
+
+	const char* name() const { return "histogram"; }
+	double work(int n) const { return 1.0 * n * sizeof(cl_ushort) / 1e9; }
+
+	void build() {
+		program = BuildProgram(s.context, "../Assignment1/kernels/my_kernels.cl");
+		kernel = cl::Kernel(program, "hist_local");
+		kernel.setArg(0, pixels);
+		kernel.setArg(1, histogram);
+		kernel.setArg(2, bins);
+		kernel.setArg(4, cl::Local(bins * sizeof(int)));
+	}
+
+	double run_boost(int n) {
+		return Milliseconds([&]() {
+			compute::transform(bc_pixels.begin(), bc_pixels.begin() + n, bc_bins.begin(), bin_of, s.bc_queue);
+			compute::sort(bc_bins.begin(), bc_bins.begin() + n, s.bc_queue);
+			auto ends = compute::reduce_by_key(bc_bins.begin(), bc_bins.begin() + n, compute::make_constant_iterator<int>(1),
+				bc_keys.begin(), bc_counts.begin(), s.bc_queue);
+			compute::fill(bc_histogram.begin(), bc_histogram.end(), 0, s.bc_queue);
+			compute::scatter(bc_counts.begin(), ends.second, bc_keys.begin(), bc_histogram.begin(), s.bc_queue);
+			s.bc_queue.finish();
+		});
+	}
+
+	double run_hand_written(int n) {
+		size_t local_size = 256;
+		return Milliseconds([&]() {
+			s.queue.enqueueFillBuffer(histogram, 0, 0, bins * sizeof(int));
+			kernel.setArg(3, n);
+			s.queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange((n + local_size - 1) / local_size * local_size), cl::NDRange(local_size));
+			s.queue.finish();
+		});
+	}
+
+	bool check(int n) {
+		vector<int> host(bins, 0), bc_result(bins), result(bins);
+		for (int i = 0; i < n; i++) host[(int)((s.pixels[i] / 65535.0f) * (bins - 1))]++;
+		compute::copy(bc_histogram.begin(), bc_histogram.end(), bc_result.begin(), s.bc_queue);
+		s.queue.enqueueReadBuffer(histogram, CL_TRUE, 0, bins * sizeof(int), &result[0]);
+		return (bc_result == host) && (result == host);
+	}
+
+private:
+	int bins;
+	compute::vector<compute::ushort_> bc_pixels;
+	compute::vector<int> bc_bins, bc_keys, bc_counts, bc_histogram;
+	cl::Buffer pixels, histogram;
+	cl::Program program;
+	cl::Kernel kernel;
+};
+
+//ascending int sort in place: sort (a radix sort for ints) against kernels/bitonic.cl; the keys are restored
+//from a copy before every run
+class SortComparison : public Comparison {
+public:
+	SortComparison(Setup& setup) : Comparison(setup), bc_input(setup.keys.begin(), setup.keys.end(), setup.bc_queue), bc_keys(setup.max_n, setup.bc_context) {
+		size_t bytes = setup.max_n * sizeof(int);
+		input = cl::Buffer(setup.context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, bytes, &setup.keys[0]);
+		keys = cl::Buffer(setup.context, CL_MEM_READ_WRITE, bytes);
+	}
+
+	const char* name() const { return "sort"; }
+	const char* unit() const { return "Mkeys/s"; }
+	double work(int n) const { return n / 1e6; }
+
+	void build() { sorter.reset(new BitonicSort(s.context)); }
+
+	double run_boost(int n) {
+		compute::copy(bc_input.begin(), bc_input.begin() + n, bc_keys.begin(), s.bc_queue);
+		s.bc_queue.finish();
+		return Milliseconds([&]() {
+			compute::sort(bc_keys.begin(), bc_keys.begin() + n, s.bc_queue);
+			s.bc_queue.finish();
+		});
+	}
+
+	double run_hand_written(int n) {
+		s.queue.enqueueCopyBuffer(input, keys, 0, 0, n * sizeof(int));
+		s.queue.finish();
+		return Milliseconds([&]() {
+			sorter->sort(s.queue, keys, n);
+			s.queue.finish();
+		});
+	}
+
+	bool check(int n) {
+		vector<int> host(s.keys.begin(), s.keys.begin() + n), bc_result(n), result(n);
+		sort(host.begin(), host.end());
+		compute::copy(bc_keys.begin(), bc_keys.begin() + n, bc_result.begin(), s.bc_queue);
+		s.queue.enqueueReadBuffer(keys, CL_TRUE, 0, n * sizeof(int), &result[0]);
+		return (bc_result == host) && (result == host);
+	}
+
+private:
+	compute::vector<int> bc_input, bc_keys;
+	cl::Buffer input, keys;
+	unique_ptr<BitonicSort> sorter;
+};
+
+int main(int argc, char **argv) {
+	int platform_id = 0;
+	int device_id = 0;
+	string device_selector = "0";
+	int max_power = 24;
+	int repeats = 10;
+
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-p") == 0) && (i < (argc - 1))) { platform_id = atoi(argv[++i]); }
+		else if ((strcmp(argv[i], "-d") == 0) && (i < (argc - 1))) { device_selector = argv[++i]; }
+		else if (strcmp(argv[i], "-l") == 0) { cout << ListPlatformsDevices() << endl; }
+		else if ((strcmp(argv[i], "-n") == 0) && (i < (argc - 1))) { max_power = atoi(argv[++i]); }
+		else if ((strcmp(argv[i], "-r") == 0) && (i < (argc - 1))) { repeats = atoi(argv[++i]); }
+		else if (strcmp(argv[i], "-h") == 0) { print_help(); return 0; }
+	}
+	if ((max_power < 10) || (max_power > 28) || (repeats < 1)) {
+		cerr << "The largest size must be 2^10 to 2^28 and repeats at least 1" << endl;
+		return 1;
+	}
+
+	try {
+		if (!SelectDevice(device_selector, platform_id, device_id)) {
+			cerr << "Error: no device matches " << device_selector << endl;
+			return 1;
+		}
+		Setup s;
+		//both APIs on the same context and device, each with its own in-order queue
+		double startup = Milliseconds([&]() {
+			s.context = GetContext(platform_id, device_id);
+			cl::Device device = s.context.getInfo<CL_CONTEXT_DEVICES>()[0];
+			s.queue = cl::CommandQueue(s.context, device, CL_QUEUE_PROFILING_ENABLE); // Reducer tunes with profiling events
+			s.bc_context = compute::context(s.context());
+			s.bc_queue = compute::command_queue(s.bc_context, compute::device(device()));
+		});
+		cout << "Runinng on " << GetPlatformName(platform_id) << ", " << GetDeviceName(platform_id, device_id) << endl;
+
+		s.max_n = 1 << max_power;
+		s.a.resize(s.max_n);
+		s.b.resize(s.max_n);
+		s.pixels.resize(s.max_n);
+		s.keys.resize(s.max_n);
+		for (int i = 0; i < s.max_n; i++) {
+			s.a[i] = rand() % 4;
+			s.b[i] = rand() % 100;
+			s.pixels[i] = (compute::ushort_)(rand() % 65536);
+			s.keys[i] = rand() - RAND_MAX / 2;
+		}
+
+		vector<unique_ptr<Comparison> > comparisons;
+		comparisons.emplace_back(new AddComparison(s));
+		comparisons.emplace_back(new ReduceComparison(s));
+		comparisons.emplace_back(new ScanComparison(s, false));
+		comparisons.emplace_back(new ScanComparison(s, true));
+		comparisons.emplace_back(new HistogramComparison(s));
+		comparisons.emplace_back(new SortComparison(s));
+
+		//first calls compile the programs; Boost.Compute keeps its programs in a per-context cache, so clearing the
+		//cache and calling again costs the build again (or the offline cache load, when that is enabled)
+		const int small = 1 << 10;
+		cout << "Startup, " << small << " elements (ms): context and queues " << startup << endl;
+		for (size_t c = 0; c < comparisons.size(); c++) {
+			Comparison& comparison = *comparisons[c];
+			double bc_first = comparison.run_boost(small);
+			double bc_warm = comparison.run_boost(small);
+			compute::program_cache::get_global_cache(s.bc_context)->clear();
+			double bc_rebuilt = comparison.run_boost(small);
+			double build = Milliseconds([&]() { comparison.build(); });
+			double first = comparison.run_hand_written(small);
+			double warm = comparison.run_hand_written(small);
+			cout << "   " << comparison.name() << ": Boost.Compute first call " << bc_first << ", after clearing its program cache "
+				<< bc_rebuilt << ", warm " << bc_warm << "; hand-written build " << build << ", first call " << first << ", warm " << warm << endl;
+		}
+
+		cout << "Throughput, best of " << repeats << " (wall clock, including launch and any read back):" << endl;
+		for (size_t c = 0; c < comparisons.size(); c++) {
+			Comparison& comparison = *comparisons[c];
+			for (int power = 10; power <= max_power; power += 2) {
+				int n = 1 << power;
+				double bc_best = 0, best = 0;
+				for (int i = 0; i < repeats; i++) {
+					double bc_time = comparison.run_boost(n), time = comparison.run_hand_written(n);
+					if ((bc_best == 0) || (bc_time < bc_best)) bc_best = bc_time;
+					if ((best == 0) || (time < best)) best = time;
+				}
+				cout << "   " << comparison.name() << " 2^" << power << ": Boost.Compute " << bc_best << " ms (" << comparison.work(n) * 1000 / bc_best
+					<< " " << comparison.unit() << "), hand-written " << best << " ms (" << comparison.work(n) * 1000 / best << " " << comparison.unit()
+					<< ")" << (comparison.check(n) ? "" : ", WRONG") << endl;
+			}
+		}
+	}
+	catch (const cl::Error& err) {
+		cerr << "ERROR: " << err.what() << ", " << getErrorString(err.err()) << endl;
+	}
+	catch (const compute::opencl_error& err) {
+		cerr << "ERROR: " << err.what() << endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,48 @@
+//bitonic sort of int arrays whose length is a power of two, ascending
+//the sort is log2(n)*(log2(n)+1)/2 compare-exchange stages (k, j): element i is paired with i + j for every i with
+//bit j clear, and the pair is put in ascending order when bit k of i is clear and in descending order otherwise
+
+//index of the lower element of pair t in a stage with distance j (a power of two)
+int lower_index(int t, int j) {
+	return ((t & ~(j - 1)) << 1) | (t & (j - 1));
+}
+
+//one stage from global memory, one pair per work item; global size n/2
+kernel void bitonic_global(global int* A, const int j, const int k) {
+	int i = lower_index(get_global_id(0), j);
+	bool ascending = (i & k) == 0;
+	int a = A[i];
+	int b = A[i + j];
+	if ((a > b) == ascending) {
+		A[i] = b;
+		A[i + j] = a;
+	}
+}
+
+//stages j_start, j_start/2, ..., 1 of merge k in local memory, for j_start up to the local size: each work group
+//owns a block of 2*local size elements and the pairs of these stages never leave it; global size n/2,
+//block: 2*local size elements
+kernel void bitonic_local(global int* A, const int j_start, const int k, local int* block) {
+	int lid = get_local_id(0);
+	int L = get_local_size(0);
+	int offset = get_group_id(0)*2*L;
+
+	block[lid] = A[offset + lid];
+	block[lid + L] = A[offset + lid + L];
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int j = j_start; j > 0; j /= 2) {
+		int i = lower_index(lid, j);
+		bool ascending = ((offset + i) & k) == 0;
+		int a = block[i];
+		int b = block[i + j];
+		if ((a > b) == ascending) {
+			block[i] = b;
+			block[i + j] = a;
+		}
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	A[offset + lid] = block[lid];
+	A[offset + lid + L] = block[lid + L];
+}
@@ -1,14 +1,53 @@
+//g++ -std=c++0x -I/usr/include/compute/ tutorial4.cpp -o tutorial4 -lOpenCL -lboost_filesystem -lboost_system
 #include "Utils.h"
+#include "ComputeCache.h"
 #include <iostream>
 #include <vector>
 #include <algorithm>
-#include <boost/compute.hpp>
 
 namespace compute = boost::compute;
 using namespace std;
 
-int main() {
-	typedef int mytype;
+typedef int mytype;
+
+void print_help() {
+	cerr << "Application usage:" << endl;
+	cerr << "  -c : directory for the persistent program cache, kept in <dir>/.boost_compute (default: $HOME)" << endl;
+	cerr << "  -h : print this message" << endl;
+}
+
+//runs every kernel main uses once, on a single element, so that each program is built and saved to the cache
+void Prewarm(compute::command_queue& queue) {
+	compute::vector<mytype> a(1, queue.get_context()), b(1, queue.get_context()), c(1, queue.get_context());
+	compute::transform(a.begin(), a.end(), b.begin(), c.begin(), compute::plus<mytype>(), queue);
+}
+
+int main(int argc, char **argv) {
+	string cache_dir;
+
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-c") == 0) && (i < (argc - 1))) { cache_dir = argv[++i]; }
+		else if (strcmp(argv[i], "-h") == 0) { print_help(); return 0; }
+	}
+
+	//the cache directory has to be set before the first program is built
+	if (!cache_dir.empty()) SetComputeCacheDir(cache_dir);
+
+	//startup: the first build compiles (cold cache) or loads saved binaries (warm cache); after dropping the
+	//in-memory programs the second run shows the warm cost, and the third the in-memory cache alone
+	compute::command_queue queue = compute::system::default_queue();
+	size_t cached = CountCachedPrograms();
+	double first_run = ComputeSeconds(queue, [&]() { Prewarm(queue); });
+	size_t compiled = CountCachedPrograms() - cached;
+	ClearComputeMemoryCache(queue.get_context());
+	double warm_run = ComputeSeconds(queue, [&]() { Prewarm(queue); });
+	double memory_run = ComputeSeconds(queue, [&]() { Prewarm(queue); });
+
+	cout << "Program cache: " << GetComputeCacheDir() << " (" << cached << " programs before this run)" << endl;
+	if (compiled) cout << "First run, cold cache (compiled and saved " << compiled << " programs) [ms]: " << first_run * 1000 << endl;
+	else cout << "First run, warm cache (loaded from the cache) [ms]: " << first_run * 1000 << endl;
+	cout << "Warm run, loaded from the cache [ms]: " << warm_run * 1000 << endl;
+	cout << "In-memory program cache [ms]: " << memory_run * 1000 << endl;
 
 	// create vectors on the host
 	vector<mytype> A = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };